@@ -0,0 +1,541 @@
+/*
+ * artifact.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "artifact.h"
+
+static size_t artpad(size_t bytes);
+static int artwrite(FILE* f, void* src, size_t bytes);
+static void* artsection(Artifact* art, size_t* pos, size_t bytes);
+
+/*
+ * Saves the trained models together with the Mapper dictionaries and the
+ * GridInfo standardization values in a single binary file. The y column is
+ * the last column of the mapper, and each model has the same number of
+ * theta values. expand is the expansion of the features the models were
+ * trained on, and prune the features left out before it, or NULL. engine
+ * and mix are the optimizer and the l1 share of the penalty the lambdas
+ * were chosen for. Returns 0 on success and -1 on failure.
+ */
+int artsave(char* path, Mapper* map, GridInfo* info, Expand* expand,
+		Prune* prune, LinearModel** models, double* lambdas, short engine,
+		double mix, size_t count, size_t offset) {
+
+	if (sizeof(size_t) != sizeof(uint64_t)) {
+		fflush(stdout);
+		fprintf(stderr, "Model artifacts require a 64 bits size_t.\n");
+		fflush(stderr);
+		return -1;
+	}
+
+	if (count == 0) {
+		fflush(stdout);
+		fprintf(stderr, "There is no model to save.\n");
+		fflush(stderr);
+		return -1;
+	}
+
+	size_t cols = map->cols;
+	size_t xn = models[0]->length;
+
+	size_t strings = 0;
+	size_t strbytes = 0;
+	for (size_t j = 0; j < cols; j++) {
+		if (map->map[j] == NULL) {
+			continue;
+		}
+
+		for (size_t i = 0; i < map->sizes[j]; i++) {
+			char* val = map->map[j][i];
+			if (val) {
+				strbytes += strlen(val) + 1;
+			}
+			strings++;
+		}
+	}
+
+	//the file column of each column, written even when they are the same.
+	uint64_t* source = malloc(sizeof(uint64_t) * cols);
+	for (size_t j = 0; j < cols; j++) {
+		source[j] = map->source ? map->source[j] : j;
+	}
+
+	uint64_t* offsets = malloc(sizeof(uint64_t) * (strings + 1));
+	char* blob = malloc(strbytes + 1);
+	size_t s = 0;
+	size_t b = 0;
+	for (size_t j = 0; j < cols; j++) {
+		if (map->map[j] == NULL) {
+			continue;
+		}
+
+		for (size_t i = 0; i < map->sizes[j]; i++) {
+			char* val = map->map[j][i];
+			if (val) {
+				size_t l = strlen(val) + 1;
+				memcpy(blob + b, val, l);
+				offsets[s] = b;
+				b += l;
+			} else {
+				offsets[s] = UINT64_MAX;
+			}
+			s++;
+		}
+	}
+
+	ArtHeader header;
+	memset(&header, 0, sizeof(ArtHeader));
+	memcpy(header.magic, ART_MAGIC, 4);
+	header.version = ART_VERSION;
+	header.cols = cols;
+	header.xn = xn;
+	header.count = count;
+	header.strings = strings;
+	header.strbytes = strbytes;
+	header.rows = info->rows;
+	header.offset = offset;
+	header.base = expand ? expand->n : xn;
+	header.degree = expand ? expand->degree : 1;
+	header.kind = expand ? expand->kind : EXP_ALL;
+	header.width = map->width;
+	header.encoded = prune ? prune->n : 0;
+	header.kept = prune ? prune->kept : 0;
+	header.engine = engine;
+	header.mix = engine == ENGINE_CD ? mix : 0;
+	header.size = artpad(sizeof(ArtHeader)) + 4 * artpad(sizeof(float) * cols)
+			+ artpad(sizeof(short) * cols) + 6 * artpad(sizeof(uint64_t) * cols)
+			+ count * artpad(sizeof(double) * (xn + 1))
+			+ artpad(sizeof(double) * count)
+			+ artpad(sizeof(uint64_t) * strings) + artpad(strbytes)
+			+ artpad(sizeof(uint64_t) * header.kept);
+
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) {
+		fflush(stdout);
+		fprintf(stderr, "Could not open %s for writing.\n", path);
+		fflush(stderr);
+		free(source);
+		free(offsets);
+		free(blob);
+		return -1;
+	}
+
+	int ret = 0;
+	ret |= artwrite(f, &header, sizeof(ArtHeader));
+	ret |= artwrite(f, info->max, sizeof(float) * cols);
+	ret |= artwrite(f, info->min, sizeof(float) * cols);
+	ret |= artwrite(f, info->mean, sizeof(float) * cols);
+	ret |= artwrite(f, info->stdev, sizeof(float) * cols);
+	ret |= artwrite(f, info->discrete, sizeof(short) * cols);
+	ret |= artwrite(f, info->numbers, sizeof(uint64_t) * cols);
+	ret |= artwrite(f, info->words, sizeof(uint64_t) * cols);
+	ret |= artwrite(f, info->missing, sizeof(uint64_t) * cols);
+	ret |= artwrite(f, map->sizes, sizeof(uint64_t) * cols);
+	ret |= artwrite(f, map->buckets, sizeof(uint64_t) * cols);
+	ret |= artwrite(f, source, sizeof(uint64_t) * cols);
+
+	double* params = malloc(sizeof(double) * (xn + 1));
+	for (size_t k = 0; k < count; k++) {
+		params[0] = models[k]->bias;
+		copyd(params + 1, models[k]->theta, xn);
+		ret |= artwrite(f, params, sizeof(double) * (xn + 1));
+	}
+	free(params);
+
+	double* lambdasOut = calloc(count, sizeof(double));
+	if (lambdas) {
+		copyd(lambdasOut, lambdas, count);
+	}
+	ret |= artwrite(f, lambdasOut, sizeof(double) * count);
+	free(lambdasOut);
+
+	ret |= artwrite(f, offsets, sizeof(uint64_t) * strings);
+	ret |= artwrite(f, blob, strbytes);
+	if (prune) {
+		ret |= artwrite(f, prune->keep, sizeof(uint64_t) * prune->kept);
+	}
+
+	if (fclose(f) != 0) {
+		ret = -1;
+	}
+
+	free(source);
+	free(offsets);
+	free(blob);
+
+	if (ret) {
+		fflush(stdout);
+		fprintf(stderr, "Could not write the model file %s.\n", path);
+		fflush(stderr);
+	}
+
+	return ret;
+}
+
+/*
+ * Loads a model artifact with a single mmap call. Only the small pointer
+ * tables of the Mapper and the LinearModel structs are allocated, the
+ * values themselves stay in the mapped file.
+ */
+Artifact* artload(char* path) {
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		fflush(stdout);
+		fprintf(stderr, "Could not open the model file %s.\n", path);
+		fflush(stderr);
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(ArtHeader)) {
+		fflush(stdout);
+		fprintf(stderr, "Invalid model file %s.\n", path);
+		fflush(stderr);
+		close(fd);
+		return NULL;
+	}
+
+	size_t size = st.st_size;
+	void* base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		fflush(stdout);
+		fprintf(stderr, "Could not map the model file %s.\n", path);
+		fflush(stderr);
+		return NULL;
+	}
+
+	ArtHeader* header = base;
+	if (memcmp(header->magic, ART_MAGIC, 4) != 0
+			|| header->version != ART_VERSION || header->size != size
+			|| sizeof(size_t) != sizeof(uint64_t)) {
+		fflush(stdout);
+		fprintf(stderr, "Invalid or unsupported model file %s.\n", path);
+		fflush(stderr);
+		munmap(base, size);
+		return NULL;
+	}
+
+	size_t cols = header->cols;
+	size_t xn = header->xn;
+	size_t count = header->count;
+
+	Artifact* art = calloc(1, sizeof(Artifact));
+	art->base = base;
+	art->size = size;
+	art->xn = xn;
+	art->count = count;
+	art->offset = header->offset;
+	art->engine = header->engine;
+	art->mix = header->mix;
+
+	if (header->degree > 1) {
+		art->expand = expnew(header->base, header->degree, header->kind);
+		if (art->expand == NULL || art->expand->length != xn) {
+			fflush(stdout);
+			fprintf(stderr, "Invalid feature expansion in %s.\n", path);
+			fflush(stderr);
+			artfree(art);
+			return NULL;
+		}
+	}
+
+	size_t pos = artpad(sizeof(ArtHeader));
+
+	GridInfo* info = malloc(sizeof(GridInfo));
+	info->max = artsection(art, &pos, sizeof(float) * cols);
+	info->min = artsection(art, &pos, sizeof(float) * cols);
+	info->mean = artsection(art, &pos, sizeof(float) * cols);
+	info->stdev = artsection(art, &pos, sizeof(float) * cols);
+	info->discrete = artsection(art, &pos, sizeof(short) * cols);
+	info->numbers = artsection(art, &pos, sizeof(uint64_t) * cols);
+	info->words = artsection(art, &pos, sizeof(uint64_t) * cols);
+	info->missing = artsection(art, &pos, sizeof(uint64_t) * cols);
+	info->quantiles = NULL;
+	info->distinct = NULL;
+	info->rows = header->rows;
+	info->columns = cols;
+	art->info = info;
+
+	Mapper* map = malloc(sizeof(Mapper));
+	map->cols = cols;
+	map->sizes = artsection(art, &pos, sizeof(uint64_t) * cols);
+	map->buckets = artsection(art, &pos, sizeof(uint64_t) * cols);
+	map->source = artsection(art, &pos, sizeof(uint64_t) * cols);
+	map->width = header->width;
+	map->map = NULL;
+	art->map = map;
+
+	art->models = calloc(count, sizeof(LinearModel*));
+	for (size_t k = 0; k < count; k++) {
+		double* params = artsection(art, &pos, sizeof(double) * (xn + 1));
+		if (params) {
+			LinearModel* model = malloc(sizeof(LinearModel));
+			model->length = xn;
+			model->bias = params[0];
+			model->theta = params + 1;
+			art->models[k] = model;
+		}
+	}
+
+	art->lambdas = artsection(art, &pos, sizeof(double) * count);
+
+	uint64_t* offsets = artsection(art, &pos, sizeof(uint64_t) * header->strings);
+	char* blob = artsection(art, &pos, header->strbytes);
+	size_t* keep = artsection(art, &pos, sizeof(uint64_t) * header->kept);
+
+	size_t strings = 0;
+	for (size_t j = 0; art->base && j < cols; j++) {
+		if (info->words[j] > 0 && map->buckets[j] == 0) {
+			strings += map->sizes[j];
+		}
+	}
+
+	if (art->base == NULL || strings != header->strings) {
+		fflush(stdout);
+		fprintf(stderr, "Truncated model file %s.\n", path);
+		fflush(stderr);
+		art->base = base;
+		artfree(art);
+		return NULL;
+	}
+
+	if (header->kept > 0) {
+		Prune* p = calloc(1, sizeof(Prune));
+		p->n = header->encoded;
+		p->kept = header->kept;
+		p->keep = keep;
+		art->prune = p;
+
+		short valid = p->kept == header->base && p->kept < p->n;
+		for (size_t k = 0; k < p->kept && valid; k++) {
+			valid = p->keep[k] < p->n
+					&& (k == 0 || p->keep[k - 1] < p->keep[k]);
+		}
+
+		if (!valid) {
+			fflush(stdout);
+			fprintf(stderr, "Invalid pruned features in %s.\n", path);
+			fflush(stderr);
+			artfree(art);
+			return NULL;
+		}
+	}
+
+	//every word is read through the mapped file, so each one must start
+	//in the blob and the last one must end in it.
+	short valid = header->strbytes == 0 || blob[header->strbytes - 1] == '\0';
+	for (size_t s = 0; s < header->strings && valid; s++) {
+		valid = offsets[s] == UINT64_MAX || offsets[s] < header->strbytes;
+	}
+
+	if (!valid) {
+		fflush(stdout);
+		fprintf(stderr, "Invalid words in %s.\n", path);
+		fflush(stderr);
+		artfree(art);
+		return NULL;
+	}
+
+	for (size_t j = 0; j < cols; j++) {
+		if (map->source[j] >= map->width) {
+			fflush(stdout);
+			fprintf(stderr, "Invalid column %zu in %s.\n", j + 1, path);
+			fflush(stderr);
+			artfree(art);
+			return NULL;
+		}
+	}
+
+	//the pointer table of the mapper is the only part that can not live
+	//in the mapped file, since it holds absolute addresses.
+	map->map = calloc(cols, sizeof(char**));
+	char** table = NULL;
+	if (header->strings > 0) {
+		table = malloc(sizeof(char*) * header->strings);
+	}
+	size_t s = 0;
+	for (size_t j = 0; j < cols; j++) {
+		if (info->words[j] == 0 || map->buckets[j] > 0) {
+			continue;
+		}
+
+		map->map[j] = table + s;
+		for (size_t i = 0; i < map->sizes[j]; i++) {
+			uint64_t off = offsets[s];
+			table[s] = off == UINT64_MAX ? NULL : blob + off;
+			s++;
+		}
+	}
+
+	//the rows are encoded with the mapper and pruned and expanded in place,
+	//so every width must be the one the mapper gives. A number y keeps its
+	//missing flag as the last feature, like dataxn.
+	size_t* widths = mtroffsets(map, info->missing);
+	size_t ycol = cols - 1;
+	size_t encoded = map->map[ycol] ? widths[ycol] : widths[cols] - 1;
+	size_t width = widths[cols];
+	free(widths);
+
+	Prune* p = art->prune;
+	Expand* e = art->expand;
+	size_t features = header->base;
+	valid = encoded == (p ? p->n : features)
+			&& (p == NULL || p->kept == features)
+			&& (e ? e->n == features && e->length == xn : xn == features)
+			&& xn <= (e && e->length > width ? e->length : width);
+	if (!valid) {
+		fflush(stdout);
+		fprintf(stderr, "The features of %s do not match its columns.\n",
+				path);
+		fflush(stderr);
+		artfree(art);
+		return NULL;
+	}
+
+	return art;
+}
+
+void artfree(Artifact* art) {
+	if (art) {
+		if (art->models) {
+			for (size_t k = 0; k < art->count; k++) {
+				free(art->models[k]);
+			}
+			free(art->models);
+		}
+
+		if (art->map) {
+			if (art->map->map) {
+				//all the columns share the same table, which starts at the
+				//first word column.
+				for (size_t j = 0; j < art->map->cols; j++) {
+					if (art->map->map[j]) {
+						free(art->map->map[j]);
+						break;
+					}
+				}
+				free(art->map->map);
+			}
+			free(art->map);
+		}
+
+		free(art->info);
+		expfree(art->expand);
+		free(art->prune);
+
+		if (art->base) {
+			munmap(art->base, art->size);
+		}
+
+		free(art);
+	}
+}
+
+/*
+ * Prints a summary of the artifact: the columns, the y values and the
+ * number of theta values of each model.
+ */
+void artprint(Artifact* art) {
+	Mapper* map = art->map;
+	GridInfo* info = art->info;
+	size_t cols = map->cols;
+	size_t ycol = cols - 1;
+
+	printf("Rows: %zu\n", info->rows);
+	if (map->width != cols) {
+		printf("Columns: %zu of %zu\n", cols, map->width);
+	} else {
+		printf("Columns: %zu\n", cols);
+	}
+	printf("Features: %zu\n", art->xn);
+	printf("Models: %zu\n", art->count);
+	if (art->engine == ENGINE_CD) {
+		printf("Engine: cd, l1 ratio %g\n", art->mix);
+	} else {
+		printf("Engine: %s\n", enginename(art->engine));
+	}
+	if (art->prune) {
+		Prune* p = art->prune;
+		printf("Pruned: %zu of %zu features\n", p->n - p->kept, p->n);
+	}
+	if (art->expand) {
+		printf("Expansion: degree %zu, %s terms of %zu features\n",
+				art->expand->degree, expkindname(art->expand->kind),
+				art->expand->n);
+	}
+	//the columns are numbered as in the data file.
+	for (size_t j = 0; j < cols; j++) {
+		size_t f = map->source[j] + 1;
+		if (map->buckets[j]) {
+			printf("%6zu  word   hashed in %zu buckets\n", f, map->buckets[j]);
+		} else if (map->map[j]) {
+			printf("%6zu  word   %zu values\n", f, map->sizes[j]);
+		} else {
+			printf("%6zu  number mean %.4f stdev %.4f\n", f, info->mean[j],
+					info->stdev[j]);
+		}
+	}
+
+	for (size_t k = 0; k < art->count; k++) {
+		LinearModel* model = art->models[k];
+		if (map->map[ycol]) {
+			printf("y: %s  bias: %.6f  lambda: %g\n", map->map[ycol][k],
+					model->bias, art->lambdas[k]);
+		} else {
+			printf("y  bias: %.6f  lambda: %g\n", model->bias, art->lambdas[k]);
+		}
+	}
+}
+
+static size_t artpad(size_t bytes) {
+	return (bytes + 7) & ~((size_t) 7);
+}
+
+static int artwrite(FILE* f, void* src, size_t bytes) {
+	static const char zeros[8] = { 0 };
+
+	if (bytes > 0 && fwrite(src, 1, bytes, f) != bytes) {
+		return -1;
+	}
+
+	size_t pad = artpad(bytes) - bytes;
+	if (pad > 0 && fwrite(zeros, 1, pad, f) != pad) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Returns a pointer to the next section of the mapped file and advances pos.
+ * If the section goes beyond the end of the file, the base pointer of the
+ * artifact is cleared to signal the error.
+ */
+static void* artsection(Artifact* art, size_t* pos, size_t bytes) {
+	if (art->base == NULL) {
+		return NULL;
+	}
+
+	size_t start = *pos;
+	size_t end = start + artpad(bytes);
+	if (end > art->size || end < start) {
+		art->base = NULL;
+		return NULL;
+	}
+
+	*pos = end;
+	return (char*) art->base + start;
+}
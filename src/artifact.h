@@ -0,0 +1,85 @@
+/*
+ * artifact.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef ARTIFACT_H_
+#define ARTIFACT_H_
+
+#include <stdint.h>
+#include "utils.h"
+#include "ml.h"
+
+#define ART_MAGIC "LNFT"
+#define ART_VERSION 7
+
+/*
+ * On disk header of a model artifact. Every section that follows the header
+ * starts at an 8 bytes boundary, so the arrays can be used in place once the
+ * file is mapped in memory.
+ */
+typedef struct ArtHeader{
+	char magic[4];
+	uint32_t version;
+	uint64_t size;
+	uint64_t cols;
+	uint64_t xn;
+	uint64_t count;
+	uint64_t strings;
+	uint64_t strbytes;
+	uint64_t rows;
+	uint64_t offset;
+	uint64_t base;
+	uint64_t degree;
+	uint64_t kind;
+	uint64_t width;
+	uint64_t encoded;
+	uint64_t kept;
+	uint64_t engine;
+	double mix;
+}ArtHeader;
+
+/*
+ * A loaded model artifact. The Mapper, GridInfo and LinearModel structs
+ * point directly into the mapped file, so they must not be released with
+ * mapfree, ginfofree or modfree. Use artfree instead.
+ *
+ * expand is NULL unless the models were trained on expanded features, in
+ * which case the rows are encoded with expand->n values and expanded to xn
+ * before computing h.
+ *
+ * prune is NULL unless some encoded features were pruned, in which case
+ * the rows are pruned before they are expanded. Its keep array points in
+ * to the mapped file too.
+ *
+ * engine is the ENGINE_* that fit the models, and the scale of their
+ * lambdas depends on it: sgd and lbfgs add lambda / (2 m) |theta|^2 to
+ * the cost of m rows, and cd adds lambda (mix |theta|
+ * + (1 - mix) / 2 |theta|^2).
+ */
+typedef struct Artifact{
+	void* base;
+	size_t size;
+	size_t xn;
+	size_t count;
+	size_t offset;
+	double* lambdas;
+	short engine;
+	double mix;
+	Mapper* map;
+	GridInfo* info;
+	LinearModel** models;
+	Expand* expand;
+	Prune* prune;
+}Artifact;
+
+int artsave(char* path, Mapper* map, GridInfo* info, Expand* expand,
+		Prune* prune, LinearModel** models, double* lambdas, short engine,
+		double mix, size_t count, size_t offset);
+Artifact* artload(char* path);
+void artfree(Artifact* art);
+void artprint(Artifact* art);
+
+#endif /* ARTIFACT_H_ */
@@ -0,0 +1,375 @@
+/*
+ * bench.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "ml.h"
+#include "bench.h"
+
+//batch and steps of the timed stogdcent call.
+#define BENCH_BATCH 50
+#define BENCH_STEPS 2000
+
+typedef struct BenchList{
+	BenchStat* stats;
+	size_t count;
+	size_t cap;
+}BenchList;
+
+//results of h are accumulated here, so the calls are not optimized away.
+static volatile double benchsink;
+
+static void benchfile(char* path, size_t runs, BenchList* list);
+static void benchadd(BenchList* list, char* path, char* op, double* times,
+		size_t runs, double bytes, double rows);
+static void benchprint(BenchList* list);
+static int benchjson(char* path, BenchList* list);
+static ssize_t benchcompare(char* path, BenchList* list);
+
+/*
+ * Times the ingestion and training functions separately over a set of
+ * datasets, and reports the median and p95 of repeated runs, together with
+ * the throughput in MB/s and rows/s.
+ *
+ *   linfit bench [--runs N] [--json <file>] [--baseline <file>] [files...]
+ *
+ * When no file is given, every *.data file under <CURRENT_DIR>/files is
+ * used. --json writes the results, and --baseline compares them with the
+ * results of a previous --json file. The exit status is 1 when any
+ * operation got slower than the baseline by more than BENCH_TOLERANCE, or
+ * when the baseline can not be read.
+ */
+int benchmain(int argc, char** argv) {
+	size_t runs = 5;
+	char* json = NULL;
+	char* baseline = NULL;
+
+	char** files = malloc(sizeof(char*) * (argc + 1));
+	size_t count = 0;
+	for (int i = 0; i < argc; i++) {
+		if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+			runs = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json = argv[++i];
+		} else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+			baseline = argv[++i];
+		} else {
+			files[count] = cnew(strlen(argv[i]));
+			strcpy(files[count], argv[i]);
+			count++;
+		}
+	}
+
+	if (runs == 0) {
+		runs = 1;
+	}
+
+	if (count == 0) {
+		DIR* dir = opendir("files");
+		if (dir) {
+			struct dirent* ent;
+			while ((ent = readdir(dir)) != NULL) {
+				char* p = strrchr(ent->d_name, '.');
+				if (p == NULL || lowercmp(p, ".data") != 1) {
+					continue;
+				}
+
+				files = realloc(files, sizeof(char*) * (count + 1));
+				files[count] = cnew(strlen(ent->d_name) + 6);
+				strcpy(files[count], "files/");
+				strcpy(files[count] + 6, ent->d_name);
+				count++;
+			}
+			closedir(dir);
+		}
+	}
+
+	if (count == 0) {
+		fprintf(stderr, "No data file to benchmark.\n");
+		fflush(stderr);
+		free(files);
+		return EXIT_FAILURE;
+	}
+
+	BenchList list;
+	list.stats = NULL;
+	list.count = 0;
+	list.cap = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		fprintf(stderr, "Benchmarking %s...\n", files[i]);
+		fflush(stderr);
+		benchfile(files[i], runs, &list);
+		free(files[i]);
+	}
+	free(files);
+
+	benchprint(&list);
+
+	int ret = EXIT_SUCCESS;
+	if (json && benchjson(json, &list) != 0) {
+		ret = EXIT_FAILURE;
+	}
+
+	if (baseline && benchcompare(baseline, &list) != 0) {
+		ret = EXIT_FAILURE;
+	}
+
+	free(list.stats);
+	return ret;
+}
+
+/*
+ * Runs every operation of the pipeline over a single file. The output of
+ * the last run of each operation is the input of the next one.
+ */
+static void benchfile(char* path, size_t runs, BenchList* list) {
+	double* times = malloc(sizeof(double) * runs);
+
+	String* raw = NULL;
+	for (size_t r = 0; r < runs; r++) {
+		if (raw) {
+			strfree(raw);
+		}
+		double start = wtime();
+		raw = ffull(path);
+		times[r] = wtime() - start;
+		if (raw == NULL) {
+			fprintf(stderr, "Could not read %s.\n", path);
+			fflush(stderr);
+			free(times);
+			return;
+		}
+	}
+
+	double bytes = raw->length;
+	double lines = ccount(raw->value, -1, '\n') + 1;
+	benchadd(list, path, "ffull", times, runs, bytes, lines);
+
+	Grid* g = NULL;
+	for (size_t r = 0; r < runs; r++) {
+		gfree(g);
+		double start = wtime();
+		g = gcreate(raw->value, ',');
+		times[r] = wtime() - start;
+		if (g == NULL) {
+			strfree(raw);
+			free(times);
+			return;
+		}
+	}
+	strfree(raw);
+
+	size_t rows = g->info->rows;
+	size_t cols = g->info->columns;
+	benchadd(list, path, "gcreate", times, runs, bytes, rows);
+
+	for (size_t r = 0; r < runs; r++) {
+		double start = wtime();
+		GridInfo* info = ginfo(g, rows, cols);
+		times[r] = wtime() - start;
+		ginfofree(info);
+	}
+	benchadd(list, path, "ginfo", times, runs, bytes, rows);
+
+	Mapper* map = NULL;
+	for (size_t r = 0; r < runs; r++) {
+		mapfree(map);
+		double start = wtime();
+		map = mapcreate(g);
+		times[r] = wtime() - start;
+	}
+	benchadd(list, path, "mapcreate", times, runs, bytes, rows);
+
+	Matrix* mtr = NULL;
+	for (size_t r = 0; r < runs; r++) {
+		mtrfree(mtr);
+		double start = wtime();
+		mtr = mtrcreate(g, map);
+		times[r] = wtime() - start;
+	}
+	gfree(g);
+	mapfree(map);
+	if (mtr == NULL) {
+		free(times);
+		return;
+	}
+
+	size_t n = mtr->n;
+	benchadd(list, path, "mtrcreate", times, runs, bytes, rows);
+
+	//the last matrix column is used as y, whatever its type.
+	Matrix* X = mtrslct(mtr, 0, n - 1);
+	Matrix* y = mtrslct(mtr, n - 1, n);
+	mtrfree(mtr);
+
+	size_t m = X->m;
+	size_t xn = X->n;
+	double xbytes = (double) m * xn * sizeof(float);
+
+	LinearModel* model = modlinear(xn);
+	modrand(model);
+
+	for (size_t r = 0; r < runs; r++) {
+		double start = wtime();
+		double sum = 0;
+		for (size_t i = 0; i < m; i++) {
+			sum += h(X->values + i * xn, xn, model->bias, model->theta);
+		}
+		times[r] = wtime() - start;
+		benchsink += sum;
+	}
+	benchadd(list, path, "h", times, runs, xbytes, m);
+
+	for (size_t r = 0; r < runs; r++) {
+		double start = wtime();
+		benchsink += j(X, model, y, 0.1);
+		times[r] = wtime() - start;
+	}
+	benchadd(list, path, "j", times, runs, xbytes, m);
+
+	double steprows = (double) BENCH_BATCH * BENCH_STEPS;
+	for (size_t r = 0; r < runs; r++) {
+		modrand(model);
+		double start = wtime();
+		stogdcent(X, model, y, 0.01, 0.1, BENCH_BATCH, BENCH_STEPS);
+		times[r] = wtime() - start;
+	}
+	benchadd(list, path, "stogdcent", times, runs,
+			steprows * xn * sizeof(float), steprows);
+
+	modfree(model);
+	mtrfree(X);
+	mtrfree(y);
+	free(times);
+}
+
+static void benchadd(BenchList* list, char* path, char* op, double* times,
+		size_t runs, double bytes, double rows) {
+	if (list->count == list->cap) {
+		list->cap = list->cap * 2 + 16;
+		list->stats = realloc(list->stats, sizeof(BenchStat) * list->cap);
+	}
+
+	qsort(times, runs, sizeof(double), dcmp);
+
+	char* name = strrchr(path, '/');
+	name = name ? name + 1 : path;
+
+	BenchStat* st = &list->stats[list->count++];
+	memset(st, 0, sizeof(BenchStat));
+	strncpy(st->file, name, sizeof(st->file) - 1);
+	strncpy(st->op, op, sizeof(st->op) - 1);
+	st->runs = runs;
+	st->median = times[(runs - 1) / 2];
+	st->p95 = times[(size_t) ((runs - 1) * 0.95 + 0.5)];
+	st->bytes = bytes;
+	st->rows = rows;
+}
+
+static void benchprint(BenchList* list) {
+	printf("\n%-28s %-10s %12s %12s %12s %14s\n", "File", "Op", "Median ms",
+			"p95 ms", "MB/s", "rows/s");
+	for (size_t i = 0; i < list->count; i++) {
+		BenchStat* st = &list->stats[i];
+		double med = st->median > 0 ? st->median : 1e-9;
+		printf("%-28s %-10s %12.3f %12.3f %12.1f %14.0f\n", st->file, st->op,
+				st->median * 1e3, st->p95 * 1e3, st->bytes / med / 1e6,
+				st->rows / med);
+	}
+	flush();
+}
+
+/*
+ * Writes the results as a JSON array, one object per line, which is also
+ * the format read by benchcompare.
+ */
+static int benchjson(char* path, BenchList* list) {
+	FILE* f = fopen(path, "w");
+	if (f == NULL) {
+		fprintf(stderr, "Could not open %s for writing.\n", path);
+		fflush(stderr);
+		return -1;
+	}
+
+	fputs("[\n", f);
+	for (size_t i = 0; i < list->count; i++) {
+		BenchStat* st = &list->stats[i];
+		double med = st->median > 0 ? st->median : 1e-9;
+
+		fputs("{\"file\":", f);
+		fjsonstr(f, st->file);
+		fputs(",\"op\":", f);
+		fjsonstr(f, st->op);
+		fprintf(f, ",\"runs\":%zu,\"median_s\":", st->runs);
+		fjsonnum(f, st->median);
+		fputs(",\"p95_s\":", f);
+		fjsonnum(f, st->p95);
+		fputs(",\"mb_s\":", f);
+		fjsonnum(f, st->bytes / med / 1e6);
+		fputs(",\"rows_s\":", f);
+		fjsonnum(f, st->rows / med);
+		fputs(i + 1 < list->count ? "},\n" : "}\n", f);
+	}
+	fputs("]\n", f);
+
+	return fclose(f) == 0 ? 0 : -1;
+}
+
+/*
+ * Compares the medians with the ones of a baseline file written by
+ * benchjson. Returns the number of operations slower than the baseline by
+ * more than BENCH_TOLERANCE, or -1 if the baseline can not be read.
+ */
+static ssize_t benchcompare(char* path, BenchList* list) {
+	FILE* f = fopen(path, "r");
+	if (f == NULL) {
+		fflush(stdout);
+		fprintf(stderr, "Could not open the baseline %s.\n", path);
+		fflush(stderr);
+		return -1;
+	}
+
+	printf("\n%-28s %-10s %12s %12s %9s\n", "File", "Op", "Base ms",
+			"Now ms", "Change");
+
+	size_t slower = 0;
+	char line[1024];
+	while (fgets(line, sizeof(line), f)) {
+		char file[256];
+		char op[32];
+		double median;
+		if (sscanf(line, "{\"file\":\"%255[^\"]\",\"op\":\"%31[^\"]\",\"runs\":%*u,"
+				"\"median_s\":%lf", file, op, &median) != 3) {
+			continue;
+		}
+
+		for (size_t i = 0; i < list->count; i++) {
+			BenchStat* st = &list->stats[i];
+			if (strcmp(st->file, file) != 0 || strcmp(st->op, op) != 0) {
+				continue;
+			}
+
+			double change = median > 0 ? (st->median - median) / median : 0;
+			short flag = change > BENCH_TOLERANCE;
+			slower += flag;
+			printf("%-28s %-10s %12.3f %12.3f %+8.1f%%%s\n", file, op,
+					median * 1e3, st->median * 1e3, change * 100,
+					flag ? "  SLOWER" : "");
+			break;
+		}
+	}
+	fclose(f);
+	flush();
+
+	return slower;
+}
@@ -0,0 +1,30 @@
+/*
+ * bench.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+//a result slower than the baseline by more than this fraction is flagged.
+#define BENCH_TOLERANCE 0.10
+
+/*
+ * Timing of a single operation over one dataset. bytes and rows are the
+ * amount of work of a single run, used for the throughput.
+ */
+typedef struct BenchStat{
+	char file[256];
+	char op[32];
+	size_t runs;
+	double median;
+	double p95;
+	double bytes;
+	double rows;
+}BenchStat;
+
+int benchmain(int argc, char** argv);
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,414 @@
+/*
+ * enet.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "enet.h"
+#include "quant.h"
+#include "mem.h"
+#include "prof.h"
+#include "telem.h"
+
+//lambdas of a path, from the smallest one that keeps every feature at 0
+//down to ENET_RATIO of it.
+#define ENET_LAMBDAS 30
+#define ENET_RATIO 1e-3
+//a fit stops once no coordinate moves the cost by more than ENET_TOL of
+//the cost of the bias alone, or after ENET_PASSES passes.
+#define ENET_TOL 1e-7
+#define ENET_PASSES 1000
+
+//share of the penalty on the absolute values of theta, the rest is on
+//their squares. 1 is the lasso and 0 is ridge.
+double enetmix = 1;
+
+/*
+ * The rows of X gathered by column, with only the values that are not 0:
+ * the column j has vals[start[j], start[j + 1]), at the rows idx[...]. w
+ * is the weight of each row over the total weight, sq the weighted sum of
+ * the squares of each column, r the residuals y - h(x) of the current bias
+ * and theta, and c the weighted sum of each column times r. Only the
+ * strong columns are updated, and active lists the ones that are not 0.
+ */
+typedef struct Enet{
+	size_t m;
+	size_t n;
+	size_t* start;
+	size_t* idx;
+	float* vals;
+	double* w;
+	double* sq;
+	double* r;
+	double* c;
+	short* strong;
+	size_t* active;
+	double bias;
+	double* theta;
+	double null;
+	uint64_t updates;
+}Enet;
+
+static Enet* enetnew(Matrix* X, Matrix* y, LinearModel* model, short zero);
+static void enetfree(Enet* e);
+static void enetsolve(Enet* e, double lambda);
+static double enetcoord(Enet* e, size_t j, double lambda);
+static double enetbias(Enet* e);
+static double enetcorr(Enet* e, size_t j);
+static double enetcost(Enet* e, double lambda);
+
+/*
+ * Fits the elastic net over a path of lambdas with cyclic coordinate
+ * descent, each lambda starting from the solution of the previous one.
+ * The cost is the weighted mean of the squared errors over 2, plus lambda
+ * times enetmix |theta| + (1 - enetmix) / 2 |theta|^2. A column is only
+ * updated when the strong rule keeps it, and the columns it dropped are
+ * checked once a lambda converged. The parameters with the lowest j on
+ * the test rows are kept in model, and their lambda is returned.
+ */
+double enetpath(Matrix* X, LinearModel* model, Matrix* y, Matrix* xtest,
+		Matrix* ytest) {
+	profbegin("enet");
+	size_t n = X->n;
+	double mix = enetmix;
+	Enet* e = enetnew(X, y, model, 1);
+
+	double lmax = 0;
+	for (size_t j = 0; j < n; j++) {
+		if (fabs(e->c[j]) > lmax) {
+			lmax = fabs(e->c[j]);
+		}
+	}
+	//ridge never keeps every feature at 0, so its path starts where the
+	//penalty is large compared to the correlations.
+	lmax /= mix > 1e-3 ? mix : 1e-3;
+
+	double lwlambda = lmax;
+	double lwbias = e->bias;
+	double* lwtheta = memcalloc(MEM_SCRATCH, n, sizeof(double));
+	model->bias = e->bias;
+	copyd(model->theta, e->theta, n);
+	double lwj = j(xtest, model, ytest, 0);
+
+	double prev = lmax;
+	for (size_t k = 1; k < ENET_LAMBDAS && lmax > 0; k++) {
+		double lambda = lmax * pow(ENET_RATIO, k / (ENET_LAMBDAS - 1.0));
+		profbeginarg("lambda", lambda);
+
+		//sequential strong rule, a column whose correlation is below
+		//this bound at the previous lambda is most likely still 0.
+		double bound = mix * (2 * lambda - prev);
+		for (size_t j = 0; j < n; j++) {
+			e->strong[j] = mix == 0 || e->theta[j] != 0
+					|| fabs(e->c[j]) >= bound;
+		}
+
+		enetsolve(e, lambda);
+		prev = lambda;
+
+		model->bias = e->bias;
+		copyd(model->theta, e->theta, n);
+		double newj = j(xtest, model, ytest, 0);
+
+		if (telem.on) {
+			TelemRecord rec;
+			memset(&rec, 0, sizeof(TelemRecord));
+			rec.kind = TELEM_LAMBDA;
+			rec.lambda = lambda;
+			rec.loss = enetcost(e, lambda);
+			rec.test = newj;
+			rec.accepted = newj < lwj;
+			telemrecord(&rec);
+		}
+
+		if (newj < lwj) {
+			lwj = newj;
+			lwlambda = lambda;
+			lwbias = e->bias;
+			copyd(lwtheta, e->theta, n);
+		}
+		profend();
+	}
+
+	model->bias = lwbias;
+	copyd(model->theta, lwtheta, n);
+	memfree(MEM_SCRATCH, lwtheta);
+	enetfree(e);
+	profend();
+	return lwlambda;
+}
+
+/*
+ * Fits the elastic net for a single lambda, starting from the current
+ * parameters of model. Every column is updated.
+ */
+void enetfit(Matrix* X, LinearModel* model, Matrix* y, double lambda) {
+	profbegin("enet");
+	size_t n = X->n;
+	Enet* e = enetnew(X, y, model, 0);
+
+	for (size_t j = 0; j < n; j++) {
+		e->strong[j] = 1;
+	}
+	enetsolve(e, lambda);
+
+	model->bias = e->bias;
+	copyd(model->theta, e->theta, n);
+	enetfree(e);
+	profend();
+}
+
+/*
+ * Gathers X by column. With zero, theta starts at 0 and the bias at the
+ * weighted mean of y, otherwise both start at the ones of model.
+ */
+static Enet* enetnew(Matrix* X, Matrix* y, LinearModel* model, short zero) {
+	size_t m = X->m;
+	size_t n = X->n;
+	float* ans = y->values;
+
+	Enet* e = memcalloc(MEM_SCRATCH, 1, sizeof(Enet));
+	e->m = m;
+	e->n = n;
+	e->start = memcalloc(MEM_SCRATCH, n + 1, sizeof(size_t));
+
+	float* row = memalloc(MEM_SCRATCH, sizeof(float) * n);
+	for (size_t i = 0; i < m; i++) {
+		float* x = mtrload(X, i, row);
+		for (size_t j = 0; j < n; j++) {
+			e->start[j + 1] += x[j] != 0;
+		}
+	}
+	for (size_t j = 0; j < n; j++) {
+		e->start[j + 1] += e->start[j];
+	}
+
+	size_t nnz = e->start[n];
+	e->idx = memalloc(MEM_SCRATCH, sizeof(size_t) * (nnz + 1));
+	e->vals = memalloc(MEM_SCRATCH, sizeof(float) * (nnz + 1));
+	size_t* fill = memalloc(MEM_SCRATCH, sizeof(size_t) * n);
+	memcpy(fill, e->start, sizeof(size_t) * n);
+	for (size_t i = 0; i < m; i++) {
+		float* x = mtrload(X, i, row);
+		for (size_t j = 0; j < n; j++) {
+			if (x[j] != 0) {
+				size_t q = fill[j]++;
+				e->idx[q] = i;
+				e->vals[q] = x[j];
+			}
+		}
+	}
+	memfree(MEM_SCRATCH, fill);
+	memfree(MEM_SCRATCH, row);
+
+	e->w = memalloc(MEM_SCRATCH, sizeof(double) * m);
+	double total = mtrweight(X, 0, m);
+	double mean = 0;
+	for (size_t i = 0; i < m; i++) {
+		e->w[i] = (X->weights ? X->weights[i] : 1.0) / total;
+		mean += e->w[i] * ans[i];
+	}
+
+	e->sq = memalloc(MEM_SCRATCH, sizeof(double) * n);
+	for (size_t j = 0; j < n; j++) {
+		double sum = 0;
+		for (size_t q = e->start[j]; q < e->start[j + 1]; q++) {
+			sum += e->w[e->idx[q]] * e->vals[q] * e->vals[q];
+		}
+		e->sq[j] = sum;
+	}
+
+	e->theta = memcalloc(MEM_SCRATCH, n, sizeof(double));
+	e->bias = mean;
+	if (!zero) {
+		copyd(e->theta, model->theta, n);
+		e->bias = model->bias;
+	}
+
+	e->null = 0;
+	e->r = memalloc(MEM_SCRATCH, sizeof(double) * m);
+	for (size_t i = 0; i < m; i++) {
+		e->r[i] = ans[i] - e->bias;
+		e->null += e->w[i] * (ans[i] - mean) * (ans[i] - mean);
+	}
+	for (size_t j = 0; j < n; j++) {
+		if (e->theta[j] != 0) {
+			for (size_t q = e->start[j]; q < e->start[j + 1]; q++) {
+				e->r[e->idx[q]] -= e->theta[j] * e->vals[q];
+			}
+		}
+	}
+
+	e->c = memalloc(MEM_SCRATCH, sizeof(double) * n);
+	for (size_t j = 0; j < n; j++) {
+		e->c[j] = enetcorr(e, j);
+	}
+
+	e->strong = memalloc(MEM_SCRATCH, sizeof(short) * n);
+	e->active = memalloc(MEM_SCRATCH, sizeof(size_t) * n);
+	return e;
+}
+
+static void enetfree(Enet* e) {
+	profcount(PROF_CD_UPDATES, e->updates);
+	memfree(MEM_SCRATCH, e->start);
+	memfree(MEM_SCRATCH, e->idx);
+	memfree(MEM_SCRATCH, e->vals);
+	memfree(MEM_SCRATCH, e->w);
+	memfree(MEM_SCRATCH, e->sq);
+	memfree(MEM_SCRATCH, e->r);
+	memfree(MEM_SCRATCH, e->c);
+	memfree(MEM_SCRATCH, e->strong);
+	memfree(MEM_SCRATCH, e->active);
+	memfree(MEM_SCRATCH, e->theta);
+	memfree(MEM_SCRATCH, e);
+}
+
+/*
+ * Runs passes over the strong columns until the cost settles. After a
+ * pass over every strong column, the ones that are not 0 are passed over
+ * alone until they settle too, which is where most of the passes go. Once
+ * a full pass settles, the columns left out are checked, and the ones
+ * that would not stay at 0 become strong.
+ */
+static void enetsolve(Enet* e, double lambda) {
+	size_t n = e->n;
+	double tol = ENET_TOL * e->null;
+	double l1 = lambda * enetmix;
+	size_t passes = 0;
+
+	while (1) {
+		while (passes < ENET_PASSES) {
+			double moved = 0;
+			size_t na = 0;
+			for (size_t j = 0; j < n; j++) {
+				if (e->strong[j]) {
+					moved = fmax(moved, enetcoord(e, j, lambda));
+					if (e->theta[j] != 0) {
+						e->active[na++] = j;
+					}
+				}
+			}
+			moved = fmax(moved, enetbias(e));
+			passes++;
+
+			if (moved <= tol) {
+				break;
+			}
+
+			while (passes < ENET_PASSES) {
+				moved = 0;
+				for (size_t q = 0; q < na; q++) {
+					moved = fmax(moved, enetcoord(e, e->active[q], lambda));
+				}
+				moved = fmax(moved, enetbias(e));
+				passes++;
+
+				if (moved <= tol) {
+					break;
+				}
+			}
+		}
+
+		short added = 0;
+		for (size_t j = 0; j < n; j++) {
+			e->c[j] = enetcorr(e, j);
+			if (!e->strong[j] && fabs(e->c[j]) > l1) {
+				e->strong[j] = 1;
+				added = 1;
+			}
+		}
+
+		if (!added || passes >= ENET_PASSES) {
+			return;
+		}
+	}
+}
+
+/*
+ * Sets theta[j] to the value with the lowest cost given every other
+ * parameter, and updates the residuals. Returns how much the cost of the
+ * squared errors changed, about.
+ */
+static double enetcoord(Enet* e, size_t j, double lambda) {
+	double sq = e->sq[j];
+	if (sq == 0) {
+		return 0;
+	}
+
+	size_t from = e->start[j];
+	size_t to = e->start[j + 1];
+	size_t* restrict idx = e->idx;
+	float* restrict vals = e->vals;
+	double* restrict r = e->r;
+	double* restrict w = e->w;
+	e->updates++;
+
+	double z = sq * e->theta[j];
+	for (size_t q = from; q < to; q++) {
+		z += w[idx[q]] * vals[q] * r[idx[q]];
+	}
+
+	double l1 = lambda * enetmix;
+	double t = z > l1 ? z - l1 : z < -l1 ? z + l1 : 0;
+	t /= sq + lambda * (1 - enetmix);
+
+	double d = t - e->theta[j];
+	if (d != 0) {
+		for (size_t q = from; q < to; q++) {
+			r[idx[q]] -= d * vals[q];
+		}
+		e->theta[j] = t;
+	}
+
+	return sq * d * d;
+}
+
+/*
+ * Sets the bias, which is not penalized, to the weighted mean of the
+ * residuals it leaves.
+ */
+static double enetbias(Enet* e) {
+	size_t m = e->m;
+	double d = 0;
+	for (size_t i = 0; i < m; i++) {
+		d += e->w[i] * e->r[i];
+	}
+
+	if (d != 0) {
+		for (size_t i = 0; i < m; i++) {
+			e->r[i] -= d;
+		}
+		e->bias += d;
+	}
+
+	return d * d;
+}
+
+static double enetcorr(Enet* e, size_t j) {
+	double sum = 0;
+	for (size_t q = e->start[j]; q < e->start[j + 1]; q++) {
+		sum += e->w[e->idx[q]] * e->vals[q] * e->r[e->idx[q]];
+	}
+	return sum;
+}
+
+static double enetcost(Enet* e, double lambda) {
+	double sum = 0;
+	for (size_t i = 0; i < e->m; i++) {
+		sum += e->w[i] * e->r[i] * e->r[i];
+	}
+
+	double l1 = 0;
+	double l2 = 0;
+	for (size_t j = 0; j < e->n; j++) {
+		l1 += fabs(e->theta[j]);
+		l2 += e->theta[j] * e->theta[j];
+	}
+
+	return sum / 2 + lambda * (enetmix * l1 + (1 - enetmix) / 2 * l2);
+}
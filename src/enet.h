@@ -0,0 +1,19 @@
+/*
+ * enet.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef ENET_H_
+#define ENET_H_
+
+#include "ml.h"
+
+extern double enetmix;
+
+double enetpath(Matrix* X, LinearModel* model, Matrix* y, Matrix* xtest,
+		Matrix* ytest);
+void enetfit(Matrix* X, LinearModel* model, Matrix* y, double lambda);
+
+#endif /* ENET_H_ */
@@ -0,0 +1,146 @@
+/*
+ * expand.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "expand.h"
+#include "mem.h"
+
+//degree and terms of the expansion used when training, 1 keeps the
+//features as they are.
+size_t expdegree = 1;
+short expterms = EXP_ALL;
+
+/*
+ * Creates the expansion of n base features up to the given degree. The
+ * products of each degree are generated from the ones of the previous
+ * degree, multiplying by every base feature at or after (EXP_ALL) or
+ * strictly after (EXP_CROSS) their last factor, so each monomial shows up
+ * exactly once. Returns NULL if there would be more than EXP_MAX features.
+ */
+Expand* expnew(size_t n, size_t degree, short kind) {
+	size_t skip = kind == EXP_CROSS ? 1 : 0;
+
+	//count[f] is the number of terms of the current degree whose last
+	//factor is f, enough to know the length before building anything.
+	size_t* count = memalloc(MEM_SCRATCH, sizeof(size_t) * (n + 1));
+	for (size_t f = 0; f < n; f++) {
+		count[f] = 1;
+	}
+
+	size_t length = n;
+	for (size_t d = 2; d <= degree && length <= EXP_MAX; d++) {
+		size_t below = 0;
+		for (size_t f = 0; f < n; f++) {
+			size_t c = count[f];
+			count[f] = skip ? below : below + c;
+			below += c;
+			if (below > EXP_MAX) {
+				below = EXP_MAX + 1;
+			}
+			length += count[f];
+			if (length > EXP_MAX) {
+				break;
+			}
+		}
+	}
+	memfree(MEM_SCRATCH, count);
+
+	if (length > EXP_MAX) {
+		fflush(stdout);
+		fprintf(stderr, "A degree %zu expansion of %zu features has more than "
+				"%d features.\n", degree, n, EXP_MAX);
+		fflush(stderr);
+		return NULL;
+	}
+
+	Expand* e = memalloc(MEM_MODEL, sizeof(Expand));
+	e->n = n;
+	e->length = length;
+	e->degree = degree;
+	e->kind = kind;
+	e->parent = memalloc(MEM_MODEL, sizeof(size_t) * (length - n + 1));
+	e->factor = memalloc(MEM_MODEL, sizeof(size_t) * (length - n + 1));
+
+	//[lo, hi) are the features of the previous degree.
+	size_t lo = 0;
+	size_t hi = n;
+	size_t t = 0;
+	for (size_t d = 2; d <= degree; d++) {
+		for (size_t p = lo; p < hi; p++) {
+			size_t last = p < n ? p : e->factor[p - n];
+			for (size_t f = last + skip; f < n; f++) {
+				e->parent[t] = p;
+				e->factor[t] = f;
+				t++;
+			}
+		}
+		lo = hi;
+		hi = n + t;
+	}
+
+	return e;
+}
+
+Expand* expcopy(Expand* e) {
+	if (e == NULL) {
+		return NULL;
+	}
+
+	size_t terms = e->length - e->n + 1;
+	Expand* copy = memalloc(MEM_MODEL, sizeof(Expand));
+	*copy = *e;
+	copy->parent = memalloc(MEM_MODEL, sizeof(size_t) * terms);
+	copy->factor = memalloc(MEM_MODEL, sizeof(size_t) * terms);
+	memcpy(copy->parent, e->parent, sizeof(size_t) * terms);
+	memcpy(copy->factor, e->factor, sizeof(size_t) * terms);
+
+	return copy;
+}
+
+void expfree(Expand* e) {
+	if (e) {
+		memfree(MEM_MODEL, e->parent);
+		memfree(MEM_MODEL, e->factor);
+		memfree(MEM_MODEL, e);
+	}
+}
+
+/*
+ * Expands a row in place. x holds the n base features and must have room
+ * for length values.
+ */
+void expapply(Expand* e, float* x) {
+	size_t n = e->n;
+	size_t length = e->length;
+	size_t* restrict parent = e->parent;
+	size_t* restrict factor = e->factor;
+
+	for (size_t t = n; t < length; t++) {
+		x[t] = x[parent[t - n]] * x[factor[t - n]];
+	}
+}
+
+short expkind(char* name) {
+	for (short k = EXP_ALL; k <= EXP_CROSS; k++) {
+		if (strcmp(name, expkindname(k)) == 0) {
+			return k;
+		}
+	}
+
+	return -1;
+}
+
+char* expkindname(short kind) {
+	switch (kind) {
+	case EXP_CROSS:
+		return "cross";
+	default:
+		return "all";
+	}
+}
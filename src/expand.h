@@ -0,0 +1,47 @@
+/*
+ * expand.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef EXPAND_H_
+#define EXPAND_H_
+
+#include <stddef.h>
+
+//terms of an expansion: every product of the features up to the degree,
+//or only the products of distinct features.
+#define EXP_ALL 0
+#define EXP_CROSS 1
+
+//largest number of features an expansion may produce.
+#define EXP_MAX 1048576
+
+/*
+ * Polynomial expansion of a row of n base features. The expanded row keeps
+ * the base features in [0, n) and appends length - n products, in order of
+ * degree. The t-th product is the product of an earlier feature,
+ * parent[t - n], and the base feature factor[t - n], so a row is expanded in
+ * place with one multiplication per term.
+ */
+typedef struct Expand{
+	size_t n;
+	size_t length;
+	size_t degree;
+	short kind;
+	size_t* parent;
+	size_t* factor;
+}Expand;
+
+extern size_t expdegree;
+extern short expterms;
+
+Expand* expnew(size_t n, size_t degree, short kind);
+Expand* expcopy(Expand* e);
+void expfree(Expand* e);
+void expapply(Expand* e, float* x);
+short expkind(char* name);
+char* expkindname(short kind);
+
+#endif /* EXPAND_H_ */
@@ -0,0 +1,109 @@
+/*
+ * kernel.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+
+#include "kernel.h"
+
+#define KERNEL_UNROLL _Pragma("GCC unroll 32")
+
+/*
+ * Defines stogd<N>. Since N is a constant, the loops over the features are
+ * fully unrolled, and theta and the gradient stay in registers for the
+ * whole call instead of going through memory on every row.
+ */
+#define STOGD_KERNEL(N) \
+static void stogd##N(float* vals, float* ans, size_t* order, size_t m, \
+		double* bias, double* theta, double alpha, double lambda, \
+		unsigned int batch, unsigned int steps) { \
+	double t[N]; \
+	double g[N]; \
+	double b = *bias; \
+	KERNEL_UNROLL \
+	for (size_t k = 0; k < N; k++) { \
+		t[k] = theta[k]; \
+	} \
+	\
+	size_t i = 0; \
+	for (unsigned int s = 0; s < steps; s++) { \
+		double g0 = 0.0; \
+		KERNEL_UNROLL \
+		for (size_t k = 0; k < N; k++) { \
+			g[k] = 0.0; \
+		} \
+		\
+		for (unsigned int c = 0; c < batch; c++) { \
+			size_t r = order[i]; \
+			size_t p = i + KERNEL_PREFETCH; \
+			__builtin_prefetch(vals + order[p < m ? p : p % m] * N); \
+			float* x = vals + r * N; \
+			double hi = b; \
+			KERNEL_UNROLL \
+			for (size_t k = 0; k < N; k++) { \
+				hi += x[k] * t[k]; \
+			} \
+			hi -= ans[r]; \
+			\
+			g0 += hi; \
+			KERNEL_UNROLL \
+			for (size_t k = 0; k < N; k++) { \
+				g[k] += hi * x[k]; \
+			} \
+			\
+			i++; \
+			if (i >= m) { \
+				i = 0; \
+			} \
+		} \
+		\
+		if (batch > 1) { \
+			g0 /= batch; \
+			KERNEL_UNROLL \
+			for (size_t k = 0; k < N; k++) { \
+				g[k] /= batch; \
+			} \
+		} \
+		\
+		b = b - alpha * g0; \
+		KERNEL_UNROLL \
+		for (size_t k = 0; k < N; k++) { \
+			t[k] = t[k] * (1 - alpha * lambda) - alpha * g[k]; \
+		} \
+	} \
+	\
+	*bias = b; \
+	KERNEL_UNROLL \
+	for (size_t k = 0; k < N; k++) { \
+		theta[k] = t[k]; \
+	} \
+}
+
+#define KERNEL_SIZES(K) \
+	K(1) K(2) K(3) K(4) K(5) K(6) K(7) K(8) \
+	K(9) K(10) K(11) K(12) K(13) K(14) K(15) K(16) \
+	K(17) K(18) K(19) K(20) K(21) K(22) K(23) K(24) \
+	K(25) K(26) K(27) K(28) K(29) K(30) K(31) K(32)
+
+KERNEL_SIZES(STOGD_KERNEL)
+
+#define STOGD_ENTRY(N) [N] = stogd##N,
+
+static const StogdKernel stogdkernels[KERNEL_MAX + 1] = {
+	KERNEL_SIZES(STOGD_ENTRY)
+};
+
+/*
+ * Returns the kernel for n features, or NULL when n is above KERNEL_MAX and
+ * the generic loop has to be used.
+ */
+StogdKernel stogdkernel(size_t n) {
+	if (n > KERNEL_MAX) {
+		return NULL;
+	}
+
+	return stogdkernels[n];
+}
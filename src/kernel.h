@@ -0,0 +1,31 @@
+/*
+ * kernel.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef KERNEL_H_
+#define KERNEL_H_
+
+#include <stddef.h>
+
+//largest number of features with a specialized kernel.
+#define KERNEL_MAX 32
+
+//rows ahead of the current one that are prefetched.
+#define KERNEL_PREFETCH 4
+
+/*
+ * Runs the steps of stogdcent for a fixed number of features, with the
+ * same arithmetic, so the result is identical to the generic loop. The
+ * rows are visited in the order given by order, which holds the m row
+ * indices, drawn by weight when the rows are weighted.
+ */
+typedef void (*StogdKernel)(float* vals, float* ans, size_t* order, size_t m,
+		double* bias, double* theta, double alpha, double lambda,
+		unsigned int batch, unsigned int steps);
+
+StogdKernel stogdkernel(size_t n);
+
+#endif /* KERNEL_H_ */
@@ -0,0 +1,343 @@
+/*
+ * lbfgs.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lbfgs.h"
+#include "quant.h"
+#include "pool.h"
+#include "mem.h"
+#include "prof.h"
+#include "telem.h"
+
+//correction pairs kept, and most iterations of a call.
+#define LBFGS_PAIRS 8
+#define LBFGS_ITERS 200
+//the solver stops once an iteration lowers the cost by less than this
+//share of it, or the gradient norm is below LBFGS_GRAD.
+#define LBFGS_TOL 1e-9
+#define LBFGS_GRAD 1e-7
+//sufficient decrease of the line search, and most halvings of its step.
+#define LBFGS_ARMIJO 1e-4
+#define LBFGS_HALVINGS 40
+//rows of each task of a gradient pass.
+#define LBFGS_ROWS 4096
+
+//threads of the gradient passes of a call, 0 uses one per cpu. Callers
+//that already train on several threads give each call its share.
+size_t lbfgsthreads = 0;
+
+/*
+ * Rows [from, to) of a gradient pass. The parameters v are the bias
+ * followed by theta, and grad gets the gradient of the weighted squared
+ * error of the rows, in the same layout.
+ */
+typedef struct GradTask{
+	Matrix* X;
+	float* ans;
+	size_t from;
+	size_t to;
+	double* v;
+	double* grad;
+	double sum;
+	double total;
+	float* row;
+}GradTask;
+
+/*
+ * The gradient passes of a call, which reuse their tasks and pool.
+ */
+typedef struct GradPass{
+	Matrix* X;
+	double lambda;
+	size_t tasks;
+	GradTask* list;
+	Pool* pool;
+}GradPass;
+
+static void gradrows(void* arg);
+static double gradpass(GradPass* pass, double* v, double* grad);
+static double dot(double* a, double* b, size_t n);
+
+/*
+ * Minimizes j(X, model, y, lambda) over every row at once with L-BFGS,
+ * starting at the current parameters. Each iteration takes the direction
+ * given by the last LBFGS_PAIRS changes of the parameters and of the
+ * gradient, and halves its step until the cost drops enough. The rows of a
+ * gradient pass are split in blocks of LBFGS_ROWS read by different
+ * threads, and the blocks are added in order, so the result does not
+ * depend on the number of threads.
+ */
+void lbfgs(Matrix* X, LinearModel* model, Matrix* y, double lambda) {
+	profbegin("lbfgs");
+	size_t m = X->m;
+	size_t n = X->n;
+	size_t len = n + 1;
+
+	GradPass pass;
+	pass.X = X;
+	pass.lambda = lambda;
+	pass.tasks = (m + LBFGS_ROWS - 1) / LBFGS_ROWS;
+	pass.tasks = pass.tasks < 1 ? 1 : pass.tasks;
+	pass.list = memalloc(MEM_SCRATCH, sizeof(GradTask) * pass.tasks);
+	for (size_t t = 0; t < pass.tasks; t++) {
+		GradTask* task = pass.list + t;
+		task->X = X;
+		task->ans = y->values;
+		task->from = t * LBFGS_ROWS;
+		task->to = task->from + LBFGS_ROWS < m ? task->from + LBFGS_ROWS : m;
+		task->grad = memalloc(MEM_SCRATCH, sizeof(double) * len);
+		task->row = memalloc(MEM_SCRATCH, sizeof(float) * n);
+	}
+	size_t threads = lbfgsthreads ? lbfgsthreads : cpucount();
+	threads = threads > pass.tasks ? pass.tasks : threads;
+	pass.pool = threads > 1 ? poolnew(threads) : NULL;
+
+	double* v = memalloc(MEM_SCRATCH, sizeof(double) * len);
+	double* g = memalloc(MEM_SCRATCH, sizeof(double) * len);
+	double* vnew = memalloc(MEM_SCRATCH, sizeof(double) * len);
+	double* gnew = memalloc(MEM_SCRATCH, sizeof(double) * len);
+	double* d = memalloc(MEM_SCRATCH, sizeof(double) * len);
+	double* snew = memalloc(MEM_SCRATCH, sizeof(double) * len);
+	double* znew = memalloc(MEM_SCRATCH, sizeof(double) * len);
+	double* s = memalloc(MEM_SCRATCH, sizeof(double) * len * LBFGS_PAIRS);
+	double* z = memalloc(MEM_SCRATCH, sizeof(double) * len * LBFGS_PAIRS);
+	double rho[LBFGS_PAIRS];
+	double a[LBFGS_PAIRS];
+
+	v[0] = model->bias;
+	memcpy(v + 1, model->theta, sizeof(double) * n);
+	double f = gradpass(&pass, v, g);
+
+	TelemRecord rec;
+	memset(&rec, 0, sizeof(TelemRecord));
+	rec.kind = TELEM_EPOCH;
+	rec.lambda = lambda;
+	if (telem.on) {
+		rec.loss = f;
+		rec.accepted = 1;
+		rec.grad = sqrt(dot(g, g, len));
+		telemrecord(&rec);
+	}
+
+	//the pairs are kept in a ring, the newest one at (head + count - 1).
+	size_t head = 0;
+	size_t count = 0;
+
+	for (int it = 1; it <= LBFGS_ITERS; it++) {
+		//d = -H g, with H built from the pairs by the two loop recursion.
+		memcpy(d, g, sizeof(double) * len);
+		for (size_t c = count; c-- > 0;) {
+			size_t p = (head + c) % LBFGS_PAIRS;
+			a[p] = rho[p] * dot(s + p * len, d, len);
+			for (size_t k = 0; k < len; k++) {
+				d[k] -= a[p] * z[p * len + k];
+			}
+		}
+
+		double gamma;
+		if (count > 0) {
+			size_t p = (head + count - 1) % LBFGS_PAIRS;
+			double* zp = z + p * len;
+			gamma = 1 / (rho[p] * dot(zp, zp, len));
+		} else {
+			//the first step moves the parameters by at most 1.
+			double gn = sqrt(dot(g, g, len));
+			gamma = gn > 1 ? 1 / gn : 1;
+		}
+		for (size_t k = 0; k < len; k++) {
+			d[k] *= gamma;
+		}
+
+		for (size_t c = 0; c < count; c++) {
+			size_t p = (head + c) % LBFGS_PAIRS;
+			double b = rho[p] * dot(z + p * len, d, len);
+			for (size_t k = 0; k < len; k++) {
+				d[k] += (a[p] - b) * s[p * len + k];
+			}
+		}
+
+		for (size_t k = 0; k < len; k++) {
+			d[k] = -d[k];
+		}
+
+		double dg = dot(d, g, len);
+		if (dg >= 0) {
+			//not a descent direction, the pairs are dropped.
+			count = 0;
+			for (size_t k = 0; k < len; k++) {
+				d[k] = -g[k];
+			}
+			dg = -dot(g, g, len);
+		}
+
+		double step = 1;
+		double fnew = f;
+		short found = 0;
+		for (int hv = 0; hv < LBFGS_HALVINGS; hv++) {
+			for (size_t k = 0; k < len; k++) {
+				vnew[k] = v[k] + step * d[k];
+			}
+			fnew = gradpass(&pass, vnew, gnew);
+			if (fnew <= f + LBFGS_ARMIJO * step * dg) {
+				found = 1;
+				break;
+			}
+			step /= 2;
+		}
+
+		if (!found) {
+			break;
+		}
+
+		for (size_t k = 0; k < len; k++) {
+			snew[k] = vnew[k] - v[k];
+			znew[k] = gnew[k] - g[k];
+		}
+
+		//pairs without positive curvature would break H. The pair is only
+		//copied in to the ring once it passes, since with a full ring its
+		//slot is the one of the oldest pair.
+		double sz = dot(snew, znew, len);
+		if (sz > 1e-12 * sqrt(dot(snew, snew, len) * dot(znew, znew, len))) {
+			size_t p = (head + count) % LBFGS_PAIRS;
+			memcpy(s + p * len, snew, sizeof(double) * len);
+			memcpy(z + p * len, znew, sizeof(double) * len);
+			rho[p] = 1 / sz;
+			if (count < LBFGS_PAIRS) {
+				count++;
+			} else {
+				head = (head + 1) % LBFGS_PAIRS;
+			}
+		}
+
+		double drop = f - fnew;
+		memcpy(v, vnew, sizeof(double) * len);
+		memcpy(g, gnew, sizeof(double) * len);
+		f = fnew;
+
+		double gn = sqrt(dot(g, g, len));
+		if (telem.on) {
+			rec.epoch = it;
+			rec.loss = f;
+			rec.alpha = step;
+			rec.grad = gn;
+			telemrecord(&rec);
+		}
+
+		if (drop <= LBFGS_TOL * fabs(f) || gn < LBFGS_GRAD) {
+			break;
+		}
+	}
+
+	model->bias = v[0];
+	memcpy(model->theta, v + 1, sizeof(double) * n);
+
+	if (pass.pool) {
+		poolfree(pass.pool);
+	}
+	for (size_t t = 0; t < pass.tasks; t++) {
+		memfree(MEM_SCRATCH, pass.list[t].grad);
+		memfree(MEM_SCRATCH, pass.list[t].row);
+	}
+	memfree(MEM_SCRATCH, pass.list);
+	memfree(MEM_SCRATCH, v);
+	memfree(MEM_SCRATCH, g);
+	memfree(MEM_SCRATCH, vnew);
+	memfree(MEM_SCRATCH, gnew);
+	memfree(MEM_SCRATCH, d);
+	memfree(MEM_SCRATCH, snew);
+	memfree(MEM_SCRATCH, znew);
+	memfree(MEM_SCRATCH, s);
+	memfree(MEM_SCRATCH, z);
+	profend();
+}
+
+static void gradrows(void* arg) {
+	GradTask* task = arg;
+	Matrix* X = task->X;
+	size_t n = X->n;
+	float* weights = X->weights;
+	double* v = task->v;
+	double* grad = task->grad;
+
+	memset(grad, 0, sizeof(double) * (n + 1));
+	double sum = 0.0;
+	double total = 0.0;
+	for (size_t i = task->from; i < task->to; i++) {
+		float* x = mtrload(X, i, task->row);
+		double w = weights ? weights[i] : 1.0;
+		double e = h(x, n, v[0], v + 1) - task->ans[i];
+		double we = w * e;
+
+		sum += we * e;
+		total += w;
+		grad[0] += we;
+		for (size_t k = 0; k < n; k++) {
+			grad[k + 1] += we * x[k];
+		}
+	}
+
+	task->sum = sum;
+	task->total = total;
+}
+
+/*
+ * Returns j at the parameters v, the bias followed by theta, and sets grad
+ * to its gradient.
+ */
+static double gradpass(GradPass* pass, double* v, double* grad) {
+	size_t n = pass->X->n;
+	size_t tasks = pass->tasks;
+	GradTask* list = pass->list;
+
+	for (size_t t = 0; t < tasks; t++) {
+		list[t].v = v;
+	}
+
+	if (pass->pool) {
+		for (size_t t = 0; t < tasks; t++) {
+			poolsubmit(pass->pool, gradrows, list + t);
+		}
+		poolwait(pass->pool);
+	} else {
+		for (size_t t = 0; t < tasks; t++) {
+			gradrows(list + t);
+		}
+	}
+
+	memcpy(grad, list[0].grad, sizeof(double) * (n + 1));
+	double sum = list[0].sum;
+	double total = list[0].total;
+	for (size_t t = 1; t < tasks; t++) {
+		for (size_t k = 0; k <= n; k++) {
+			grad[k] += list[t].grad[k];
+		}
+		sum += list[t].sum;
+		total += list[t].total;
+	}
+
+	double lambda = pass->lambda;
+	double reg = lambda * dot(v + 1, v + 1, n);
+	grad[0] /= total;
+	for (size_t k = 1; k <= n; k++) {
+		grad[k] = (grad[k] + lambda * v[k]) / total;
+	}
+
+	profcount(PROF_GRAD_PASSES, 1);
+	profcount(PROF_COST_ROWS, pass->X->m);
+	return (sum + reg) / (2 * total);
+}
+
+static double dot(double* a, double* b, size_t n) {
+	double sum = 0.0;
+	for (size_t k = 0; k < n; k++) {
+		sum += a[k] * b[k];
+	}
+	return sum;
+}
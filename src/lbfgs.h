@@ -0,0 +1,17 @@
+/*
+ * lbfgs.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef LBFGS_H_
+#define LBFGS_H_
+
+#include "ml.h"
+
+extern size_t lbfgsthreads;
+
+void lbfgs(Matrix* X, LinearModel* model, Matrix* y, double lambda);
+
+#endif /* LBFGS_H_ */
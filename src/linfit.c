@@ -23,8 +23,30 @@
 #include "utils.h"
 #include "ml.h"
 #include "ui.h"
+#include "artifact.h"
+#include "score.h"
+#include "serve.h"
+#include "runner.h"
+#include "bench.h"
+#include "synth.h"
+#include "prof.h"
+#include "telem.h"
+#include "mem.h"
+#include "quant.h"
+#include "stream.h"
+#include "refresh.h"
+#include "rng.h"
+#include "enet.h"
+#include "test.h"
 
+//whether --seed was given, otherwise train and the interactive mode take
+//the seed from the clock.
+static short seeded = 0;
+
+int command(int argc, char** argv);
 int start();
+int trainmain(int argc, char** argv);
+int infomain(int argc, char** argv);
 
 /*
  * Reads any *.data file under the <CURRENT_DIR>/files directory, allowing the 
@@ -32,13 +54,271 @@ int start();
  * (asuming ',' is the delimiter), and build the X and y matrices, where X
  * is the features matrix. Next, compute the cost before and after
  * training and prints it in the standard output.
+ *
+ * When a command is given, the program runs without user interaction:
+ *
+ *   linfit train <data file> <model file>
+ *   linfit info <model file>
+ *   linfit score <model file> <input file> <output file> [threads]
+ *   linfit serve <model file> <socket path> [max batch] [max wait]
+ *   linfit run <list file | directory> [threads]
+ *   linfit bench [--runs N] [--json <file>] [--baseline <file>] [files...]
+ *   linfit synth <output file> [dataset options]
+ *   linfit scale [--sizes 1000,10000,...] [--no-train] [dataset options]
+ *   linfit quant <data file>
+ *   linfit stream <model file> [--every N] [--alpha a] [--lambda l]
+ *   linfit refresh <data file> <model file>
+ *   linfit test [names...]
+ *
+ * The following options go before the command, and apply to any of them:
+ *
+ *   --profile <file>    writes the phase timers and counters as JSON.
+ *   --trace <file>      writes the phases in Chrome trace event format.
+ *   --telemetry <file>  writes the loss, learning rate and gradient norm of
+ *                       every training epoch and lambda, as JSON lines.
+ *   --memory <file>     writes the current and peak bytes allocated by each
+ *                       subsystem, and the peak RSS of the process.
+ *   --storage <type>    stores X while training as f32 (default), bf16,
+ *                       fp16 or int8.
+ *   --seed <n>          seeds the shuffles and the initial weights, so
+ *                       training gives the same models on every run.
+ *   --hash-above <n>    hashes the word columns with more than n distinct
+ *                       values instead of giving each value a column
+ *                       (default 1000, 0 never hashes).
+ *   --buckets <n>       columns of each hashed word column (default 256).
+ *   --degree <d>        trains on the products of the features up to
+ *                       degree d, computed from each row as it is read
+ *                       (default 1, the features as they are).
+ *   --terms <kind>      products of the expansion: all (default), or cross
+ *                       for the products of distinct features only.
+ *   --sample <n>        infers the type of each column from n rows spread
+ *                       over the file (default 1000, 0 reads every row). A
+ *                       number column with a word past the sample is read
+ *                       again as a word column.
+ *   --features <list>   trains on the given columns only, numbered from 1,
+ *                       like 1,4-6. The other columns are skipped while
+ *                       reading the file. Files to score have every column.
+ *   --target <n>        predicts the column n instead of the last one.
+ *   --min-support <n>   leaves out of training the encoded features that
+ *                       are not 0 in at least n rows, and the constant and
+ *                       duplicated ones (default 0, keeps them all). 1
+ *                       leaves out only the constant and duplicated ones.
+ *   --dedup <on|off>    trains on each distinct encoded row once, weighted
+ *                       by the number of times it shows up (default off).
+ *                       The rows are collapsed before the train and test
+ *                       split, so all the copies of a row land on the same
+ *                       side, and the chosen lambda and the reported cost
+ *                       can differ from the ones without it.
+ *   --engine <name>     optimizer of each lambda: sgd, mini-batch gradient
+ *                       descent (default), lbfgs, full-batch L-BFGS, or cd,
+ *                       an elastic net fit by coordinate descent over its
+ *                       own path of lambdas.
+ *   --l1-ratio <a>      share of the cd penalty on |theta|, from 0 (ridge)
+ *                       to 1 (lasso, default).
  */
-int main(void) {
+int main(int argc, char** argv) {
+
+	char* profile = NULL;
+	char* trace = NULL;
+	char* telemetry = NULL;
+	char* memory = NULL;
+	short storage = MTR_F32;
+
+	int i = 1;
+	while (i + 1 < argc) {
+		if (strcmp(argv[i], "--profile") == 0) {
+			profile = argv[i + 1];
+		} else if (strcmp(argv[i], "--trace") == 0) {
+			trace = argv[i + 1];
+		} else if (strcmp(argv[i], "--telemetry") == 0) {
+			telemetry = argv[i + 1];
+		} else if (strcmp(argv[i], "--memory") == 0) {
+			memory = argv[i + 1];
+		} else if (strcmp(argv[i], "--seed") == 0) {
+			rngseed = strtoull(argv[i + 1], NULL, 10);
+			seeded = 1;
+		} else if (strcmp(argv[i], "--hash-above") == 0) {
+			maphashabove = strtoul(argv[i + 1], NULL, 10);
+		} else if (strcmp(argv[i], "--buckets") == 0) {
+			mapbuckets = strtoul(argv[i + 1], NULL, 10);
+			if (mapbuckets == 0) {
+				fprintf(stderr, "--buckets must be at least 1.\n");
+				fflush(stderr);
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--degree") == 0) {
+			expdegree = strtoul(argv[i + 1], NULL, 10);
+			if (expdegree == 0) {
+				fprintf(stderr, "--degree must be at least 1.\n");
+				fflush(stderr);
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--terms") == 0) {
+			expterms = expkind(argv[i + 1]);
+			if (expterms == -1) {
+				fprintf(stderr, "Unknown terms '%s'.\n", argv[i + 1]);
+				fflush(stderr);
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--features") == 0) {
+			gfeatures = colparse(argv[i + 1], &gfeaturecount);
+			if (gfeatures == NULL) {
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--target") == 0) {
+			gtarget = (ssize_t) strtoul(argv[i + 1], NULL, 10) - 1;
+			if (gtarget < 0) {
+				fprintf(stderr, "--target must be at least 1.\n");
+				fflush(stderr);
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--min-support") == 0) {
+			prunesupport = strtoul(argv[i + 1], NULL, 10);
+		} else if (strcmp(argv[i], "--dedup") == 0) {
+			if (strcmp(argv[i + 1], "on") == 0) {
+				mtrdedupe = 1;
+			} else if (strcmp(argv[i + 1], "off") == 0) {
+				mtrdedupe = 0;
+			} else {
+				fprintf(stderr, "Expected on or off after --dedup, got '%s'.\n",
+						argv[i + 1]);
+				fflush(stderr);
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--engine") == 0) {
+			if (strcmp(argv[i + 1], "sgd") == 0) {
+				trainengine = ENGINE_SGD;
+			} else if (strcmp(argv[i + 1], "lbfgs") == 0) {
+				trainengine = ENGINE_LBFGS;
+			} else if (strcmp(argv[i + 1], "cd") == 0) {
+				trainengine = ENGINE_CD;
+			} else {
+				fprintf(stderr, "Unknown engine '%s'.\n", argv[i + 1]);
+				fflush(stderr);
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--l1-ratio") == 0) {
+			enetmix = strtod(argv[i + 1], NULL);
+			if (!(enetmix >= 0 && enetmix <= 1)) {
+				fprintf(stderr, "The l1 ratio must be between 0 and 1.\n");
+				fflush(stderr);
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--sample") == 0) {
+			ginfosample = strtoul(argv[i + 1], NULL, 10);
+		} else if (strcmp(argv[i], "--storage") == 0) {
+			storage = mtrtype(argv[i + 1]);
+			if (storage == -1) {
+				fprintf(stderr, "Unknown storage '%s'.\n", argv[i + 1]);
+				fflush(stderr);
+				return EXIT_FAILURE;
+			}
+		} else {
+			break;
+		}
+		i += 2;
+	}
+
+	if (profile || trace) {
+		profinit();
+	}
+
+	if (memory) {
+		meminit();
+	}
+
+	mtrstorage = storage;
+
+	if (telemetry && telemopen(telemetry) != 0) {
+		return EXIT_FAILURE;
+	}
+
+	int ret = command(argc - i, argv + i);
+	telemclose();
+
+	if (profile && profjson(profile) != 0) {
+		ret = EXIT_FAILURE;
+	}
+
+	if (trace && proftrace(trace) != 0) {
+		ret = EXIT_FAILURE;
+	}
+
+	if (memory && memjson(memory) != 0) {
+		ret = EXIT_FAILURE;
+	}
 
-	//srand(time(0));
-	int ret = start();
 	return ret;
-	//printf("%d", RAND_MAX);
+}
+
+/*
+ * Runs the command given by argv[0], or the interactive mode when there is
+ * no command.
+ */
+int command(int argc, char** argv) {
+
+	if (argc < 1) {
+		//srand(time(0));
+		int ret = start();
+		return ret;
+		//printf("%d", RAND_MAX);
+	}
+
+	char* cmd = argv[0];
+	argc--;
+	argv++;
+
+	if (strcmp(cmd, "train") == 0) {
+		return trainmain(argc, argv);
+	}
+
+	if (strcmp(cmd, "info") == 0) {
+		return infomain(argc, argv);
+	}
+
+	if (strcmp(cmd, "score") == 0) {
+		return scoremain(argc, argv);
+	}
+
+	if (strcmp(cmd, "serve") == 0) {
+		return servemain(argc, argv);
+	}
+
+	if (strcmp(cmd, "run") == 0) {
+		return runmain(argc, argv);
+	}
+
+	if (strcmp(cmd, "bench") == 0) {
+		return benchmain(argc, argv);
+	}
+
+	if (strcmp(cmd, "synth") == 0) {
+		return synthmain(argc, argv);
+	}
+
+	if (strcmp(cmd, "scale") == 0) {
+		return scalemain(argc, argv);
+	}
+
+	if (strcmp(cmd, "quant") == 0) {
+		return quantmain(argc, argv);
+	}
+
+	if (strcmp(cmd, "stream") == 0) {
+		return streammain(argc, argv);
+	}
+
+	if (strcmp(cmd, "refresh") == 0) {
+		return refreshmain(argc, argv);
+	}
+
+	if (strcmp(cmd, "test") == 0) {
+		return testmain(argc, argv);
+	}
+
+	fprintf(stderr, "Unknown command '%s'.\n", cmd);
+	fflush(stderr);
+	return EXIT_FAILURE;
 }
 
 /*
@@ -46,7 +326,10 @@ int main(void) {
  */
 int start() {
 
-	srand((unsigned) time(NULL));
+	if (!seeded) {
+		rngseed = (uint64_t) time(NULL);
+	}
+	rnginit(rngseed, 0);
 
 	char** fileNames = malloc(sizeof(char*) * 100);
 	size_t buflen = 1000;
@@ -92,3 +375,60 @@ int start() {
 
 	return EXIT_SUCCESS;
 }
+
+/*
+ * Trains the models of the given data file and saves them, together with
+ * the Mapper and GridInfo structs, in a model artifact.
+ */
+int trainmain(int argc, char** argv) {
+	if (argc != 2) {
+		fprintf(stderr, "Usage: linfit train <data file> <model file>\n");
+		fflush(stderr);
+		return EXIT_FAILURE;
+	}
+
+	if (!seeded) {
+		rngseed = (uint64_t) time(NULL);
+	}
+	rnginit(rngseed, 0);
+
+	Data* data = datastep(argv[0]);
+	printf("\n");
+	if (data == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	trainstep(data);
+
+	double* lambdas = datalambdas(data);
+	int ret = artsave(argv[1], data->map, data->info, data->expand,
+			data->prune, data->models, lambdas, trainengine, enetmix,
+			data->count, data->bytes);
+	free(lambdas);
+	if (ret == 0) {
+		printf("Model saved to %s.\n", argv[1]);
+	}
+
+	datafree(data);
+	return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * Loads a model artifact and prints its summary.
+ */
+int infomain(int argc, char** argv) {
+	if (argc != 1) {
+		fprintf(stderr, "Usage: linfit info <model file>\n");
+		fflush(stderr);
+		return EXIT_FAILURE;
+	}
+
+	Artifact* art = artload(argv[0]);
+	if (art == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	artprint(art);
+	artfree(art);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+/*
+ * mem.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include "mem.h"
+
+Memory mem;
+
+static char* memnames[MEM_TAGS] = { "raw", "grid", "info", "mapper",
+		"matrix", "model", "scratch" };
+
+static void memadd(int tag, int64_t bytes);
+static void memmax(int64_t* peak, int64_t value);
+
+/*
+ * Enables the accounting. Must be called before anything it should track is
+ * allocated, otherwise the frees of those blocks make the counts negative.
+ */
+void meminit() {
+	memset(&mem, 0, sizeof(Memory));
+	mem.on = 1;
+}
+
+void* memalloc(int tag, size_t bytes) {
+	void* ptr = malloc(bytes);
+	if (ptr && mem.on) {
+		memadd(tag, malloc_usable_size(ptr));
+	}
+	return ptr;
+}
+
+void* memcalloc(int tag, size_t count, size_t size) {
+	void* ptr = calloc(count, size);
+	if (ptr && mem.on) {
+		memadd(tag, malloc_usable_size(ptr));
+	}
+	return ptr;
+}
+
+/*
+ * Frees a block returned by memalloc or memcalloc with the same tag.
+ */
+void memfree(int tag, void* ptr) {
+	if (ptr == NULL) {
+		return;
+	}
+
+	if (mem.on) {
+		memadd(tag, -(int64_t) malloc_usable_size(ptr));
+	}
+	free(ptr);
+}
+
+/*
+ * Returns the peak resident set size of the process, in bytes.
+ */
+long mempeakrss() {
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return -1;
+	}
+
+	//ru_maxrss is in kilobytes on Linux.
+	return usage.ru_maxrss * 1024L;
+}
+
+/*
+ * Writes the current and peak bytes of each tag, the peak of their sum and
+ * the peak RSS of the process.
+ */
+int memjson(char* path) {
+	FILE* f = fopen(path, "w");
+	if (f == NULL) {
+		fflush(stdout);
+		fprintf(stderr, "Could not open %s for writing.\n", path);
+		fflush(stderr);
+		return -1;
+	}
+
+	fputs("{\"tags\":[", f);
+	for (int t = 0; t < MEM_TAGS; t++) {
+		fprintf(f, "%s\n{\"tag\":\"%s\",\"current\":%lld,\"peak\":%lld,"
+				"\"allocs\":%llu}", t ? "," : "", memnames[t],
+				(long long) mem.current[t], (long long) mem.peak[t],
+				(unsigned long long) mem.allocs[t]);
+	}
+
+	fprintf(f, "],\n\"current\":%lld,\"peak\":%lld,\"peak_rss\":%ld}\n",
+			(long long) mem.total, (long long) mem.totalpeak, mempeakrss());
+
+	return fclose(f) == 0 ? 0 : -1;
+}
+
+static void memadd(int tag, int64_t bytes) {
+	int64_t crt = __sync_add_and_fetch(&mem.current[tag], bytes);
+	int64_t total = __sync_add_and_fetch(&mem.total, bytes);
+
+	if (bytes > 0) {
+		__sync_fetch_and_add(&mem.allocs[tag], 1);
+		memmax(&mem.peak[tag], crt);
+		memmax(&mem.totalpeak, total);
+	}
+}
+
+static void memmax(int64_t* peak, int64_t value) {
+	int64_t old = __atomic_load_n(peak, __ATOMIC_RELAXED);
+	while (value > old
+			&& !__atomic_compare_exchange_n(peak, &old, value, 1,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
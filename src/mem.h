@@ -0,0 +1,46 @@
+/*
+ * mem.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef MEM_H_
+#define MEM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define MEM_RAW 0
+#define MEM_GRID 1
+#define MEM_INFO 2
+#define MEM_MAPPER 3
+#define MEM_MATRIX 4
+#define MEM_MODEL 5
+#define MEM_SCRATCH 6
+#define MEM_TAGS 7
+
+/*
+ * Bytes allocated by each subsystem. The sizes are the ones reported by the
+ * allocator, so they include its rounding. Nothing is counted until meminit
+ * is called.
+ */
+typedef struct Memory{
+	short on;
+	int64_t current[MEM_TAGS];
+	int64_t peak[MEM_TAGS];
+	uint64_t allocs[MEM_TAGS];
+	int64_t total;
+	int64_t totalpeak;
+}Memory;
+
+extern Memory mem;
+
+void meminit();
+void* memalloc(int tag, size_t bytes);
+void* memcalloc(int tag, size_t count, size_t size);
+void memfree(int tag, void* ptr);
+long mempeakrss();
+int memjson(char* path);
+
+#endif /* MEM_H_ */
@@ -10,29 +10,83 @@
 #include <math.h>
 #include <string.h>
 #include "ml.h"
+#include "prof.h"
+#include "telem.h"
+#include "mem.h"
+#include "kernel.h"
+#include "quant.h"
+#include "rng.h"
+#include "lbfgs.h"
+#include "enet.h"
 #include <pthread.h>
 
-void train(Matrix* X, LinearModel* model, Matrix* y) {
+//storage used for the X matrices while training, one of MTR_*.
+short mtrstorage = MTR_F32;
+//whether dataload collapses the identical rows in to weighted ones.
+short mtrdedupe = 0;
+//optimizer of train, one of ENGINE_*.
+short trainengine = ENGINE_SGD;
+
+//largest share of non zero values of X for which stogdcent only updates
+//the features of each batch, and the scale at which the lazy L2 decay is
+//folded back in to the parameters.
+#define SGD_SPARSE 0.25
+#define SGD_RESCALE 1e-30
+//fewest rows stogdcent draws from weighted rows, so the light ones show up
+//in proportion to their weight too.
+#define SGD_DRAWS 65536
+
+static double gradnorm(Matrix* X, LinearModel* model, Matrix* y,
+		double lambda);
+static short stogdsparse(Matrix* X, float* ans, size_t* order, size_t draws,
+		double* bias, double* theta, double alpha, double lambda,
+		unsigned int batch, unsigned int steps);
+static void stogdorder(Rng* rng, float* weights, size_t m, size_t* order,
+		size_t draws);
 
+/*
+ * Trains the model with each lambda of a fixed grid, using the first 70% of
+ * the rows, and keeps the parameters with the lowest cost on the remaining
+ * rows. Returns the chosen lambda. With weighted rows, the split is made at
+ * 70% of the total weight instead, and since each of them stands for all
+ * its copies, the copies are never on both sides of the split. Each lambda is fit by the optimizer set
+ * in trainengine, except for ENGINE_CD, which replaces the grid with its
+ * own path of lambdas.
+ */
+double train(Matrix* X, LinearModel* model, Matrix* y) {
+
+	profbegin("train");
 	modrand(model);
 
 	size_t m = X->m;
 	size_t n = X->n;
 	size_t trainIdx = floor(m * 0.7);
+	if (X->weights) {
+		double total = mtrweight(X, 0, m);
+		double cum = 0;
+		trainIdx = 0;
+		while (trainIdx + 1 < m && cum < total * 0.7) {
+			cum += X->weights[mtridx(X, trainIdx)];
+			trainIdx++;
+		}
+	}
 
-	Matrix* xtrain = mtrrange(X, 0, trainIdx);
+	//training only reads whole rows, so X can be kept in a compact type
+	//and widened as each row is loaded.
+	Matrix* xtrain = mtrpack(X, 0, trainIdx, mtrstorage);
 	Matrix* ytrain = mtrrange(y, 0, trainIdx);
 
-	Matrix* xtest = mtrrange(X, trainIdx, m);
+	Matrix* xtest = mtrpack(X, trainIdx, m, mtrstorage);
 	Matrix* ytest = mtrrange(y, trainIdx, m);
 
+	//on the heap, since hashed and one-hot columns can make n large.
 	double originalBias = model->bias;
-	double originalTheta[n];
+	double* originalTheta = memalloc(MEM_SCRATCH, sizeof(double) * n);
 	copyd(originalTheta, model->theta, n);
 
 	double lwlambda = 0;
 	double lwbias = model->bias;
-	double lwtheta[n];
+	double* lwtheta = memalloc(MEM_SCRATCH, sizeof(double) * n);
 	copyd(lwtheta, model->theta, n);
 
 	double lwj = j(xtest, model, ytest, 0);
@@ -41,10 +95,32 @@ void train(Matrix* X, LinearModel* model, Matrix* y) {
 			100, 300 };
 	size_t length = sizeof(lambdas) / sizeof(double);
 
+	//the elastic net path replaces the grid, and already keeps the lambda
+	//with the lowest cost on the test rows.
+	if (trainengine == ENGINE_CD) {
+		lwlambda = enetpath(xtrain, model, ytrain, xtest, ytest);
+		lwbias = model->bias;
+		copyd(lwtheta, model->theta, n);
+		length = 0;
+	}
+
 	for (int i = 0; i < length; i++) {
 		double lambda = lambdas[i];
-		autostogdcent(xtrain, model, ytrain, lambda);
+		profbeginarg("lambda", lambda);
+		enginefit(xtrain, model, ytrain, lambda);
 		double newj = j(xtest, model, ytest, 0);
+
+		if (telem.on) {
+			TelemRecord rec;
+			memset(&rec, 0, sizeof(TelemRecord));
+			rec.kind = TELEM_LAMBDA;
+			rec.lambda = lambda;
+			rec.loss = j(xtrain, model, ytrain, lambda);
+			rec.test = newj;
+			rec.accepted = newj < lwj;
+			telemrecord(&rec);
+		}
+
 		if (newj < lwj) {
 			lwbias = model->bias;
 			copyd(lwtheta, model->theta, n);
@@ -56,6 +132,7 @@ void train(Matrix* X, LinearModel* model, Matrix* y) {
 			model->bias = originalBias;
 			copyd(model->theta, originalTheta, n);
 		}
+		profend();
 	}
 
 	mtrfree(xtrain);
@@ -63,10 +140,43 @@ void train(Matrix* X, LinearModel* model, Matrix* y) {
 	mtrfree(xtest);
 	mtrfree(ytest);
 	
-	printf("lambda: %f\n", lwlambda);
 	model->bias = lwbias;
 	copyd(model->theta, lwtheta, n);
+	memfree(MEM_SCRATCH, originalTheta);
+	memfree(MEM_SCRATCH, lwtheta);
 
+	profend();
+	return lwlambda;
+
+}
+
+/*
+ * Fits the model for a single lambda with the optimizer set in
+ * trainengine, starting from its current parameters.
+ */
+void enginefit(Matrix* X, LinearModel* model, Matrix* y, double lambda) {
+	switch (trainengine) {
+	case ENGINE_LBFGS:
+		lbfgs(X, model, y, lambda);
+		break;
+	case ENGINE_CD:
+		enetfit(X, model, y, lambda);
+		break;
+	default:
+		autostogdcent(X, model, y, lambda);
+		break;
+	}
+}
+
+char* enginename(short engine) {
+	switch (engine) {
+	case ENGINE_LBFGS:
+		return "lbfgs";
+	case ENGINE_CD:
+		return "cd";
+	default:
+		return "sgd";
+	}
 }
 
 void autostogdcent(Matrix* X, LinearModel* model, Matrix* y, double lambda) {
@@ -88,16 +198,40 @@ void autostogdcent(Matrix* X, LinearModel* model, Matrix* y, double lambda) {
 	}
 
 	double lwbias = model->bias;
-	double lwtheta[n];
+	double* lwtheta = memalloc(MEM_SCRATCH, sizeof(double) * n);
 	copyd(lwtheta, model->theta, n);
 
 	double crtj = j(X, model, y, lambda);
 
 	double alpha = 0.1;
+
+	TelemRecord rec;
+	memset(&rec, 0, sizeof(TelemRecord));
+	rec.kind = TELEM_EPOCH;
+	rec.lambda = lambda;
+	if (telem.on) {
+		rec.loss = crtj;
+		rec.alpha = alpha;
+		rec.accepted = 1;
+		rec.grad = gradnorm(X, model, y, lambda);
+		telemrecord(&rec);
+	}
+
 	unsigned int steps = y->m * 1000;
 	for (int i = 0; i < 10; i++) {
 		stogdcent(X, model, y, alpha, lambda, batch, steps);
 		double newj = j(X, model, y, lambda);
+
+		//the gradient is taken at the epoch's result, before any rollback.
+		if (telem.on) {
+			rec.epoch = i + 1;
+			rec.loss = newj;
+			rec.alpha = alpha;
+			rec.accepted = newj < crtj;
+			rec.grad = gradnorm(X, model, y, lambda);
+			telemrecord(&rec);
+		}
+
 		if (newj < crtj) {
 			crtj = newj;
 			lwbias = model->bias;
@@ -111,10 +245,12 @@ void autostogdcent(Matrix* X, LinearModel* model, Matrix* y, double lambda) {
 
 	model->bias = lwbias;
 	copyd(model->theta, lwtheta, n);
+	memfree(MEM_SCRATCH, lwtheta);
 }
 
 void stogdcent(Matrix* X, LinearModel* model, Matrix* y, double alpha,
 		double lambda, unsigned int batch, unsigned int steps) {
+	profbegin("stogdcent");
 	size_t n = X->n;
 	size_t m = X->m;
 
@@ -123,10 +259,49 @@ void stogdcent(Matrix* X, LinearModel* model, Matrix* y, double alpha,
 	float* vals = X->values;
 	size_t tl = n + 1;
 
-	double* batchAvg = malloc(sizeof(double) * tl);
+	//the batches walk a new random order of the rows on every call, and
+	//continue where the previous batch stopped. Weighted rows are drawn by
+	//weight instead, at least SGD_DRAWS times.
+	size_t draws = X->weights && m < SGD_DRAWS ? SGD_DRAWS : m;
+	size_t* order = memalloc(MEM_SCRATCH, sizeof(size_t) * draws);
+	if (X->weights) {
+		stogdorder(rngthread(), X->weights, m, order, draws);
+	} else {
+		rngperm(rngthread(), order, m);
+	}
+
+	StogdKernel kernel = mtrdirect(X) ? stogdkernel(n) : NULL;
+	if (kernel) {
+		kernel(vals, ans, order, draws, &model->bias, theta, alpha, lambda,
+				batch, steps);
+		memfree(MEM_SCRATCH, order);
+		profcount(PROF_SGD_STEPS, steps);
+		profcount(PROF_SGD_ROWS, (uint64_t) steps * batch);
+		profend();
+		return;
+	}
+
+	//with a decay of 1 or more in a single step the lazy scale would reach
+	//0, so those steps are always dense.
+	if (mtrdirect(X) && alpha * lambda < 1
+			&& stogdsparse(X, ans, order, draws, &model->bias, theta, alpha,
+					lambda, batch, steps)) {
+		memfree(MEM_SCRATCH, order);
+		profcount(PROF_SGD_STEPS, steps);
+		profcount(PROF_SGD_ROWS, (uint64_t) steps * batch);
+		profend();
+		return;
+	}
+
+	double* batchAvg = memalloc(MEM_SCRATCH, sizeof(double) * tl);
+	float* row = NULL;
+	if (!mtrdirect(X)) {
+		row = memalloc(MEM_SCRATCH, sizeof(float) * n);
+	}
 	double bias = model->bias;
 
 	size_t mainCounter = 0;
+	size_t i = 0;
 
 	while (mainCounter < steps) {
 		mainCounter++;
@@ -136,12 +311,17 @@ void stogdcent(Matrix* X, LinearModel* model, Matrix* y, double alpha,
 		}
 
 		size_t counter = 0;
-		size_t i = 0;
 		while (counter < batch) {
 			counter++;
 
-			float* x = vals + i * n;
-			float yi = ans[i];
+			size_t r = order[i];
+			size_t p = i + KERNEL_PREFETCH;
+			if (row == NULL) {
+				__builtin_prefetch(vals + order[p < draws ? p : p % draws] * n);
+			}
+
+			float* x = row ? mtrload(X, r, row) : vals + r * n;
+			float yi = ans[r];
 
 			double hi = h(x, n, bias, theta) - yi;
 			batchAvg[0] += hi;
@@ -151,7 +331,7 @@ void stogdcent(Matrix* X, LinearModel* model, Matrix* y, double alpha,
 			}
 
 			i++;
-			if (i >= m) {
+			if (i >= draws) {
 				i = 0;
 			}
 		}
@@ -172,7 +352,180 @@ void stogdcent(Matrix* X, LinearModel* model, Matrix* y, double alpha,
 		model->bias = bias;
 	}
 
-	free(batchAvg);
+	memfree(MEM_SCRATCH, batchAvg);
+	memfree(MEM_SCRATCH, row);
+	memfree(MEM_SCRATCH, order);
+	profcount(PROF_SGD_STEPS, steps);
+	profcount(PROF_SGD_ROWS, (uint64_t) steps * batch);
+	profend();
+}
+
+/*
+ * Runs the steps of stogdcent on the non zero values of X, which are
+ * gathered by row first. Each theta[j] is kept as scale * w[j], so the L2
+ * decay of a step is a single product on scale, and a step only updates
+ * the features that are not 0 in some row of its batch. Up to rounding,
+ * the result is the one of the dense steps. Returns 0, without running any
+ * step, when more than SGD_SPARSE of the values of X are not 0.
+ */
+static short stogdsparse(Matrix* X, float* ans, size_t* order, size_t draws,
+		double* bias, double* theta, double alpha, double lambda,
+		unsigned int batch, unsigned int steps) {
+	size_t m = X->m;
+	size_t n = X->n;
+	float* vals = X->values;
+
+	size_t nnz = 0;
+	for (size_t k = 0; k < m * n; k++) {
+		nnz += vals[k] != 0;
+	}
+
+	if (nnz > m * n * SGD_SPARSE) {
+		return 0;
+	}
+
+	//the non zero values of the row r are nz[start[r], start[r + 1]), and
+	//their features idx[start[r], start[r + 1]).
+	size_t* start = memalloc(MEM_SCRATCH, sizeof(size_t) * (m + 1));
+	size_t* idx = memalloc(MEM_SCRATCH, sizeof(size_t) * (nnz + 1));
+	float* nz = memalloc(MEM_SCRATCH, sizeof(float) * (nnz + 1));
+	size_t k = 0;
+	for (size_t r = 0; r < m; r++) {
+		start[r] = k;
+		float* x = vals + r * n;
+		for (size_t j = 0; j < n; j++) {
+			if (x[j] != 0) {
+				idx[k] = j;
+				nz[k] = x[j];
+				k++;
+			}
+		}
+	}
+	start[m] = k;
+
+	//the step + 1 in which a feature was last added to touched.
+	size_t* mark = memcalloc(MEM_SCRATCH, n, sizeof(size_t));
+	size_t* touched = memalloc(MEM_SCRATCH, sizeof(size_t) * n);
+	double* g = memalloc(MEM_SCRATCH, sizeof(double) * n);
+
+	//theta is used as w, since the scale starts at 1.
+	double* w = theta;
+	double scale = 1;
+	double decay = 1 - alpha * lambda;
+	double b = *bias;
+	uint64_t visited = 0;
+
+	size_t i = 0;
+	for (unsigned int s = 0; s < steps; s++) {
+		double g0 = 0.0;
+		size_t t = 0;
+
+		for (unsigned int c = 0; c < batch; c++) {
+			size_t r = order[i];
+			size_t from = start[r];
+			size_t to = start[r + 1];
+
+			double dot = 0.0;
+			for (size_t q = from; q < to; q++) {
+				dot += nz[q] * w[idx[q]];
+			}
+
+			double hi = b + scale * dot - ans[r];
+			g0 += hi;
+
+			for (size_t q = from; q < to; q++) {
+				size_t j = idx[q];
+				if (mark[j] != s + 1) {
+					mark[j] = s + 1;
+					touched[t++] = j;
+					g[j] = 0.0;
+				}
+				g[j] += hi * nz[q];
+			}
+			visited += to - from;
+
+			i++;
+			if (i >= draws) {
+				i = 0;
+			}
+		}
+
+		b = b - alpha * g0 / batch;
+
+		//theta * decay - alpha * g, with theta = scale * w.
+		scale *= decay;
+		double rate = alpha / (batch * scale);
+		for (size_t q = 0; q < t; q++) {
+			w[touched[q]] -= rate * g[touched[q]];
+		}
+
+		if (scale < SGD_RESCALE) {
+			for (size_t j = 0; j < n; j++) {
+				w[j] *= scale;
+			}
+			scale = 1;
+		}
+	}
+
+	for (size_t j = 0; j < n; j++) {
+		theta[j] = w[j] * scale;
+	}
+	*bias = b;
+
+	memfree(MEM_SCRATCH, start);
+	memfree(MEM_SCRATCH, idx);
+	memfree(MEM_SCRATCH, nz);
+	memfree(MEM_SCRATCH, mark);
+	memfree(MEM_SCRATCH, touched);
+	memfree(MEM_SCRATCH, g);
+	profcount(PROF_SGD_NONZEROS, visited);
+	return 1;
+}
+
+/*
+ * Fills order with draws of the m rows in proportion to their weights, by
+ * systematic resampling, and shuffles it. A row of weight w shows up
+ * draws * w / W times, W being the total weight, rounded up or down, so a
+ * batch is a sample of the rows the weighted ones stand for, as if they had
+ * not been collapsed, and its plain average estimates their gradient.
+ */
+static void stogdorder(Rng* rng, float* weights, size_t m, size_t* order,
+		size_t draws) {
+	double total = 0.0;
+	for (size_t r = 0; r < m; r++) {
+		total += weights[r];
+	}
+
+	if (!(total > 0)) {
+		for (size_t k = 0; k < draws; k++) {
+			order[k] = k % m;
+		}
+		rngshuffle(rng, order, draws);
+		return;
+	}
+
+	double step = total / draws;
+	double next = rngunit(rng) * step;
+	double cum = 0.0;
+	size_t k = 0;
+	size_t last = 0;
+	for (size_t r = 0; r < m && k < draws; r++) {
+		cum += weights[r];
+		if (weights[r] > 0) {
+			last = r;
+		}
+		while (k < draws && next < cum) {
+			order[k++] = r;
+			next += step;
+		}
+	}
+
+	//what rounding left out of the last draws.
+	while (k < draws) {
+		order[k++] = last;
+	}
+
+	rngshuffle(rng, order, draws);
 }
 
 double h(float* x, size_t n, double bias, double* theta) {
@@ -188,6 +541,7 @@ double h(float* x, size_t n, double bias, double* theta) {
 
 double j(Matrix* X, LinearModel* model, Matrix* y, double lambda) {
 
+	profbegin("cost");
 	size_t m = X->m;
 	size_t n = X->n;
 
@@ -198,14 +552,26 @@ double j(Matrix* X, LinearModel* model, Matrix* y, double lambda) {
 
 	float* ans = y->values;
 
+	float* row = NULL;
+	if (!mtrdirect(X)) {
+		row = memalloc(MEM_SCRATCH, sizeof(float) * n);
+	}
+
 	double sum = 0.0;
+	float* weights = X->weights;
+	double total = weights ? 0.0 : m;
 
 	for (size_t i = 0; i < m; i++) {
-		float* x = vals + i * n;
+		float* x = row ? mtrload(X, i, row) : vals + i * n;
 		float yi = ans[i];
 		double hx = h(x, n, bias, theta);
 
-		sum += pow(hx - yi, 2);
+		if (weights) {
+			sum += weights[i] * pow(hx - yi, 2);
+			total += weights[i];
+		} else {
+			sum += pow(hx - yi, 2);
+		}
 	}
 
 	if (lambda != 0.0) {
@@ -217,11 +583,52 @@ double j(Matrix* X, LinearModel* model, Matrix* y, double lambda) {
 		sum += lambda * regsum;
 	}
 
-	sum = 1.0 / (2 * m) * sum;
+	sum = 1.0 / (2 * total) * sum;
+	memfree(MEM_SCRATCH, row);
 
+	profcount(PROF_COST_EVALS, 1);
+	profcount(PROF_COST_ROWS, m);
+	profend();
 	return sum;
 }
 
+/*
+ * Euclidean norm of the gradient of j over every row. Only used for
+ * telemetry, since it costs as much as a call to j.
+ */
+static double gradnorm(Matrix* X, LinearModel* model, Matrix* y,
+		double lambda) {
+	size_t m = X->m;
+	size_t n = X->n;
+
+	float* ans = y->values;
+	double* theta = model->theta;
+
+	float* row = memalloc(MEM_SCRATCH, sizeof(float) * n);
+	double* grad = memcalloc(MEM_SCRATCH, n + 1, sizeof(double));
+	double total = 0.0;
+	for (size_t i = 0; i < m; i++) {
+		float* x = mtrload(X, i, row);
+		double w = X->weights ? X->weights[i] : 1.0;
+		double hi = (h(x, n, model->bias, theta) - ans[i]) * w;
+		total += w;
+		grad[0] += hi;
+		for (size_t k = 0; k < n; k++) {
+			grad[k + 1] += hi * x[k];
+		}
+	}
+
+	double sum = pow(grad[0] / total, 2);
+	for (size_t k = 0; k < n; k++) {
+		double g = (grad[k + 1] + lambda * theta[k]) / total;
+		sum += g * g;
+	}
+	memfree(MEM_SCRATCH, grad);
+	memfree(MEM_SCRATCH, row);
+
+	return sqrt(sum);
+}
+
 Matrix* mtrrange(Matrix* mtr, size_t fromIdx, size_t toIdx) {
 	if (toIdx <= fromIdx || fromIdx < 0) {
 		fflush(stdout);
@@ -232,7 +639,7 @@ Matrix* mtrrange(Matrix* mtr, size_t fromIdx, size_t toIdx) {
 	}
 
 	size_t m = toIdx - fromIdx;
-	size_t n = mtr->n;
+	size_t n = mtrbase(mtr);
 
 	float* src = mtr->values;
 
@@ -240,11 +647,17 @@ Matrix* mtrrange(Matrix* mtr, size_t fromIdx, size_t toIdx) {
 	float* values = matrix->values;
 
 	for (size_t i = 0; i < m; i++) {
+		float* row = src + mtridx(mtr, fromIdx + i) * n;
 		for (size_t j = 0; j < n; j++) {
-			values[i * n + j] = src[(fromIdx + i) * n + j];
+			values[i * n + j] = row[j];
 		}
 	}
 
+	//the copy keeps the base features, and is expanded the same way.
+	matrix->n = mtr->n;
+	matrix->expand = expcopy(mtr->expand);
+	mtrweighcopy(matrix, mtr, fromIdx);
+
 	return matrix;
 }
 
@@ -267,19 +680,21 @@ Matrix* mtrslct(Matrix* mtr, size_t startInc, size_t endExc) {
 	float* values = matrix->values;
 
 	for (size_t i = 0; i < m; i++) {
+		float* row = src + mtridx(mtr, i) * srcn + startInc;
 		for (size_t j = 0; j < n; j++) {
-			values[i * n + j] = src[i * srcn + startInc + j];
+			values[i * n + j] = row[j];
 		}
 	}
+	mtrweighcopy(matrix, mtr, 0);
 
 	return matrix;
 }
 
 LinearModel* modlinear(size_t length) {
-	LinearModel* m = malloc(sizeof(LinearModel));
+	LinearModel* m = memalloc(MEM_MODEL, sizeof(LinearModel));
 	m->bias = 1.0;
 	m->length = length;
-	m->theta = calloc(length, sizeof(double));
+	m->theta = memcalloc(MEM_MODEL, length, sizeof(double));
 
 	return m;
 }
@@ -289,17 +704,17 @@ void modrand(LinearModel* model) {
 	model->bias = 1.0;
 	for (size_t i = 0; i < l; i++) {
 		//range [-1, 1]. 
-		model->theta[i] = -1 + 2 * ((double) rand() / (double) (RAND_MAX));
+		model->theta[i] = -1 + 2 * rngunit(rngthread());
 	}
 }
 
 void modfree(LinearModel* mod) {
 	if (mod) {
 		if (mod->theta) {
-			free(mod->theta);
+			memfree(MEM_MODEL, mod->theta);
 		}
 
-		free(mod);
+		memfree(MEM_MODEL, mod);
 	}
 }
 
@@ -313,35 +728,171 @@ Matrix* mtrxcl(Matrix* mtr, size_t col) {
 	float* dest = matrix->values;
 
 	for (size_t i = 0; i < m; i++) {
+		float* row = src + mtridx(mtr, i) * (n + 1);
 		for (size_t j = 0; j < n; j++) {
 			if (j < col) {
-				dest[i * n + j] = src[i * (n + 1) + j];
+				dest[i * n + j] = row[j];
 			} else {
-				dest[i * n + j] = src[i * (n + 1) + j + 1];
+				dest[i * n + j] = row[j + 1];
 			}
 		}
 	}
+	mtrweighcopy(matrix, mtr, 0);
 
 	return matrix;
 }
 
 Matrix* mtrnew(size_t m, size_t n) {
 
-	Matrix* matrix = malloc(sizeof(Matrix));
+	Matrix* matrix = memalloc(MEM_MATRIX, sizeof(Matrix));
 	matrix->m = m;
 	matrix->n = n;
-	matrix->values = calloc(m * n, sizeof(float));
+	matrix->values = memcalloc(MEM_MATRIX, m * n, sizeof(float));
+	matrix->type = MTR_F32;
+	matrix->packed = NULL;
+	matrix->scale = NULL;
+	matrix->offset = NULL;
+	matrix->perm = NULL;
+	matrix->expand = NULL;
+	matrix->weights = NULL;
 
 	return matrix;
 }
 
+/*
+ * Returns the storage row of the i-th row of the matrix.
+ */
+size_t mtridx(Matrix* mtr, size_t i) {
+	return mtr->perm ? mtr->perm[i] : i;
+}
+
+/*
+ * Returns the number of values stored per row, which is less than n when
+ * the matrix is expanded.
+ */
+size_t mtrbase(Matrix* mtr) {
+	return mtr->expand ? mtr->expand->n : mtr->n;
+}
+
+/*
+ * Returns 1 if the rows of the matrix can be read straight from its values,
+ * without calling mtrload.
+ */
+short mtrdirect(Matrix* mtr) {
+	return mtr->type == MTR_F32 && mtr->expand == NULL;
+}
+
+/*
+ * Collapses the identical rows of a float matrix in to a single row each,
+ * weighted by the number of rows it stands for. Rows are hashed in to an
+ * open addressing table and compared bit by bit on a hash match, and the
+ * unique rows keep the order they first show up in. Returns NULL when
+ * every row is unique.
+ */
+Matrix* mtrdedup(Matrix* mtr) {
+	profbegin("dedup");
+	size_t m = mtr->m;
+	size_t n = mtr->n;
+	size_t bytes = sizeof(float) * n;
+
+	size_t cap = 16;
+	while (cap < 2 * m) {
+		cap *= 2;
+	}
+
+	//slot k holds the index + 1 of a unique row, or 0 when it is empty.
+	size_t* table = memcalloc(MEM_SCRATCH, cap, sizeof(size_t));
+	size_t* unique = memalloc(MEM_SCRATCH, sizeof(size_t) * m);
+	float* weights = memalloc(MEM_SCRATCH, sizeof(float) * m);
+	size_t u = 0;
+
+	for (size_t i = 0; i < m; i++) {
+		size_t r = mtridx(mtr, i);
+		float* row = mtr->values + r * n;
+		uint64_t hash = UINT64_C(14695981039346656037);
+		for (size_t j = 0; j < n; j++) {
+			uint32_t bits;
+			memcpy(&bits, row + j, sizeof(uint32_t));
+			hash = (hash ^ bits) * UINT64_C(1099511628211);
+		}
+
+		size_t k = (hash ^ (hash >> 32)) & (cap - 1);
+		while (table[k] && memcmp(mtr->values + unique[table[k] - 1] * n, row,
+				bytes)) {
+			k = (k + 1) & (cap - 1);
+		}
+
+		if (table[k]) {
+			weights[table[k] - 1] += mtr->weights ? mtr->weights[r] : 1;
+		} else {
+			table[k] = u + 1;
+			unique[u] = r;
+			weights[u] = mtr->weights ? mtr->weights[r] : 1;
+			u++;
+		}
+	}
+	memfree(MEM_SCRATCH, table);
+
+	Matrix* dedup = NULL;
+	if (u < m) {
+		dedup = mtrnew(u, n);
+		dedup->weights = memalloc(MEM_MATRIX, sizeof(float) * u);
+		for (size_t i = 0; i < u; i++) {
+			memcpy(dedup->values + i * n, mtr->values + unique[i] * n, bytes);
+			dedup->weights[i] = weights[i];
+		}
+	}
+
+	memfree(MEM_SCRATCH, unique);
+	memfree(MEM_SCRATCH, weights);
+	profend();
+	return dedup;
+}
+
+/*
+ * Copies the weights of the rows [fromIdx, fromIdx + dest->m) of src, in
+ * the order given by its perm, to dest.
+ */
+void mtrweighcopy(Matrix* dest, Matrix* src, size_t fromIdx) {
+	if (src->weights == NULL) {
+		return;
+	}
+
+	dest->weights = memalloc(MEM_MATRIX, sizeof(float) * dest->m);
+	for (size_t i = 0; i < dest->m; i++) {
+		dest->weights[i] = src->weights[mtridx(src, fromIdx + i)];
+	}
+}
+
+/*
+ * Returns the number of rows that the rows [fromIdx, toIdx) stand for.
+ */
+double mtrweight(Matrix* mtr, size_t fromIdx, size_t toIdx) {
+	if (mtr->weights == NULL) {
+		return toIdx - fromIdx;
+	}
+
+	double sum = 0;
+	for (size_t i = fromIdx; i < toIdx; i++) {
+		sum += mtr->weights[mtridx(mtr, i)];
+	}
+	return sum;
+}
+
 void mtrfree(Matrix* matrix) {
 	if (matrix) {
 		if (matrix->values) {
-			free(matrix->values);
+			memfree(MEM_MATRIX, matrix->values);
 		}
 
-		free(matrix);
+		memfree(MEM_MATRIX, matrix->packed);
+		memfree(MEM_MATRIX, matrix->scale);
+		memfree(MEM_MATRIX, matrix->offset);
+		memfree(MEM_MATRIX, matrix->perm);
+		memfree(MEM_MATRIX, matrix->weights);
+		expfree(matrix->expand);
+
+		memfree(MEM_MATRIX, matrix);
 	}
 }
 
@@ -8,12 +8,49 @@
 #ifndef ML_H_
 #define ML_H_
 
+#include "expand.h"
 
+//storage of the values of a Matrix.
+#define MTR_F32 0
+#define MTR_BF16 1
+#define MTR_FP16 2
+#define MTR_INT8 3
 
+//optimizers train can fit each lambda with.
+#define ENGINE_SGD 0
+#define ENGINE_LBFGS 1
+#define ENGINE_CD 2
+
+/*
+ * Row major matrix. Matrices are created with float values, and mtrpack can
+ * convert them to a compact type, in which case values is NULL and the rows
+ * are read with mtrload. For MTR_INT8, value = offset[j] + scale[j] * q.
+ *
+ * perm is the row order set by mtrshuffle, the i-th row is stored at
+ * perm[i]. It is NULL when the rows are in storage order, and only the
+ * functions that copy rows (mtrrange, mtrslct, mtrxcl and mtrpack) follow it.
+ *
+ * When expand is set, the rows are stored with the expand->n base features
+ * and n is the expanded width: mtrload computes the products of each row as
+ * it is read, so the values never hold more than the base features.
+ *
+ * weights is NULL when every row counts once. Otherwise the stored row r
+ * stands for weights[r] identical rows, see mtrdedup: the cost and the
+ * full gradients weigh each row by it, and stogdcent draws the rows of its
+ * batches in proportion to it. It is stored in the same order as the rows,
+ * and the functions that copy rows keep it.
+ */
 typedef struct Matrix{
 	size_t m;
 	size_t n;
 	float* values;
+	short type;
+	void* packed;
+	float* scale;
+	float* offset;
+	size_t* perm;
+	Expand* expand;
+	float* weights;
 }Matrix;
 
 typedef struct LinearModel{
@@ -22,8 +59,14 @@ typedef struct LinearModel{
 	double* theta;
 }LinearModel;
 
-void train(Matrix* X, LinearModel* model, Matrix* y);
+extern short mtrstorage;
+extern short mtrdedupe;
+extern short trainengine;
+
+double train(Matrix* X, LinearModel* model, Matrix* y);
 double abserr(Matrix* X, LinearModel* model, Matrix* Y);
+void enginefit(Matrix* X, LinearModel* model, Matrix* y, double lambda);
+char* enginename(short engine);
 void autostogdcent(Matrix* X, LinearModel* model, Matrix* y, double lambda);
 void stogdcent(Matrix* X, LinearModel* model, Matrix* y, double alpha, double lambda,
 		unsigned int batch, unsigned int steps);
@@ -36,6 +79,12 @@ Matrix* mtrrange(Matrix* mtr, size_t fromIdx, size_t toIdx);
 Matrix* mtrslct(Matrix* mtr, size_t startInc, size_t endExc);
 Matrix* mtrxcl(Matrix* mtr, size_t col);
 Matrix* mtrnew(size_t m, size_t n);
+size_t mtridx(Matrix* mtr, size_t i);
+size_t mtrbase(Matrix* mtr);
+short mtrdirect(Matrix* mtr);
+Matrix* mtrdedup(Matrix* mtr);
+void mtrweighcopy(Matrix* dest, Matrix* src, size_t fromIdx);
+double mtrweight(Matrix* mtr, size_t fromIdx, size_t toIdx);
 void mtrprint(Matrix* matrix);
 void mtrfree(Matrix* matrix);
 void copyd(double* to, double* from, size_t n);
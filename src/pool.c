@@ -0,0 +1,143 @@
+/*
+ * pool.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+static void* poolrun(void* arg);
+
+/*
+ * Creates a pool with the given number of threads. When threads is 0, one
+ * thread per online cpu is created.
+ */
+Pool* poolnew(size_t threads) {
+	if (threads == 0) {
+		threads = cpucount();
+	}
+
+	Pool* pool = malloc(sizeof(Pool));
+	pool->size = threads;
+	pool->head = NULL;
+	pool->tail = NULL;
+	pool->pending = 0;
+	pool->stop = 0;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->ready, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	pool->threads = malloc(sizeof(pthread_t) * threads);
+	for (size_t i = 0; i < threads; i++) {
+		pthread_create(&pool->threads[i], NULL, poolrun, pool);
+	}
+
+	return pool;
+}
+
+/*
+ * Queues a task. The function fn will be called with arg by one of the
+ * threads of the pool.
+ */
+void poolsubmit(Pool* pool, void (*fn)(void*), void* arg) {
+	PoolTask* task = malloc(sizeof(PoolTask));
+	task->fn = fn;
+	task->arg = arg;
+	task->next = NULL;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->tail) {
+		pool->tail->next = task;
+	} else {
+		pool->head = task;
+	}
+	pool->tail = task;
+	pool->pending++;
+	pthread_cond_signal(&pool->ready);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * Blocks until every submitted task has finished.
+ */
+void poolwait(Pool* pool) {
+	pthread_mutex_lock(&pool->lock);
+	while (pool->pending > 0) {
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * Waits for the pending tasks, then stops and releases the threads.
+ */
+void poolfree(Pool* pool) {
+	if (pool) {
+		poolwait(pool);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->stop = 1;
+		pthread_cond_broadcast(&pool->ready);
+		pthread_mutex_unlock(&pool->lock);
+
+		for (size_t i = 0; i < pool->size; i++) {
+			pthread_join(pool->threads[i], NULL);
+		}
+
+		free(pool->threads);
+		pthread_mutex_destroy(&pool->lock);
+		pthread_cond_destroy(&pool->ready);
+		pthread_cond_destroy(&pool->done);
+		free(pool);
+	}
+}
+
+size_t cpucount() {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < 1) {
+		return 1;
+	}
+
+	return (size_t) n;
+}
+
+static void* poolrun(void* arg) {
+	Pool* pool = arg;
+
+	while (1) {
+		pthread_mutex_lock(&pool->lock);
+		while (pool->head == NULL && !pool->stop) {
+			pthread_cond_wait(&pool->ready, &pool->lock);
+		}
+
+		if (pool->head == NULL) {
+			//stop was requested and there is nothing left to do.
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+
+		PoolTask* task = pool->head;
+		pool->head = task->next;
+		if (pool->head == NULL) {
+			pool->tail = NULL;
+		}
+		pthread_mutex_unlock(&pool->lock);
+
+		task->fn(task->arg);
+		free(task);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->pending--;
+		if (pool->pending == 0) {
+			pthread_cond_broadcast(&pool->done);
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	return NULL;
+}
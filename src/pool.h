@@ -0,0 +1,43 @@
+/*
+ * pool.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <pthread.h>
+
+typedef struct PoolTask{
+	void (*fn)(void*);
+	void* arg;
+	struct PoolTask* next;
+}PoolTask;
+
+/*
+ * A fixed size group of worker threads that run the submitted tasks in
+ * submission order.
+ */
+typedef struct Pool{
+	pthread_t* threads;
+	size_t size;
+
+	PoolTask* head;
+	PoolTask* tail;
+	size_t pending;
+	short stop;
+
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	pthread_cond_t done;
+}Pool;
+
+Pool* poolnew(size_t threads);
+void poolsubmit(Pool* pool, void (*fn)(void*), void* arg);
+void poolwait(Pool* pool);
+void poolfree(Pool* pool);
+size_t cpucount();
+
+#endif /* POOL_H_ */
@@ -0,0 +1,302 @@
+/*
+ * prof.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "utils.h"
+#include "prof.h"
+
+#define PROF_DROPPED ((size_t) -1)
+
+Profiler prof;
+
+static pthread_mutex_t proflock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int proftid = -1;
+static __thread size_t profstack[PROF_DEPTH];
+static __thread int profdepth = 0;
+
+static char* profnames[PROF_COUNTERS] = { "bytes_read", "bytes_parsed", "rows",
+		"sgd_steps", "sgd_rows", "cost_evals", "cost_rows",
+		"reencoded_columns", "sgd_nonzeros", "grad_passes", "cd_updates" };
+
+static void profpush(const char* name, double arg, short hasarg);
+static double proftotal(const char* name, size_t* calls, double* min,
+		double* max);
+
+/*
+ * Enables the profiler. Events and counters recorded before this call are
+ * lost.
+ */
+void profinit() {
+	memset(prof.counters, 0, sizeof(prof.counters));
+	prof.events = 0;
+	prof.threads = 0;
+	prof.origin = wtime();
+	prof.on = 1;
+}
+
+/*
+ * Starts a phase of the current thread. Phases can be nested, and each one
+ * must be closed by profend. The name must be a string literal, since
+ * only the pointer is kept.
+ */
+void profbegin(const char* name) {
+	profpush(name, 0, 0);
+}
+
+/*
+ * Same as profbegin, but the phase also records a number, like the lambda
+ * of a training round.
+ */
+void profbeginarg(const char* name, double arg) {
+	profpush(name, arg, 1);
+}
+
+/*
+ * Closes the last phase started by the current thread.
+ */
+void profend() {
+	if (!prof.on || profdepth == 0) {
+		return;
+	}
+
+	profdepth--;
+	if (profdepth >= PROF_DEPTH) {
+		return;
+	}
+
+	size_t idx = profstack[profdepth];
+	if (idx == PROF_DROPPED) {
+		return;
+	}
+
+	ProfEvent* ev = prof.blocks[idx / PROF_BLOCK] + idx % PROF_BLOCK;
+	ev->end = wtime() - prof.origin;
+}
+
+void profcount(int counter, uint64_t amount) {
+	if (prof.on) {
+		__sync_fetch_and_add(&prof.counters[counter], amount);
+	}
+}
+
+/*
+ * Writes the total, count, min and max time of each phase name, together
+ * with the counters and the throughput derived from them.
+ */
+int profjson(char* path) {
+	FILE* f = fopen(path, "w");
+	if (f == NULL) {
+		fprintf(stderr, "Could not open %s for writing.\n", path);
+		fflush(stderr);
+		return -1;
+	}
+
+	size_t events = prof.events;
+	if (events > PROF_BLOCK * PROF_BLOCKS) {
+		events = PROF_BLOCK * PROF_BLOCKS;
+	}
+
+	fputs("{\"wall_s\":", f);
+	fjsonnum(f, wtime() - prof.origin);
+	fputs(",\"phases\":[", f);
+
+	//each distinct name is reported once, in order of first appearance.
+	const char* names[64];
+	size_t distinct = 0;
+	for (size_t i = 0; i < events && distinct < 64; i++) {
+		ProfEvent* ev = prof.blocks[i / PROF_BLOCK] + i % PROF_BLOCK;
+		if (ev->name == NULL) {
+			continue;
+		}
+
+		short seen = 0;
+		for (size_t k = 0; k < distinct && !seen; k++) {
+			seen = strcmp(names[k], ev->name) == 0;
+		}
+		if (!seen) {
+			names[distinct++] = ev->name;
+		}
+	}
+
+	for (size_t k = 0; k < distinct; k++) {
+		size_t calls;
+		double min;
+		double max;
+		double total = proftotal(names[k], &calls, &min, &max);
+		fputs(k == 0 ? "\n{\"name\":" : ",\n{\"name\":", f);
+		fjsonstr(f, (char*) names[k]);
+		fprintf(f, ",\"calls\":%zu,\"total_s\":", calls);
+		fjsonnum(f, total);
+		fputs(",\"min_s\":", f);
+		fjsonnum(f, min);
+		fputs(",\"max_s\":", f);
+		fjsonnum(f, max);
+		fputc('}', f);
+	}
+
+	fputs("],\n\"counters\":{", f);
+	for (int c = 0; c < PROF_COUNTERS; c++) {
+		fprintf(f, "%s\"%s\":%llu", c ? "," : "", profnames[c],
+				(unsigned long long) prof.counters[c]);
+	}
+
+	size_t calls;
+	double min;
+	double max;
+	double read = proftotal("read", &calls, &min, &max);
+	double tokenize = proftotal("tokenize", &calls, &min, &max);
+	double sgd = proftotal("stogdcent", &calls, &min, &max);
+	double cost = proftotal("cost", &calls, &min, &max);
+
+	fputs("},\n\"rates\":{\"read_mb_s\":", f);
+	fjsonnum(f, prof.counters[PROF_BYTES_READ] / read / 1e6);
+	fputs(",\"parse_mb_s\":", f);
+	fjsonnum(f, prof.counters[PROF_BYTES_PARSED] / tokenize / 1e6);
+	fputs(",\"parse_rows_s\":", f);
+	fjsonnum(f, prof.counters[PROF_ROWS] / tokenize);
+	fputs(",\"sgd_steps_s\":", f);
+	fjsonnum(f, prof.counters[PROF_SGD_STEPS] / sgd);
+	fputs(",\"sgd_rows_s\":", f);
+	fjsonnum(f, prof.counters[PROF_SGD_ROWS] / sgd);
+	fputs(",\"cost_rows_s\":", f);
+	fjsonnum(f, prof.counters[PROF_COST_ROWS] / cost);
+	fputs("}}\n", f);
+
+	return fclose(f) == 0 ? 0 : -1;
+}
+
+/*
+ * Writes the phases in the Chrome trace event format, which can be opened
+ * with chrome://tracing or Perfetto. The counters are added as counter
+ * events at the end of the trace.
+ */
+int proftrace(char* path) {
+	FILE* f = fopen(path, "w");
+	if (f == NULL) {
+		fprintf(stderr, "Could not open %s for writing.\n", path);
+		fflush(stderr);
+		return -1;
+	}
+
+	size_t events = prof.events;
+	if (events > PROF_BLOCK * PROF_BLOCKS) {
+		events = PROF_BLOCK * PROF_BLOCKS;
+	}
+
+	double last = 0;
+	fputs("{\"traceEvents\":[", f);
+	for (size_t i = 0; i < events; i++) {
+		ProfEvent* ev = prof.blocks[i / PROF_BLOCK] + i % PROF_BLOCK;
+		if (ev->end < ev->start) {
+			continue;
+		}
+
+		if (ev->end > last) {
+			last = ev->end;
+		}
+
+		fputs("\n{\"name\":", f);
+		fjsonstr(f, (char*) ev->name);
+		fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+				"\"dur\":%.3f", ev->tid, ev->start * 1e6,
+				(ev->end - ev->start) * 1e6);
+		if (ev->hasarg) {
+			fputs(",\"args\":{\"value\":", f);
+			fjsonnum(f, ev->arg);
+			fputc('}', f);
+		}
+		fputs("},", f);
+	}
+
+	for (int c = 0; c < PROF_COUNTERS; c++) {
+		fprintf(f, "\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,"
+				"\"args\":{\"value\":%llu}}%s", profnames[c], last * 1e6,
+				(unsigned long long) prof.counters[c],
+				c + 1 < PROF_COUNTERS ? "," : "");
+	}
+	fputs("\n]}\n", f);
+
+	return fclose(f) == 0 ? 0 : -1;
+}
+
+static void profpush(const char* name, double arg, short hasarg) {
+	if (!prof.on) {
+		return;
+	}
+
+	if (profdepth >= PROF_DEPTH) {
+		//too deep, the matching profend will be ignored as well.
+		profdepth++;
+		return;
+	}
+
+	if (proftid == -1) {
+		proftid = __sync_fetch_and_add(&prof.threads, 1);
+	}
+
+	size_t idx = __sync_fetch_and_add(&prof.events, 1);
+	size_t b = idx / PROF_BLOCK;
+	if (b >= PROF_BLOCKS) {
+		profstack[profdepth++] = PROF_DROPPED;
+		return;
+	}
+
+	if (__atomic_load_n(&prof.blocks[b], __ATOMIC_ACQUIRE) == NULL) {
+		pthread_mutex_lock(&proflock);
+		if (prof.blocks[b] == NULL) {
+			ProfEvent* block = calloc(PROF_BLOCK, sizeof(ProfEvent));
+			__atomic_store_n(&prof.blocks[b], block, __ATOMIC_RELEASE);
+		}
+		pthread_mutex_unlock(&proflock);
+	}
+
+	ProfEvent* ev = prof.blocks[b] + idx % PROF_BLOCK;
+	ev->name = name;
+	ev->arg = arg;
+	ev->hasarg = hasarg;
+	ev->tid = proftid;
+	ev->end = -1;
+	ev->start = wtime() - prof.origin;
+
+	profstack[profdepth++] = idx;
+}
+
+static double proftotal(const char* name, size_t* calls, double* min,
+		double* max) {
+	size_t events = prof.events;
+	if (events > PROF_BLOCK * PROF_BLOCKS) {
+		events = PROF_BLOCK * PROF_BLOCKS;
+	}
+
+	double total = 0;
+	*calls = 0;
+	*min = 0;
+	*max = 0;
+	for (size_t i = 0; i < events; i++) {
+		ProfEvent* ev = prof.blocks[i / PROF_BLOCK] + i % PROF_BLOCK;
+		if (ev->name == NULL || ev->end < ev->start
+				|| (ev->name != name && strcmp(ev->name, name) != 0)) {
+			continue;
+		}
+
+		double d = ev->end - ev->start;
+		if (*calls == 0 || d < *min) {
+			*min = d;
+		}
+		if (d > *max) {
+			*max = d;
+		}
+		total += d;
+		(*calls)++;
+	}
+
+	return total;
+}
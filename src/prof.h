@@ -0,0 +1,64 @@
+/*
+ * prof.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef PROF_H_
+#define PROF_H_
+
+#include <stdint.h>
+
+//events are stored in blocks, so a recorded event never moves.
+#define PROF_BLOCK 4096
+#define PROF_BLOCKS 1024
+#define PROF_DEPTH 32
+
+#define PROF_BYTES_READ 0
+#define PROF_BYTES_PARSED 1
+#define PROF_ROWS 2
+#define PROF_SGD_STEPS 3
+#define PROF_SGD_ROWS 4
+#define PROF_COST_EVALS 5
+#define PROF_COST_ROWS 6
+#define PROF_REENCODED 7
+#define PROF_SGD_NONZEROS 8
+#define PROF_GRAD_PASSES 9
+#define PROF_CD_UPDATES 10
+#define PROF_COUNTERS 11
+
+typedef struct ProfEvent{
+	const char* name;
+	double arg;
+	short hasarg;
+	int tid;
+	double start;
+	double end;
+}ProfEvent;
+
+/*
+ * Phase timers and counters. Everything is disabled until profinit is
+ * called, and then profbegin/profend and profcount cost a few atomic
+ * operations each.
+ */
+typedef struct Profiler{
+	short on;
+	double origin;
+	ProfEvent* blocks[PROF_BLOCKS];
+	size_t events;
+	int threads;
+	uint64_t counters[PROF_COUNTERS];
+}Profiler;
+
+extern Profiler prof;
+
+void profinit();
+void profbegin(const char* name);
+void profbeginarg(const char* name, double arg);
+void profend();
+void profcount(int counter, uint64_t amount);
+int profjson(char* path);
+int proftrace(char* path);
+
+#endif /* PROF_H_ */
@@ -0,0 +1,205 @@
+/*
+ * prune.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "prune.h"
+#include "mem.h"
+#include "prof.h"
+
+//rows a feature must not be 0 in to be trained on, 0 (the default) never
+//prunes, so the features are the ones of the data unless asked.
+size_t prunesupport = 0;
+
+//a feature and the hash of its values, to find the duplicated ones.
+typedef struct PruneCol{
+	uint64_t hash;
+	size_t j;
+}PruneCol;
+
+static short prunesame(Matrix* mtr, size_t a, size_t b);
+static int prunecolcmp(const void* a, const void* b);
+
+/*
+ * Finds the features of the first xn columns of mtr, which must hold
+ * floats, that are not worth training on. In a single pass over the rows it
+ * counts the rows where each feature is not 0, checks if it always has the
+ * bits of the first row, and hashes its values. Features with the same hash
+ * are then compared value by value, and only the first of the same ones is
+ * kept. Returns NULL when every feature is kept, when none would be, or
+ * when prunesupport is 0.
+ */
+Prune* prunenew(Matrix* mtr, size_t xn) {
+	if (prunesupport == 0 || xn == 0) {
+		return NULL;
+	}
+
+	profbegin("prune");
+	size_t m = mtr->m;
+	size_t n = mtr->n;
+	float* values = mtr->values;
+
+	size_t* support = memcalloc(MEM_SCRATCH, xn, sizeof(size_t));
+	short* varies = memcalloc(MEM_SCRATCH, xn, sizeof(short));
+	PruneCol* cols = memalloc(MEM_SCRATCH, sizeof(PruneCol) * xn);
+	for (size_t j = 0; j < xn; j++) {
+		cols[j].hash = UINT64_C(14695981039346656037);
+		cols[j].j = j;
+	}
+
+	for (size_t i = 0; i < m; i++) {
+		float* row = values + i * n;
+		for (size_t j = 0; j < xn; j++) {
+			uint32_t bits;
+			uint32_t first;
+			memcpy(&bits, row + j, sizeof(uint32_t));
+			memcpy(&first, values + j, sizeof(uint32_t));
+			support[j] += row[j] != 0;
+			varies[j] |= bits != first;
+			cols[j].hash = (cols[j].hash ^ bits) * UINT64_C(1099511628211);
+		}
+	}
+
+	Prune* p = memcalloc(MEM_MODEL, 1, sizeof(Prune));
+	p->n = xn;
+
+	//0 keeps the feature, anything else drops it.
+	short* drop = memcalloc(MEM_SCRATCH, xn, sizeof(short));
+	size_t candidates = 0;
+	for (size_t j = 0; j < xn; j++) {
+		if (!varies[j]) {
+			drop[j] = 1;
+			p->constant++;
+		} else if (support[j] < prunesupport) {
+			drop[j] = 1;
+			p->rare++;
+		} else {
+			cols[candidates++] = cols[j];
+		}
+	}
+
+	qsort(cols, candidates, sizeof(PruneCol), prunecolcmp);
+	for (size_t a = 0; a < candidates; a++) {
+		if (drop[cols[a].j]) {
+			continue;
+		}
+
+		for (size_t b = a + 1; b < candidates && cols[b].hash == cols[a].hash;
+				b++) {
+			if (!drop[cols[b].j] && prunesame(mtr, cols[a].j, cols[b].j)) {
+				drop[cols[b].j] = 1;
+				p->duplicate++;
+			}
+		}
+	}
+
+	p->kept = xn - p->constant - p->rare - p->duplicate;
+	if (p->kept < xn && p->kept > 0) {
+		p->keep = memalloc(MEM_MODEL, sizeof(size_t) * (p->kept + 1));
+		size_t k = 0;
+		for (size_t j = 0; j < xn; j++) {
+			if (!drop[j]) {
+				p->keep[k++] = j;
+			}
+		}
+	}
+
+	memfree(MEM_SCRATCH, support);
+	memfree(MEM_SCRATCH, varies);
+	memfree(MEM_SCRATCH, cols);
+	memfree(MEM_SCRATCH, drop);
+	profend();
+
+	if (p->kept == xn || p->kept == 0) {
+		prunefree(p);
+		return NULL;
+	}
+
+	return p;
+}
+
+Prune* prunecopy(Prune* p) {
+	if (p == NULL) {
+		return NULL;
+	}
+
+	Prune* copy = memalloc(MEM_MODEL, sizeof(Prune));
+	*copy = *p;
+	copy->keep = memalloc(MEM_MODEL, sizeof(size_t) * (p->kept + 1));
+	memcpy(copy->keep, p->keep, sizeof(size_t) * p->kept);
+
+	return copy;
+}
+
+void prunefree(Prune* p) {
+	if (p) {
+		memfree(MEM_MODEL, p->keep);
+		memfree(MEM_MODEL, p);
+	}
+}
+
+/*
+ * Creates a copy of mtr with only the kept features, followed by every
+ * column from p->n on, which are the y columns.
+ */
+Matrix* prunematrix(Prune* p, Matrix* mtr) {
+	size_t m = mtr->m;
+	size_t n = mtr->n;
+	size_t rest = n - p->n;
+	size_t pn = p->kept + rest;
+
+	Matrix* pruned = mtrnew(m, pn);
+	for (size_t i = 0; i < m; i++) {
+		float* src = mtr->values + mtridx(mtr, i) * n;
+		float* dest = pruned->values + i * pn;
+		for (size_t k = 0; k < p->kept; k++) {
+			dest[k] = src[p->keep[k]];
+		}
+		memcpy(dest + p->kept, src + p->n, sizeof(float) * rest);
+	}
+
+	return pruned;
+}
+
+/*
+ * Prunes an encoded row in place, leaving the kept features at the start.
+ */
+void pruneapply(Prune* p, float* x) {
+	size_t kept = p->kept;
+	size_t* restrict keep = p->keep;
+
+	for (size_t k = 0; k < kept; k++) {
+		x[k] = x[keep[k]];
+	}
+}
+
+/*
+ * Whether the features a and b have the same bits in every row.
+ */
+static short prunesame(Matrix* mtr, size_t a, size_t b) {
+	size_t m = mtr->m;
+	size_t n = mtr->n;
+	float* values = mtr->values;
+
+	for (size_t i = 0; i < m; i++) {
+		if (memcmp(values + i * n + a, values + i * n + b, sizeof(float))) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int prunecolcmp(const void* a, const void* b) {
+	const PruneCol* x = a;
+	const PruneCol* y = b;
+	if (x->hash != y->hash) {
+		return x->hash < y->hash ? -1 : 1;
+	}
+	return (x->j > y->j) - (x->j < y->j);
+}
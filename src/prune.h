@@ -0,0 +1,37 @@
+/*
+ * prune.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef PRUNE_H_
+#define PRUNE_H_
+
+#include <stddef.h>
+#include "ml.h"
+
+/*
+ * Encoded features left out of training. Of the n features a row is
+ * encoded with, only keep[0, kept) are used, in increasing order, so a row
+ * is pruned in place. The other ones were constant, not 0 in fewer than
+ * prunesupport rows, or the same as an earlier feature in every row.
+ */
+typedef struct Prune{
+	size_t n;
+	size_t kept;
+	size_t* keep;
+	size_t constant;
+	size_t rare;
+	size_t duplicate;
+}Prune;
+
+extern size_t prunesupport;
+
+Prune* prunenew(Matrix* mtr, size_t xn);
+Prune* prunecopy(Prune* p);
+void prunefree(Prune* p);
+Matrix* prunematrix(Prune* p, Matrix* mtr);
+void pruneapply(Prune* p, float* x);
+
+#endif /* PRUNE_H_ */
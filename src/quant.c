@@ -0,0 +1,422 @@
+/*
+ * quant.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "utils.h"
+#include "ui.h"
+#include "mem.h"
+#include "quant.h"
+
+//largest code of the symmetric int8 quantization.
+#define QUANT_LEVELS 127
+
+//every half value widened, so loading a fp16 row is a lookup per value.
+static float* fp16table = NULL;
+static pthread_once_t fp16once = PTHREAD_ONCE_INIT;
+
+static void fp16init();
+static float* mtrrowload(Matrix* mtr, size_t i, size_t n, float* dest);
+static void quantreport(Matrix* X, Data* data, Matrix** ys, double* jref,
+		short type);
+
+/*
+ * Converts a float to bfloat16, the upper half of its bits, rounding to the
+ * nearest even value.
+ */
+uint16_t tobf16(float val) {
+	uint32_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+
+	if ((bits & 0x7fffffff) > 0x7f800000) {
+		//NaN, keep it quiet so it does not become infinity.
+		return (bits >> 16) | 0x0040;
+	}
+
+	bits += 0x7fff + ((bits >> 16) & 1);
+	return bits >> 16;
+}
+
+float frombf16(uint16_t val) {
+	uint32_t bits = (uint32_t) val << 16;
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+/*
+ * Converts a float to IEEE half precision, rounding to the nearest even
+ * value. Values too large become infinity and values too small become
+ * subnormals or zero.
+ */
+uint16_t tofp16(float val) {
+	uint32_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+
+	uint16_t sign = (bits >> 16) & 0x8000;
+	int32_t exp = (bits >> 23) & 0xff;
+	uint32_t mant = bits & 0x7fffff;
+
+	if (exp == 0xff) {
+		return sign | 0x7c00 | (mant ? 0x0200 | (mant >> 13) : 0);
+	}
+
+	int32_t e = exp - 127 + 15;
+	if (e >= 31) {
+		return sign | 0x7c00;
+	}
+
+	if (e <= 0) {
+		if (e < -10) {
+			return sign;
+		}
+
+		//subnormal, the implicit bit becomes part of the mantissa.
+		mant |= 0x800000;
+		int shift = 14 - e;
+		uint32_t half = mant >> shift;
+		uint32_t rem = mant & ((1u << shift) - 1);
+		uint32_t mid = 1u << (shift - 1);
+		if (rem > mid || (rem == mid && (half & 1))) {
+			half++;
+		}
+		return sign | half;
+	}
+
+	uint32_t half = ((uint32_t) e << 10) | (mant >> 13);
+	uint32_t rem = mant & 0x1fff;
+	if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) {
+		//a carry in to the exponent is still the right result.
+		half++;
+	}
+	return sign | half;
+}
+
+float fromfp16(uint16_t val) {
+	uint32_t sign = (uint32_t) (val & 0x8000) << 16;
+	uint32_t exp = (val >> 10) & 0x1f;
+	uint32_t mant = val & 0x3ff;
+
+	uint32_t bits;
+	if (exp == 0) {
+		//zero or subnormal, mant * 2^-24.
+		float f = mant * 5.9604644775390625e-8f;
+		return sign ? -f : f;
+	} else if (exp == 0x1f) {
+		bits = sign | 0x7f800000 | (mant << 13);
+	} else {
+		bits = sign | ((exp + 112) << 23) | (mant << 13);
+	}
+
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+/*
+ * Returns the MTR_* storage with the given name (f32, bf16, fp16 or int8),
+ * or -1 if there is none.
+ */
+short mtrtype(char* name) {
+	for (short t = MTR_F32; t <= MTR_INT8; t++) {
+		if (strcmp(name, mtrtypename(t)) == 0) {
+			return t;
+		}
+	}
+
+	return -1;
+}
+
+char* mtrtypename(short type) {
+	switch (type) {
+	case MTR_BF16:
+		return "bf16";
+	case MTR_FP16:
+		return "fp16";
+	case MTR_INT8:
+		return "int8";
+	default:
+		return "f32";
+	}
+}
+
+/*
+ * Bytes used by each value of the given storage.
+ */
+size_t mtrvalsize(short type) {
+	switch (type) {
+	case MTR_BF16:
+	case MTR_FP16:
+		return sizeof(uint16_t);
+	case MTR_INT8:
+		return sizeof(int8_t);
+	default:
+		return sizeof(float);
+	}
+}
+
+/*
+ * Creates a copy of the rows [fromIdx, toIdx) of a float matrix, stored with
+ * the given type. int8 values are quantized per column, centered on the
+ * middle of the column range, so constant columns and 0/1 columns come back
+ * exactly.
+ */
+Matrix* mtrpack(Matrix* mtr, size_t fromIdx, size_t toIdx, short type) {
+	size_t m = toIdx - fromIdx;
+	size_t n = mtrbase(mtr);
+
+	if (mtr->values == NULL) {
+		fflush(stdout);
+		fprintf(stderr, "Can not pack a matrix that is already packed.\n");
+		fflush(stderr);
+		return NULL;
+	}
+
+	if (type == MTR_F32) {
+		return mtrrange(mtr, fromIdx, toIdx);
+	}
+
+	Matrix* matrix = memalloc(MEM_MATRIX, sizeof(Matrix));
+	matrix->m = m;
+	matrix->n = mtr->n;
+	matrix->values = NULL;
+	matrix->type = type;
+	matrix->scale = NULL;
+	matrix->offset = NULL;
+	matrix->perm = NULL;
+	matrix->expand = expcopy(mtr->expand);
+	matrix->weights = NULL;
+	mtrweighcopy(matrix, mtr, fromIdx);
+	matrix->packed = memalloc(MEM_MATRIX, m * n * mtrvalsize(type));
+
+	if (type == MTR_BF16) {
+		uint16_t* dest = matrix->packed;
+		for (size_t i = 0; i < m; i++) {
+			float* src = mtr->values + mtridx(mtr, fromIdx + i) * n;
+			for (size_t j = 0; j < n; j++) {
+				dest[i * n + j] = tobf16(src[j]);
+			}
+		}
+	} else if (type == MTR_FP16) {
+		pthread_once(&fp16once, fp16init);
+		uint16_t* dest = matrix->packed;
+		for (size_t i = 0; i < m; i++) {
+			float* src = mtr->values + mtridx(mtr, fromIdx + i) * n;
+			for (size_t j = 0; j < n; j++) {
+				dest[i * n + j] = tofp16(src[j]);
+			}
+		}
+	} else {
+		float* scale = memalloc(MEM_MATRIX, sizeof(float) * n);
+		float* offset = memalloc(MEM_MATRIX, sizeof(float) * n);
+		float* max = memalloc(MEM_SCRATCH, sizeof(float) * n);
+		float* min = memalloc(MEM_SCRATCH, sizeof(float) * n);
+		for (size_t i = 0; i < m; i++) {
+			float* src = mtr->values + mtridx(mtr, fromIdx + i) * n;
+			for (size_t j = 0; j < n; j++) {
+				max[j] = i ? higher(max[j], src[j]) : src[j];
+				min[j] = i ? lower(min[j], src[j]) : src[j];
+			}
+		}
+
+		for (size_t j = 0; j < n; j++) {
+			offset[j] = (max[j] + min[j]) / 2;
+			scale[j] = max[j] > min[j] ?
+					(max[j] - min[j]) / (2 * QUANT_LEVELS) : 1;
+		}
+		memfree(MEM_SCRATCH, max);
+		memfree(MEM_SCRATCH, min);
+
+		int8_t* dest = matrix->packed;
+		for (size_t i = 0; i < m; i++) {
+			float* src = mtr->values + mtridx(mtr, fromIdx + i) * n;
+			for (size_t j = 0; j < n; j++) {
+				float q = roundf((src[j] - offset[j]) / scale[j]);
+				if (q > QUANT_LEVELS) {
+					q = QUANT_LEVELS;
+				} else if (q < -QUANT_LEVELS) {
+					q = -QUANT_LEVELS;
+				}
+				dest[i * n + j] = (int8_t) q;
+			}
+		}
+
+		matrix->scale = scale;
+		matrix->offset = offset;
+	}
+
+	return matrix;
+}
+
+/*
+ * Returns the i-th row of the matrix as floats. Float matrices return a
+ * pointer to their own row, while packed ones are widened in to dest, which
+ * must have room for n values. Expanded matrices always fill dest.
+ */
+float* mtrload(Matrix* mtr, size_t i, float* dest) {
+	if (mtr->expand) {
+		size_t base = mtr->expand->n;
+		float* src = mtrrowload(mtr, i, base, dest);
+		if (src != dest) {
+			memcpy(dest, src, sizeof(float) * base);
+		}
+		expapply(mtr->expand, dest);
+		return dest;
+	}
+
+	return mtrrowload(mtr, i, mtr->n, dest);
+}
+
+/*
+ * Reads the n stored values of the i-th row, see mtrload.
+ */
+static float* mtrrowload(Matrix* mtr, size_t i, size_t n, float* dest) {
+
+	switch (mtr->type) {
+	case MTR_BF16: {
+		uint16_t* src = (uint16_t*) mtr->packed + i * n;
+		for (size_t j = 0; j < n; j++) {
+			dest[j] = frombf16(src[j]);
+		}
+		return dest;
+	}
+	case MTR_FP16: {
+		uint16_t* src = (uint16_t*) mtr->packed + i * n;
+		float* table = fp16table;
+		for (size_t j = 0; j < n; j++) {
+			dest[j] = table[src[j]];
+		}
+		return dest;
+	}
+	case MTR_INT8: {
+		int8_t* src = (int8_t*) mtr->packed + i * n;
+		float* restrict scale = mtr->scale;
+		float* restrict offset = mtr->offset;
+		float* restrict out = dest;
+		for (size_t j = 0; j < n; j++) {
+			out[j] = offset[j] + scale[j] * src[j];
+		}
+		return dest;
+	}
+	default:
+		return mtr->values + i * n;
+	}
+}
+
+static void fp16init() {
+	fp16table = malloc(sizeof(float) * 65536);
+	for (uint32_t h = 0; h < 65536; h++) {
+		fp16table[h] = fromfp16(h);
+	}
+}
+
+/*
+ * Trains the models of a data file with float values, and then reports how
+ * far each compact storage is from the float matrix: the error of the
+ * values themselves, the change of the cost and of the predictions of the
+ * trained models, and the time of a full cost pass.
+ *
+ *   linfit quant <data file>
+ */
+int quantmain(int argc, char** argv) {
+	if (argc < 1) {
+		fprintf(stderr, "Usage: linfit quant <data file>\n");
+		fflush(stderr);
+		return EXIT_FAILURE;
+	}
+
+	Data* data = dataload(argv[0], 0);
+	if (data == NULL || data->matrix == NULL) {
+		datafree(data);
+		return EXIT_FAILURE;
+	}
+
+	short storage = mtrstorage;
+	mtrstorage = MTR_F32;
+	trainstep(data);
+	mtrstorage = storage;
+
+	Matrix* X = datax(data);
+	size_t count = data->count;
+	Matrix** ys = malloc(sizeof(Matrix*) * count);
+	double* jref = malloc(sizeof(double) * count);
+	for (size_t k = 0; k < count; k++) {
+		ys[k] = datay(data, k);
+		jref[k] = j(X, data->models[k], ys[k], 0);
+	}
+
+	printf("%zu rows, %zu features, %zu models.\n\n", X->m, X->n, count);
+	printf("%-8s %10s %12s %12s %12s %12s %10s\n", "Storage", "MB",
+			"Max err", "RMS err", "Pred RMS", "Max j diff", "j ms");
+	for (short t = MTR_F32; t <= MTR_INT8; t++) {
+		quantreport(X, data, ys, jref, t);
+	}
+	flush();
+
+	for (size_t k = 0; k < count; k++) {
+		mtrfree(ys[k]);
+	}
+	free(ys);
+	free(jref);
+	mtrfree(X);
+	datafree(data);
+
+	return EXIT_SUCCESS;
+}
+
+static void quantreport(Matrix* X, Data* data, Matrix** ys, double* jref,
+		short type) {
+	Matrix* P = mtrpack(X, 0, X->m, type);
+	size_t m = X->m;
+	size_t n = X->n;
+	size_t count = data->count;
+
+	float* row = malloc(sizeof(float) * n);
+	float* xrow = malloc(sizeof(float) * n);
+	double maxerr = 0;
+	double sqerr = 0;
+	double sqpred = 0;
+	for (size_t i = 0; i < m; i++) {
+		float* x = mtrload(X, i, xrow);
+		float* p = mtrload(P, i, row);
+		for (size_t k = 0; k < n; k++) {
+			double err = fabs((double) p[k] - x[k]);
+			maxerr = err > maxerr ? err : maxerr;
+			sqerr += err * err;
+		}
+
+		for (size_t k = 0; k < count; k++) {
+			LinearModel* model = data->models[k];
+			double d = h(p, n, model->bias, model->theta)
+					- h(x, n, model->bias, model->theta);
+			sqpred += d * d;
+		}
+	}
+	free(row);
+	free(xrow);
+
+	double start = wtime();
+	double maxdiff = 0;
+	for (size_t k = 0; k < count; k++) {
+		double jp = j(P, data->models[k], ys[k], 0);
+		double diff = jref[k] != 0 ? fabs(jp - jref[k]) / jref[k] : 0;
+		maxdiff = diff > maxdiff ? diff : maxdiff;
+	}
+	double seconds = wtime() - start;
+
+	printf("%-8s %10.3f %12.3g %12.3g %12.3g %11.4f%% %10.3f\n",
+			mtrtypename(type),
+			(double) m * mtrbase(X) * mtrvalsize(type) / 1e6, maxerr,
+			sqrt(sqerr / (m * n)), sqrt(sqpred / (m * count)), maxdiff * 100,
+			seconds * 1e3);
+
+	mtrfree(P);
+}
@@ -0,0 +1,26 @@
+/*
+ * quant.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef QUANT_H_
+#define QUANT_H_
+
+#include <stdint.h>
+#include "ml.h"
+
+uint16_t tobf16(float val);
+float frombf16(uint16_t val);
+uint16_t tofp16(float val);
+float fromfp16(uint16_t val);
+
+short mtrtype(char* name);
+char* mtrtypename(short type);
+size_t mtrvalsize(short type);
+Matrix* mtrpack(Matrix* mtr, size_t fromIdx, size_t toIdx, short type);
+float* mtrload(Matrix* mtr, size_t i, float* dest);
+int quantmain(int argc, char** argv);
+
+#endif /* QUANT_H_ */
@@ -0,0 +1,627 @@
+/*
+ * refresh.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+#include "ml.h"
+#include "ui.h"
+#include "mem.h"
+#include "artifact.h"
+#include "enet.h"
+#include "refresh.h"
+
+static char* refreshread(char* path, size_t from, size_t to);
+static char*** refreshrows(char* bytes, size_t length, Mapper* map,
+		size_t* rowsOut);
+static void refreshrowsfree(char*** body, size_t rows);
+static int refreshdata(Data* data, Artifact* art, char*** old, size_t olds,
+		char*** body, size_t rows);
+static int refreshstats(GridInfo* info, Mapper* map, char*** body,
+		size_t rows);
+static void refreshword(Mapper* map, size_t col, char* val);
+static LinearModel* refreshmodel(Artifact* art, size_t k, size_t* oldOffsets,
+		Data* data, size_t* offsets, size_t xn);
+static LinearModel* refreshold(Artifact* art, size_t k);
+static short refreshvalid(float mean, float stdev);
+static double refreshlambda(Artifact* art, size_t k, Matrix* X);
+static void refreshfit(Matrix* X, LinearModel* model, Matrix* y,
+		double lambda, Fit* fit);
+
+/*
+ * Updates a model with the rows appended to its data file since it was
+ * trained. Only the rows after the offset stored in the model are parsed
+ * for statistics: they are merged in to the stored GridInfo, new words are
+ * added to the Mapper, and the weights are moved to the new
+ * standardization. Then every model is trained on all the rows, the old
+ * ones and the new ones, starting from its old weights and with the lambda
+ * it was trained with. Training on the new rows alone would fit them and
+ * forget the rest when only a few were appended.
+ *
+ * The lambdas are converted to the scale of the engine given with
+ * --engine, see Artifact, and cd keeps the l1 ratio the model was fit
+ * with. A model fit by cd with an l1 share can only be refreshed by cd.
+ *
+ *   linfit refresh <data file> <model file>
+ *
+ * A word that shows up in a column of numbers can not be merged, and the
+ * model has to be trained again from the whole file.
+ */
+int refreshmain(int argc, char** argv) {
+	if (argc < 2) {
+		fprintf(stderr, "Usage: linfit refresh <data file> <model file>\n");
+		fflush(stderr);
+		return EXIT_FAILURE;
+	}
+
+	char* dataPath = argv[0];
+	char* modelPath = argv[1];
+	double start = wtime();
+
+	Artifact* art = artload(modelPath);
+	if (art == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	if (art->engine == ENGINE_CD && art->mix > 0 && trainengine != ENGINE_CD) {
+		fflush(stdout);
+		fprintf(stderr, "%s was fit by cd with an l1 ratio of %g, refresh it "
+				"with --engine cd.\n", modelPath, art->mix);
+		fflush(stderr);
+		artfree(art);
+		return EXIT_FAILURE;
+	}
+
+	//a ridge lambda of sgd or lbfgs is a cd lambda with no l1 share.
+	if (trainengine == ENGINE_CD) {
+		enetmix = art->engine == ENGINE_CD ? art->mix : 0;
+	}
+
+	struct stat st;
+	if (stat(dataPath, &st) == -1) {
+		fflush(stdout);
+		fprintf(stderr, "There was a problem with the file %s.\n", dataPath);
+		fflush(stderr);
+		artfree(art);
+		return EXIT_FAILURE;
+	}
+
+	if (art->expand) {
+		fflush(stdout);
+		fprintf(stderr, "%s was trained on expanded features, train it "
+				"again.\n", modelPath);
+		fflush(stderr);
+		artfree(art);
+		return EXIT_FAILURE;
+	}
+
+	size_t size = st.st_size;
+	size_t offset = art->offset;
+	if (offset == 0 || size < offset) {
+		fflush(stdout);
+		fprintf(stderr, "%s was not trained from the start of %s, train it "
+				"again.\n", modelPath, dataPath);
+		fflush(stderr);
+		artfree(art);
+		return EXIT_FAILURE;
+	}
+
+	if (size == offset) {
+		printf("%s is up to date.\n", modelPath);
+		artfree(art);
+		return EXIT_SUCCESS;
+	}
+
+	char* raw = refreshread(dataPath, 0, size);
+	if (raw == NULL) {
+		artfree(art);
+		return EXIT_FAILURE;
+	}
+
+	//starts one byte before the offset, to check that the tail starts a
+	//new row instead of extending the last one.
+	char* tail = raw + offset - 1;
+	if (tail[0] != '\n' && tail[1] != '\n') {
+		fflush(stdout);
+		fprintf(stderr, "The last row of %s was changed, train %s again.\n",
+				dataPath, modelPath);
+		fflush(stderr);
+		memfree(MEM_RAW, raw);
+		artfree(art);
+		return EXIT_FAILURE;
+	}
+
+	size_t rows;
+	char*** body = refreshrows(tail + 1, size - offset, art->map, &rows);
+	if (body == NULL || rows == 0) {
+		if (body) {
+			printf("No new rows in %s.\n", dataPath);
+		}
+		memfree(MEM_RAW, raw);
+		artfree(art);
+		return body ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	size_t olds;
+	char*** old = refreshrows(raw, offset, art->map, &olds);
+	if (old == NULL) {
+		refreshrowsfree(body, rows);
+		memfree(MEM_RAW, raw);
+		artfree(art);
+		return EXIT_FAILURE;
+	}
+
+	Data* data = calloc(1, sizeof(Data));
+	data->info = ginfocopy(art->info);
+	data->map = mapcopy(art->map);
+	data->bytes = size;
+
+	int ret = refreshdata(data, art, old, olds, body, rows);
+	refreshrowsfree(old, olds);
+	refreshrowsfree(body, rows);
+	memfree(MEM_RAW, raw);
+
+	if (ret == 0) {
+		char* tmp = cnew(strlen(modelPath) + 4);
+		strcpy(tmp, modelPath);
+		strcat(tmp, ".tmp");
+
+		double* lambdas = datalambdas(data);
+		ret = artsave(tmp, data->map, data->info, NULL, NULL, data->models,
+				lambdas, trainengine, enetmix, data->count, data->bytes);
+		free(lambdas);
+		if (ret == 0 && rename(tmp, modelPath) != 0) {
+			fflush(stdout);
+			fprintf(stderr, "Could not rename %s: %s.\n", tmp,
+					strerror(errno));
+			fflush(stderr);
+			ret = -1;
+		}
+		free(tmp);
+	}
+
+	if (ret == 0) {
+		printf("Refreshed %s with %zu new rows (%zu bytes) in %.3f seconds, "
+				"%zu rows in total.\n", modelPath, rows, size - offset,
+				wtime() - start, data->info->rows);
+	}
+
+	datafree(data);
+	artfree(art);
+	return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * Reads the bytes [from, to) of a file.
+ */
+static char* refreshread(char* path, size_t from, size_t to) {
+	FILE* f = fopen(path, "r");
+	if (f == NULL || fseeko(f, from, SEEK_SET) != 0) {
+		fflush(stdout);
+		fprintf(stderr, "There was a problem with the file %s.\n", path);
+		fflush(stderr);
+		if (f) {
+			fclose(f);
+		}
+		return NULL;
+	}
+
+	size_t length = to - from;
+	char* bytes = memalloc(MEM_RAW, length + 1);
+	size_t r = fread(bytes, sizeof(char), length, f);
+	fclose(f);
+	bytes[r] = '\0';
+
+	if (r != length) {
+		fflush(stdout);
+		fprintf(stderr, "Could not read the end of %s.\n", path);
+		fflush(stderr);
+		memfree(MEM_RAW, bytes);
+		return NULL;
+	}
+
+	return bytes;
+}
+
+/*
+ * Splits length bytes of the data file in rows of the columns of the
+ * mapper, pointing in to the bytes themselves. Empty lines are skipped, and
+ * any other line that does not have the columns of the data file is an
+ * error.
+ */
+static char*** refreshrows(char* bytes, size_t length, Mapper* map,
+		size_t* rowsOut) {
+	size_t lines = ccount(bytes, length, '\n') + 1;
+	char*** body = memcalloc(MEM_GRID, lines, sizeof(char**));
+	size_t cols = map->cols;
+	size_t width = map->width;
+	char** split = memalloc(MEM_SCRATCH, sizeof(char*) * width);
+
+	size_t rows = 0;
+	size_t line = 0;
+	char* p = bytes;
+	char* end = bytes + length;
+	while (p < end) {
+		char* nl = memchr(p, '\n', end - p);
+		size_t l = nl ? (size_t) (nl - p) : (size_t) (end - p);
+		line++;
+
+		if (l > 0 && !(l == 1 && p[0] == '\r')) {
+			if (rowsplit(p, l, ',', split, width) != width) {
+				fflush(stdout);
+				fprintf(stderr, "Invalid row %zu, expected %zu columns.\n",
+						line, width);
+				fflush(stderr);
+				memfree(MEM_SCRATCH, split);
+				refreshrowsfree(body, rows);
+				return NULL;
+			}
+
+			char** row = memalloc(MEM_GRID, sizeof(char*) * cols);
+			rowpick(map, split, width, row);
+			body[rows++] = row;
+		}
+
+		p += l + 1;
+	}
+	memfree(MEM_SCRATCH, split);
+
+	*rowsOut = rows;
+	return body;
+}
+
+static void refreshrowsfree(char*** body, size_t rows) {
+	for (size_t i = 0; i < rows; i++) {
+		memfree(MEM_GRID, body[i]);
+	}
+	memfree(MEM_GRID, body);
+}
+
+/*
+ * Merges the new rows in to the info and mapper of data, moves the stored
+ * models to the new layout and trains them on a matrix of the old rows
+ * the models were trained on and the new rows.
+ */
+static int refreshdata(Data* data, Artifact* art, char*** old, size_t olds,
+		char*** body, size_t rows) {
+	GridInfo* info = data->info;
+	Mapper* map = data->map;
+	size_t cols = map->cols;
+	size_t ycol = cols - 1;
+
+	if (refreshstats(info, map, body, rows) != 0) {
+		return -1;
+	}
+
+	size_t* oldOffsets = mtroffsets(art->map, art->info->missing);
+	size_t* offsets = mtroffsets(map, info->missing);
+	size_t n = offsets[cols];
+	size_t xn = map->map[ycol] ? offsets[ycol] : n - 1;
+
+	dataalloc(data);
+	for (size_t k = 0; k < data->count; k++) {
+		if (k < art->count) {
+			data->models[k] = refreshmodel(art, k, oldOffsets, data, offsets,
+					xn);
+		} else {
+			data->models[k] = modlinear(xn);
+		}
+	}
+
+	size_t m = olds + rows;
+	data->matrix = mtrnew(m, n);
+	for (size_t i = 0; i < m; i++) {
+		char** row = i < olds ? old[i] : body[i - olds];
+		mtrrow(map, info, offsets, row, cols, data->matrix->values + i * n);
+	}
+	mtrshuffle(data->matrix);
+	free(oldOffsets);
+	free(offsets);
+
+	Matrix* X = datax(data);
+	for (size_t k = 0; k < data->count; k++) {
+		Matrix* y = datay(data, k);
+		LinearModel* model = data->models[k];
+		char* kind;
+		if (k < art->count) {
+			refreshfit(X, model, y, refreshlambda(art, k, X), &data->fits[k]);
+			kind = "warm";
+		} else if (m >= 10) {
+			//a class that was not there before, nothing to start from.
+			dotrain(X, model, y, &data->fits[k], 0);
+			kind = "new";
+		} else {
+			refreshfit(X, model, y, 0, &data->fits[k]);
+			kind = "new";
+		}
+
+		Fit* fit = &data->fits[k];
+		if (map->map[ycol]) {
+			char* yval = map->map[ycol][k];
+			printf("y: %-16s %-4s j %12.8f -> %12.8f\n", yval ? yval : "(blank)",
+					kind, fit->jbefore, fit->jafter);
+		} else {
+			printf("y  %-4s j %12.8f -> %12.8f\n", kind, fit->jbefore,
+					fit->jafter);
+		}
+		mtrfree(y);
+	}
+	mtrfree(X);
+
+	return 0;
+}
+
+/*
+ * Adds the values of the new rows to the statistics of every column, with
+ * the same rules ginfo and mapcreate follow for a whole grid. The mean and
+ * the m2 of Welford's method are recovered from the stored mean and
+ * variance, so the result is what ginfo would compute for all the rows.
+ */
+static int refreshstats(GridInfo* info, Mapper* map, char*** body,
+		size_t rows) {
+	size_t cols = info->columns;
+
+	for (size_t j = 0; j < cols; j++) {
+		size_t numbers = info->numbers[j];
+		double n = numbers;
+		double mean = numbers > 0 ? info->mean[j] : 0;
+		double m2 = numbers > 1 ? info->stdev[j] * (n - 1) : 0;
+		size_t added = 0;
+		size_t discrete = 0;
+
+		for (size_t i = 0; i < rows; i++) {
+			char* val = body[i][j];
+			if (val == NULL) {
+				info->missing[j]++;
+				if (map->map[j]) {
+					refreshword(map, j, NULL);
+				}
+				continue;
+			}
+
+			double x;
+			if (numparse(val, -1, &x) == 0) {
+				if (map->map[j] == NULL && map->buckets[j] == 0) {
+					if (info->numbers[j] > 0) {
+						fflush(stdout);
+						fprintf(stderr, "Column %zu has the word '%s' in a "
+								"column of numbers, the model has to be "
+								"trained again.\n", j + 1, val);
+						fflush(stderr);
+						return -1;
+					}
+
+					//a column that was blank so far becomes a word column.
+					if (info->missing[j] > 0) {
+						refreshword(map, j, NULL);
+					}
+				}
+
+				info->words[j]++;
+				refreshword(map, j, val);
+				continue;
+			}
+
+			float num = (float) x;
+			if (ceil(num) == num) {
+				discrete++;
+			}
+			info->max[j] = higher(info->max[j], num);
+			info->min[j] = lower(info->min[j], num);
+			info->numbers[j]++;
+			added++;
+
+			if (map->map[j] || map->buckets[j]) {
+				refreshword(map, j, val);
+				continue;
+			}
+
+			n++;
+			double delta = x - mean;
+			mean += delta / n;
+			m2 += delta * (x - mean);
+		}
+
+		if (added > 0) {
+			info->discrete[j] = discrete == added
+					&& (numbers == 0 || info->discrete[j]);
+		}
+
+		short word = map->map[j] || map->buckets[j];
+		if (!word && n > 0) {
+			info->mean[j] = (float) mean;
+			info->stdev[j] = (float) m2 / (n - 1);
+		} else if (word) {
+			info->mean[j] = NAN;
+			info->stdev[j] = NAN;
+		}
+	}
+
+	info->rows += rows;
+	return 0;
+}
+
+/*
+ * Appends a value to the dictionary of a column, unless it is already there
+ * or the column is hashed.
+ */
+static void refreshword(Mapper* map, size_t col, char* val) {
+	if (map->buckets[col]
+			|| (map->map[col] && mapidx(map, col, val) != -1)) {
+		return;
+	}
+
+	size_t size = map->map[col] ? map->sizes[col] : 0;
+	char** words = memalloc(MEM_MAPPER, sizeof(char*) * (size + 1));
+	if (size > 0) {
+		memcpy(words, map->map[col], sizeof(char*) * size);
+	}
+	memfree(MEM_MAPPER, map->map[col]);
+
+	if (val) {
+		words[size] = memalloc(MEM_MAPPER, strlen(val) + 1);
+		strcpy(words[size], val);
+	} else {
+		words[size] = NULL;
+	}
+
+	map->map[col] = words;
+	map->sizes[col] = size + 1;
+}
+
+/*
+ * Creates a copy of the k-th stored model with the layout and the
+ * standardization of data, so it makes the same predictions it did with
+ * the old ones. The copy has every feature, even if the stored one was
+ * pruned. For a number column, a value x was encoded as
+ * (x - m0) / s0 and now is (x - m1) / s1, so its weight is scaled by s1 / s0
+ * and the difference of the means goes to the bias. New words start at 0.
+ */
+static LinearModel* refreshmodel(Artifact* art, size_t k, size_t* oldOffsets,
+		Data* data, size_t* offsets, size_t xn) {
+	GridInfo* info0 = art->info;
+	Mapper* map0 = art->map;
+	GridInfo* info = data->info;
+	Mapper* map = data->map;
+	size_t ycol = map->cols - 1;
+	LinearModel* old = refreshold(art, k);
+
+	LinearModel* model = modlinear(xn);
+	model->bias = old->bias;
+
+	for (size_t j = 0; j < ycol; j++) {
+		double* w0 = old->theta + oldOffsets[j];
+		double* w = model->theta + offsets[j];
+
+		if (map->buckets[j]) {
+			//the same words still go to the same buckets.
+			copyd(w, w0, map->buckets[j]);
+			continue;
+		}
+
+		if (map->map[j]) {
+			//the dictionaries only grow at the end.
+			for (size_t i = 0; i < map->sizes[j]; i++) {
+				if (map0->map[j]) {
+					w[i] = i < map0->sizes[j] ? w0[i] : 0;
+				} else {
+					//a blank column that now has words, the blank word
+					//keeps the weight of the missing flag.
+					w[i] = map->map[j][i] == NULL && info0->missing[j] > 0 ?
+							w0[0] : 0;
+				}
+			}
+			continue;
+		}
+
+		short flag0 = info0->missing[j] > 0;
+		double wflag = flag0 ? w0[0] : 0;
+		double wval = w0[flag0];
+		double shift = 0;
+
+		float s0 = info0->stdev[j];
+		float s1 = info->stdev[j];
+		if (refreshvalid(info0->mean[j], s0)
+				&& refreshvalid(info->mean[j], s1)) {
+			shift = wval * (info->mean[j] - info0->mean[j]) / s0;
+			wval = wval * s1 / s0;
+		} else {
+			wval = 0;
+		}
+
+		model->bias += shift;
+		if (info->missing[j] > 0) {
+			//a missing value had no shift before, so the flag takes it back.
+			w[0] = wflag - shift;
+			w[1] = wval;
+		} else {
+			w[0] = wval;
+		}
+	}
+
+	//the missing flag of a number y column is the last value of X.
+	if (xn > offsets[ycol] && old->length > oldOffsets[ycol]) {
+		model->theta[offsets[ycol]] = old->theta[oldOffsets[ycol]];
+	}
+
+	//a number y is standardized too, the old output h0 is now
+	//h0 * s0 / s1 + (m0 - m1) / s1.
+	float s0 = info0->stdev[ycol];
+	float s1 = info->stdev[ycol];
+	if (map->map[ycol] == NULL && refreshvalid(info0->mean[ycol], s0)
+			&& refreshvalid(info->mean[ycol], s1)) {
+		double a = s0 / s1;
+		for (size_t i = 0; i < xn; i++) {
+			model->theta[i] *= a;
+		}
+		model->bias = model->bias * a
+				+ (info0->mean[ycol] - info->mean[ycol]) / s1;
+	}
+	modfree(old);
+
+	return model;
+}
+
+/*
+ * Copies the k-th stored model with a weight for every encoded feature, 0
+ * for the ones that were pruned.
+ */
+static LinearModel* refreshold(Artifact* art, size_t k) {
+	LinearModel* stored = art->models[k];
+	Prune* p = art->prune;
+
+	LinearModel* old = modlinear(p ? p->n : stored->length);
+	old->bias = stored->bias;
+	if (p == NULL) {
+		copyd(old->theta, stored->theta, stored->length);
+		return old;
+	}
+
+	for (size_t i = 0; i < p->kept; i++) {
+		old->theta[p->keep[i]] = stored->theta[i];
+	}
+
+	return old;
+}
+
+static short refreshvalid(float mean, float stdev) {
+	return isfinite(mean) && isfinite(stdev) && stdev > 0;
+}
+
+/*
+ * The lambda of the k-th stored model in the scale of trainengine. A ridge
+ * lambda of sgd or lbfgs is the one of cd times the weight of the rows.
+ */
+static double refreshlambda(Artifact* art, size_t k, Matrix* X) {
+	double lambda = art->lambdas[k];
+	short cd = trainengine == ENGINE_CD;
+	if (cd == (art->engine == ENGINE_CD)) {
+		return lambda;
+	}
+
+	double m = mtrweight(X, 0, X->m);
+	return cd ? lambda / m : lambda * m;
+}
+
+/*
+ * Trains a model starting from its current weights, the same way dotrain
+ * does from random ones.
+ */
+static void refreshfit(Matrix* X, LinearModel* model, Matrix* y,
+		double lambda, Fit* fit) {
+	fit->jbefore = j(X, model, y, 0);
+	double start = wtime();
+	enginefit(X, model, y, lambda);
+	fit->seconds = wtime() - start;
+	fit->jafter = j(X, model, y, 0);
+	fit->lambda = lambda;
+}
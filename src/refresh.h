@@ -0,0 +1,13 @@
+/*
+ * refresh.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef REFRESH_H_
+#define REFRESH_H_
+
+int refreshmain(int argc, char** argv);
+
+#endif /* REFRESH_H_ */
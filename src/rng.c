@@ -0,0 +1,124 @@
+/*
+ * rng.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+
+#include "rng.h"
+
+uint64_t rngseed = 0;
+
+static __thread Rng rngstate;
+static __thread short rngready = 0;
+
+//streams handed to threads that were not seeded explicitly.
+static uint64_t rngstreams = 0;
+
+static uint64_t rngmix(uint64_t* x);
+static uint64_t rngrotl(uint64_t x, int k);
+
+/*
+ * Seeds the generator of the calling thread. Different streams of the same
+ * seed give unrelated sequences, so a task that always gets the same stream
+ * is reproducible no matter which thread runs it.
+ */
+void rnginit(uint64_t seed, uint64_t stream) {
+	uint64_t x = stream;
+	x = seed ^ rngmix(&x);
+	for (int i = 0; i < 4; i++) {
+		rngstate.s[i] = rngmix(&x);
+	}
+	rngready = 1;
+}
+
+/*
+ * Returns the generator of the calling thread. A thread that did not call
+ * rnginit gets the next free stream of rngseed, above the ones used by
+ * explicit seeds.
+ */
+Rng* rngthread() {
+	if (!rngready) {
+		uint64_t stream = __sync_fetch_and_add(&rngstreams, 1);
+		rnginit(rngseed, (UINT64_C(1) << 63) | stream);
+	}
+	return &rngstate;
+}
+
+uint64_t rngnext(Rng* rng) {
+	uint64_t* s = rng->s;
+	uint64_t result = rngrotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rngrotl(s[3], 45);
+
+	return result;
+}
+
+/*
+ * Returns a number in [0, bound) without modulo bias, with Lemire's
+ * multiply and shift method. bound must not be 0.
+ */
+size_t rngbelow(Rng* rng, size_t bound) {
+	uint64_t b = bound;
+	unsigned __int128 p = (unsigned __int128) rngnext(rng) * b;
+	uint64_t low = (uint64_t) p;
+	if (low < b) {
+		uint64_t threshold = -b % b;
+		while (low < threshold) {
+			p = (unsigned __int128) rngnext(rng) * b;
+			low = (uint64_t) p;
+		}
+	}
+	return (size_t) (p >> 64);
+}
+
+/*
+ * Returns a double in [0, 1).
+ */
+double rngunit(Rng* rng) {
+	return (rngnext(rng) >> 11) * 0x1.0p-53;
+}
+
+/*
+ * Fills idx with a random permutation of [0, m).
+ */
+void rngperm(Rng* rng, size_t* idx, size_t m) {
+	for (size_t i = 0; i < m; i++) {
+		idx[i] = i;
+	}
+	rngshuffle(rng, idx, m);
+}
+
+/*
+ * Fisher-Yates shuffle, every order has the same probability.
+ */
+void rngshuffle(Rng* rng, size_t* idx, size_t m) {
+	for (size_t i = m; i > 1; i--) {
+		size_t k = rngbelow(rng, i);
+		size_t tmp = idx[i - 1];
+		idx[i - 1] = idx[k];
+		idx[k] = tmp;
+	}
+}
+
+/*
+ * splitmix64, turns a counter in to well mixed seeds.
+ */
+static uint64_t rngmix(uint64_t* x) {
+	uint64_t z = (*x += UINT64_C(0x9e3779b97f4a7c15));
+	z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+	z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+	return z ^ (z >> 31);
+}
+
+static uint64_t rngrotl(uint64_t x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
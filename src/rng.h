@@ -0,0 +1,34 @@
+/*
+ * rng.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef RNG_H_
+#define RNG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * State of a xoshiro256** generator. Each thread has its own, so threads
+ * never share a sequence, and a thread seeded with the same seed and
+ * stream always produces the same numbers.
+ */
+typedef struct Rng{
+	uint64_t s[4];
+}Rng;
+
+//seed of every stream, given with --seed or taken from the clock.
+extern uint64_t rngseed;
+
+void rnginit(uint64_t seed, uint64_t stream);
+Rng* rngthread();
+uint64_t rngnext(Rng* rng);
+size_t rngbelow(Rng* rng, size_t bound);
+double rngunit(Rng* rng);
+void rngperm(Rng* rng, size_t* idx, size_t m);
+void rngshuffle(Rng* rng, size_t* idx, size_t m);
+
+#endif /* RNG_H_ */
@@ -0,0 +1,287 @@
+/*
+ * runner.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "artifact.h"
+#include "enet.h"
+#include "lbfgs.h"
+#include "runner.h"
+#include "rng.h"
+
+static size_t runlist(char* arg, RunJob** jobs);
+static void runadd(RunJob** jobs, size_t* count, size_t* cap, char* path,
+		char* model);
+static void runload(void* arg);
+static void runtrain(void* arg);
+static void runprint(FILE* f, RunJob* job);
+
+/*
+ * Loads and trains a list of datasets without user interaction. The
+ * datasets are loaded and trained concurrently on a shared pool of threads,
+ * and a JSON summary per dataset is printed, in the order of the list, once
+ * every dataset has finished.
+ *
+ *   linfit run <list file | directory> [threads]
+ *
+ * Each line of the list file is a dataset path optionally followed by
+ * 'model=<file>', to save the trained models. Blank lines and lines starting
+ * with '#' are ignored. When a directory is given, every *.data file in it
+ * is used. The cpus are shared by the datasets, so an L-BFGS fit only
+ * gets its share of them.
+ */
+int runmain(int argc, char** argv) {
+	if (argc < 1 || argc > 2) {
+		fprintf(stderr, "Usage: linfit run <list file | directory> [threads]\n");
+		fflush(stderr);
+		return EXIT_FAILURE;
+	}
+
+	size_t threads = argc == 2 ? strtoul(argv[1], NULL, 10) : 0;
+
+	RunJob* jobs = NULL;
+	size_t count = runlist(argv[0], &jobs);
+	if (count == 0) {
+		fprintf(stderr, "No dataset to run in %s.\n", argv[0]);
+		fflush(stderr);
+		free(jobs);
+		return EXIT_FAILURE;
+	}
+
+	Pool* pool = poolnew(threads);
+	size_t share = cpucount() / pool->size;
+	lbfgsthreads = share > 0 ? share : 1;
+	double start = wtime();
+	for (size_t i = 0; i < count; i++) {
+		jobs[i].id = i;
+		jobs[i].pool = pool;
+		poolsubmit(pool, runload, &jobs[i]);
+	}
+	poolwait(pool);
+	double seconds = wtime() - start;
+	poolfree(pool);
+
+	size_t failed = 0;
+	for (size_t i = 0; i < count; i++) {
+		RunJob* job = &jobs[i];
+		runprint(stdout, job);
+		failed += job->failed;
+
+		datafree(job->data);
+		free(job->path);
+		free(job->model);
+	}
+	free(jobs);
+
+	fprintf(stderr, "%zu datasets, %zu failed, %.3f s.\n", count, failed,
+			seconds);
+	fflush(stdout);
+	fflush(stderr);
+
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * Reads the datasets of a list file or a directory in to jobs, and returns
+ * the number of datasets.
+ */
+static size_t runlist(char* arg, RunJob** jobs) {
+	size_t count = 0;
+	size_t cap = 0;
+	*jobs = NULL;
+
+	DIR* dir = opendir(arg);
+	if (dir) {
+		struct dirent* ent;
+		while ((ent = readdir(dir)) != NULL) {
+			char* p = strrchr(ent->d_name, '.');
+			if (p == NULL || lowercmp(p, ".data") != 1) {
+				continue;
+			}
+
+			size_t l = strlen(arg);
+			char* path = cnew(l + 1 + strlen(ent->d_name));
+			strcpy(path, arg);
+			path[l] = '/';
+			strcpy(path + l + 1, ent->d_name);
+			runadd(jobs, &count, &cap, path, NULL);
+		}
+		closedir(dir);
+		return count;
+	}
+
+	FILE* f = fopen(arg, "r");
+	if (f == NULL) {
+		return 0;
+	}
+
+	char line[4096];
+	while (fgets(line, sizeof(line), f)) {
+		char* path = strtok(line, " \t\r\n");
+		if (path == NULL || path[0] == '#') {
+			continue;
+		}
+
+		char* model = NULL;
+		char* opt;
+		while ((opt = strtok(NULL, " \t\r\n")) != NULL) {
+			if (strncmp(opt, "model=", 6) == 0) {
+				model = cnew(strlen(opt + 6));
+				strcpy(model, opt + 6);
+			} else {
+				fprintf(stderr, "Ignoring unknown setting '%s' for %s.\n", opt,
+						path);
+				fflush(stderr);
+			}
+		}
+
+		char* copy = cnew(strlen(path));
+		strcpy(copy, path);
+		runadd(jobs, &count, &cap, copy, model);
+	}
+	fclose(f);
+
+	return count;
+}
+
+static void runadd(RunJob** jobs, size_t* count, size_t* cap, char* path,
+		char* model) {
+	if (*count == *cap) {
+		*cap = *cap * 2 + 8;
+		*jobs = realloc(*jobs, sizeof(RunJob) * (*cap));
+	}
+
+	RunJob* job = &(*jobs)[*count];
+	memset(job, 0, sizeof(RunJob));
+	job->path = path;
+	job->model = model;
+	(*count)++;
+}
+
+/*
+ * Task of the pool: loads a dataset, then queues one training task for each
+ * of its models.
+ */
+static void runload(void* arg) {
+	RunJob* job = arg;
+
+	//every task seeds its own stream, so the results do not depend on
+	//which thread runs it.
+	rnginit(rngseed, job->id << 32);
+
+	double start = wtime();
+	job->data = dataload(job->path, 0);
+	job->loadsec = wtime() - start;
+
+	if (job->data == NULL || job->data->matrix == NULL) {
+		job->failed = 1;
+		return;
+	}
+
+	Data* data = job->data;
+	mtrshuffle(data->matrix);
+	job->X = datax(data);
+	job->rows = job->X->m;
+	job->features = job->X->n;
+	dataalloc(data);
+	job->remaining = data->count;
+	job->trainstart = wtime();
+
+	for (size_t k = 0; k < data->count; k++) {
+		RunTask* task = malloc(sizeof(RunTask));
+		task->job = job;
+		task->k = k;
+		poolsubmit(job->pool, runtrain, task);
+	}
+}
+
+/*
+ * Task of the pool: trains a single model of a dataset. The last model of
+ * the dataset saves the artifact, if requested, and frees the matrices.
+ */
+static void runtrain(void* arg) {
+	RunTask* task = arg;
+	RunJob* job = task->job;
+	Data* data = job->data;
+	size_t k = task->k;
+	free(task);
+
+	rnginit(rngseed, (job->id << 32) | (k + 1));
+
+	Matrix* y = datay(data, k);
+	LinearModel* model = modlinear(job->X->n);
+	dotrain(job->X, model, y, &data->fits[k], 0);
+	data->models[k] = model;
+	mtrfree(y);
+
+	if (__sync_sub_and_fetch(&job->remaining, 1) > 0) {
+		return;
+	}
+
+	job->trainsec = wtime() - job->trainstart;
+	mtrfree(job->X);
+	job->X = NULL;
+	mtrfree(data->matrix);
+	data->matrix = NULL;
+
+	if (job->model) {
+		double* lambdas = datalambdas(data);
+		if (artsave(job->model, data->map, data->info, data->expand,
+				data->prune, data->models, lambdas, trainengine, enetmix,
+				data->count, data->bytes) != 0) {
+			job->failed = 1;
+		}
+		free(lambdas);
+	}
+}
+
+static void runprint(FILE* f, RunJob* job) {
+	fputs("{\"file\":", f);
+	fjsonstr(f, job->path);
+	fprintf(f, ",\"status\":\"%s\"", job->failed ? "failed" : "ok");
+	fprintf(f, ",\"load_s\":");
+	fjsonnum(f, job->loadsec);
+
+	Data* data = job->data;
+	if (data == NULL || data->fits == NULL) {
+		fputs("}\n", f);
+		return;
+	}
+
+	fprintf(f, ",\"rows\":%zu,\"features\":%zu,\"train_s\":", job->rows,
+			job->features);
+	fjsonnum(f, job->trainsec);
+	fputs(",\"models\":[", f);
+
+	size_t ycol = data->map->cols - 1;
+	for (size_t k = 0; k < data->count; k++) {
+		Fit* fit = &data->fits[k];
+		if (k > 0) {
+			fputc(',', f);
+		}
+
+		fputs("{\"y\":", f);
+		if (data->map->map[ycol]) {
+			fjsonstr(f, data->map->map[ycol][k]);
+		} else {
+			fputs("null", f);
+		}
+		fputs(",\"lambda\":", f);
+		fjsonnum(f, fit->lambda);
+		fputs(",\"jbefore\":", f);
+		fjsonnum(f, fit->jbefore);
+		fputs(",\"jafter\":", f);
+		fjsonnum(f, fit->jafter);
+		fputs(",\"train_s\":", f);
+		fjsonnum(f, fit->seconds);
+		fputc('}', f);
+	}
+	fputs("]}\n", f);
+}
@@ -0,0 +1,46 @@
+/*
+ * runner.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef RUNNER_H_
+#define RUNNER_H_
+
+#include "utils.h"
+#include "ml.h"
+#include "ui.h"
+#include "pool.h"
+
+/*
+ * A dataset of a batch run. The dataset is loaded by one task of the pool,
+ * which then queues one training task per model. The last training task to
+ * finish releases the matrices.
+ */
+typedef struct RunJob{
+	size_t id;
+	char* path;
+	char* model;
+	Pool* pool;
+
+	Data* data;
+	Matrix* X;
+	size_t rows;
+	size_t features;
+	size_t remaining;
+	short failed;
+
+	double loadsec;
+	double trainstart;
+	double trainsec;
+}RunJob;
+
+typedef struct RunTask{
+	RunJob* job;
+	size_t k;
+}RunTask;
+
+int runmain(int argc, char** argv);
+
+#endif /* RUNNER_H_ */
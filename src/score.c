@@ -0,0 +1,494 @@
+/*
+ * score.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "utils.h"
+#include "ml.h"
+#include "pool.h"
+#include "score.h"
+
+//bytes of input given to each task.
+#define SCORE_CHUNK (4 * 1024 * 1024)
+
+typedef struct ScoreChunk{
+	Scorer* sc;
+
+	char* text;
+	size_t cap;
+	size_t length;
+
+	char* out;
+	size_t outlen;
+	size_t outcap;
+
+	size_t rows;
+	size_t unknown;
+}ScoreChunk;
+
+typedef struct ScoreInput{
+	FILE* f;
+	short eof;
+	char* carry;
+	size_t carrylen;
+	size_t carrycap;
+}ScoreInput;
+
+static void scorechunk(void* arg);
+static size_t scorefill(ScoreInput* in, ScoreChunk* chunks, size_t count);
+static short scorenext(ScoreInput* in, ScoreChunk* ch);
+static int scorewrite(FILE* out, ScoreChunk* chunks, size_t count);
+
+Scorer* scorernew(Artifact* art) {
+	Scorer* sc = malloc(sizeof(Scorer));
+	sc->art = art;
+	sc->cols = art->map->cols;
+	sc->offsets = mtroffsets(art->map, art->info->missing);
+	sc->width = sc->offsets[sc->cols];
+
+	//a line is split in to the columns of the data file first, and the
+	//ones the models use are picked after them in the same buffer.
+	sc->split = art->map->width + sc->cols;
+
+	//expanded rows are computed over the encoded ones, so each row needs
+	//room for every feature.
+	if (art->expand && art->expand->length > sc->width) {
+		sc->width = art->expand->length;
+	}
+
+	//the longest y value, used to size the output buffers.
+	sc->labellen = 0;
+	size_t ycol = sc->cols - 1;
+	if (art->map->map[ycol]) {
+		for (size_t k = 0; k < art->map->sizes[ycol]; k++) {
+			char* label = art->map->map[ycol][k];
+			if (label && strlen(label) > sc->labellen) {
+				sc->labellen = strlen(label);
+			}
+		}
+	}
+
+	//sparse models, like the ones of the cd engine, only read the features
+	//they use.
+	size_t xn = art->xn;
+	sc->support = calloc(art->count, sizeof(size_t*));
+	sc->used = calloc(art->count, sizeof(size_t));
+	for (size_t k = 0; k < art->count; k++) {
+		double* theta = art->models[k]->theta;
+		size_t used = 0;
+		for (size_t j = 0; j < xn; j++) {
+			used += theta[j] != 0;
+		}
+
+		if (used < xn / 2) {
+			sc->support[k] = malloc(sizeof(size_t) * (used + 1));
+			for (size_t j = 0; j < xn; j++) {
+				if (theta[j] != 0) {
+					sc->support[k][sc->used[k]++] = j;
+				}
+			}
+		}
+	}
+
+	return sc;
+}
+
+void scorerfree(Scorer* sc) {
+	if (sc) {
+		for (size_t k = 0; k < sc->art->count; k++) {
+			free(sc->support[k]);
+		}
+		free(sc->support);
+		free(sc->used);
+		free(sc->offsets);
+		free(sc);
+	}
+}
+
+/*
+ * Splits the line and encodes its feature columns in to x, which must have
+ * room for sc->width values. The line has the columns of the data file, and
+ * may or may not include the y column when it is the last one. cells must
+ * have room for sc->split pointers. Returns the number of values that could
+ * not be encoded.
+ */
+size_t scoreenc(Scorer* sc, char* line, size_t length, char** cells, float* x) {
+	Mapper* map = sc->art->map;
+	size_t xcols = sc->cols - 1;
+
+	size_t found = rowsplit(line, length, ',', cells, map->width);
+	char** picked = cells + map->width;
+	rowpick(map, cells, found, picked);
+
+	return mtrrow(map, sc->art->info, sc->offsets, picked, xcols, x);
+}
+
+/*
+ * Computes h for every row of X and every model of the artifact. X holds
+ * rows encoded by scoreenc, which are pruned and expanded in place when the
+ * artifact has them, and out receives rows * count values.
+ */
+void scoreblock(Scorer* sc, float* X, size_t rows, double* out) {
+	Artifact* art = sc->art;
+	size_t xn = art->xn;
+	size_t count = art->count;
+	size_t width = sc->width;
+
+	if (art->prune) {
+		for (size_t i = 0; i < rows; i++) {
+			pruneapply(art->prune, X + i * width);
+		}
+	}
+
+	if (art->expand) {
+		for (size_t i = 0; i < rows; i++) {
+			expapply(art->expand, X + i * width);
+		}
+	}
+
+	for (size_t k = 0; k < count; k++) {
+		LinearModel* model = art->models[k];
+		double bias = model->bias;
+		double* theta = model->theta;
+		size_t* support = sc->support[k];
+		if (support == NULL) {
+			for (size_t i = 0; i < rows; i++) {
+				out[i * count + k] = h(X + i * width, xn, bias, theta);
+			}
+			continue;
+		}
+
+		size_t used = sc->used[k];
+		for (size_t i = 0; i < rows; i++) {
+			float* x = X + i * width;
+			double ans = bias;
+			for (size_t q = 0; q < used; q++) {
+				ans += x[support[q]] * theta[support[q]];
+			}
+			out[i * count + k] = ans;
+		}
+	}
+}
+
+/*
+ * Writes the prediction of a single row to buf, followed by a new line.
+ * For a number y column, the value is converted back to the original scale.
+ * For a word y column, the y value with the highest score is written.
+ * Returns the number of bytes written.
+ */
+size_t scorefmt(Scorer* sc, double* scores, char* buf, size_t cap) {
+	Artifact* art = sc->art;
+	size_t ycol = sc->cols - 1;
+	GridInfo* info = art->info;
+
+	if (art->map->map[ycol] == NULL) {
+		double y = scores[0] * info->stdev[ycol] + info->mean[ycol];
+		int l = snprintf(buf, cap, "%.6g\n", y);
+		return l < 0 ? 0 : (size_t) l;
+	}
+
+	size_t best = 0;
+	for (size_t k = 1; k < art->count; k++) {
+		if (scores[k] > scores[best]) {
+			best = k;
+		}
+	}
+
+	char* label = art->map->map[ycol][best];
+	int l = snprintf(buf, cap, "%s\n", label ? label : "");
+	return l < 0 ? 0 : (size_t) l;
+}
+
+/*
+ * Scores every row of a csv file with a saved model, writing one prediction
+ * per line in the same order of the input. Chunks of the input are parsed
+ * and scored by a pool of threads, while the main thread reads the next
+ * chunks and writes the finished ones.
+ *
+ *   linfit score <model file> <input file> <output file> [threads]
+ *
+ * Use '-' for the standard input or output.
+ */
+int scoremain(int argc, char** argv) {
+	if (argc < 3 || argc > 4) {
+		fprintf(stderr, "Usage: linfit score <model file> <input file> "
+				"<output file> [threads]\n");
+		fflush(stderr);
+		return EXIT_FAILURE;
+	}
+
+	size_t threads = argc == 4 ? strtoul(argv[3], NULL, 10) : 0;
+
+	Artifact* art = artload(argv[0]);
+	if (art == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	FILE* in = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "rb");
+	if (in == NULL) {
+		fprintf(stderr, "Could not open the input file %s.\n", argv[1]);
+		fflush(stderr);
+		artfree(art);
+		return EXIT_FAILURE;
+	}
+
+	FILE* out = strcmp(argv[2], "-") == 0 ? stdout : fopen(argv[2], "wb");
+	if (out == NULL) {
+		fprintf(stderr, "Could not open the output file %s.\n", argv[2]);
+		fflush(stderr);
+		if (in != stdin) {
+			fclose(in);
+		}
+		artfree(art);
+		return EXIT_FAILURE;
+	}
+
+	double start = wtime();
+	Scorer* sc = scorernew(art);
+	Pool* pool = poolnew(threads);
+
+	//two sets of chunks: while the pool works on one of them, the main
+	//thread writes the results of the other and reads the next input.
+	size_t count = pool->size * 2;
+	ScoreChunk* sets[2];
+	for (int s = 0; s < 2; s++) {
+		sets[s] = calloc(count, sizeof(ScoreChunk));
+		for (size_t c = 0; c < count; c++) {
+			sets[s][c].sc = sc;
+		}
+	}
+
+	ScoreInput input;
+	input.f = in;
+	input.eof = 0;
+	input.carry = NULL;
+	input.carrylen = 0;
+	input.carrycap = 0;
+
+	int ret = 0;
+	size_t rows = 0;
+	size_t unknown = 0;
+
+	int crt = 0;
+	size_t filled = scorefill(&input, sets[crt], count);
+	for (size_t c = 0; c < filled; c++) {
+		poolsubmit(pool, scorechunk, &sets[crt][c]);
+	}
+
+	while (filled > 0) {
+		int nxt = 1 - crt;
+		size_t more = scorefill(&input, sets[nxt], count);
+
+		poolwait(pool);
+		for (size_t c = 0; c < more; c++) {
+			poolsubmit(pool, scorechunk, &sets[nxt][c]);
+		}
+
+		for (size_t c = 0; c < filled; c++) {
+			rows += sets[crt][c].rows;
+			unknown += sets[crt][c].unknown;
+		}
+
+		if (scorewrite(out, sets[crt], filled) != 0) {
+			ret = -1;
+		}
+
+		filled = more;
+		crt = nxt;
+	}
+
+	poolfree(pool);
+
+	for (int s = 0; s < 2; s++) {
+		for (size_t c = 0; c < count; c++) {
+			free(sets[s][c].text);
+			free(sets[s][c].out);
+		}
+		free(sets[s]);
+	}
+	free(input.carry);
+
+	if (in != stdin) {
+		fclose(in);
+	}
+
+	if (out == stdout) {
+		fflush(out);
+	} else if (fclose(out) != 0) {
+		ret = -1;
+	}
+
+	double elapsed = wtime() - start;
+	fprintf(stderr, "Scored %zu rows in %.3f s (%.0f rows/s), %zu unknown "
+			"values.\n", rows, elapsed, elapsed > 0 ? rows / elapsed : 0.0,
+			unknown);
+	if (ret) {
+		fprintf(stderr, "Could not write the output file %s.\n", argv[2]);
+	}
+	fflush(stderr);
+
+	scorerfree(sc);
+	artfree(art);
+
+	return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * Task of the pool: encodes and scores every line of a chunk, SCORE_BLOCK
+ * rows at a time, and formats the predictions in the chunk output buffer.
+ */
+static void scorechunk(void* arg) {
+	ScoreChunk* ch = arg;
+	Scorer* sc = ch->sc;
+	size_t width = sc->width;
+	size_t count = sc->art->count;
+	size_t linemax = sc->labellen + 32;
+
+	char** cells = malloc(sizeof(char*) * sc->split);
+	float* X = malloc(sizeof(float) * width * SCORE_BLOCK);
+	double* scores = malloc(sizeof(double) * count * SCORE_BLOCK);
+
+	ch->outlen = 0;
+	ch->rows = 0;
+	ch->unknown = 0;
+
+	char* text = ch->text;
+	size_t length = ch->length;
+	size_t pos = 0;
+	while (pos < length) {
+
+		//encodes up to SCORE_BLOCK lines, blank lines are kept as blank
+		//predictions so the output lines match the input lines. Their rows
+		//are zeroed so the block is never scored on uninitialized floats.
+		size_t rows = 0;
+		short blanks[SCORE_BLOCK];
+		while (rows < SCORE_BLOCK && pos < length) {
+			char* line = text + pos;
+			char* nl = memchr(line, '\n', length - pos);
+			size_t l = nl ? (size_t) (nl - line) : length - pos;
+			pos += l + 1;
+
+			blanks[rows] = l == 0 || (l == 1 && line[0] == '\r');
+			if (!blanks[rows]) {
+				ch->unknown += scoreenc(sc, line, l, cells, X + rows * width);
+			} else {
+				memset(X + rows * width, 0, sizeof(float) * width);
+			}
+			rows++;
+		}
+
+		scoreblock(sc, X, rows, scores);
+
+		for (size_t i = 0; i < rows; i++) {
+			if (ch->outlen + linemax > ch->outcap) {
+				ch->outcap = ch->outcap * 2 + linemax;
+				ch->out = realloc(ch->out, ch->outcap);
+			}
+
+			if (blanks[i]) {
+				ch->out[ch->outlen++] = '\n';
+			} else {
+				ch->outlen += scorefmt(sc, scores + i * count,
+						ch->out + ch->outlen, ch->outcap - ch->outlen);
+				ch->rows++;
+			}
+		}
+	}
+
+	free(cells);
+	free(X);
+	free(scores);
+}
+
+/*
+ * Fills up to count chunks with whole lines of the input and returns the
+ * number of chunks filled.
+ */
+static size_t scorefill(ScoreInput* in, ScoreChunk* chunks, size_t count) {
+	size_t filled = 0;
+	while (filled < count && scorenext(in, &chunks[filled])) {
+		filled++;
+	}
+
+	return filled;
+}
+
+/*
+ * Reads the next chunk of the input. The partial line at the end of the
+ * chunk is carried over to the next one. Returns 0 when there is nothing
+ * left to read.
+ */
+static short scorenext(ScoreInput* in, ScoreChunk* ch) {
+	if (ch->text == NULL) {
+		ch->cap = SCORE_CHUNK;
+		ch->text = malloc(ch->cap + 1);
+	}
+
+	if (in->carrylen > ch->cap) {
+		ch->cap = in->carrylen * 2;
+		ch->text = realloc(ch->text, ch->cap + 1);
+	}
+
+	memcpy(ch->text, in->carry, in->carrylen);
+	size_t size = in->carrylen;
+	in->carrylen = 0;
+
+	while (1) {
+		if (!in->eof && size < ch->cap) {
+			size_t r = fread(ch->text + size, 1, ch->cap - size, in->f);
+			size += r;
+			if (r == 0) {
+				in->eof = 1;
+			}
+		}
+
+		if (in->eof) {
+			ch->length = size;
+			break;
+		}
+
+		//looks for the last complete line of the chunk.
+		size_t last = size;
+		while (last > 0 && ch->text[last - 1] != '\n') {
+			last--;
+		}
+
+		if (last > 0) {
+			ch->length = last;
+			size_t rest = size - last;
+			if (rest > in->carrycap) {
+				in->carrycap = rest * 2;
+				in->carry = realloc(in->carry, in->carrycap);
+			}
+			memcpy(in->carry, ch->text + last, rest);
+			in->carrylen = rest;
+			break;
+		}
+
+		if (size == ch->cap) {
+			//a single line longer than the chunk.
+			ch->cap *= 2;
+			ch->text = realloc(ch->text, ch->cap + 1);
+		}
+	}
+
+	ch->text[ch->length] = '\0';
+	return ch->length > 0;
+}
+
+static int scorewrite(FILE* out, ScoreChunk* chunks, size_t count) {
+	for (size_t c = 0; c < count; c++) {
+		ScoreChunk* ch = &chunks[c];
+		if (ch->outlen > 0 && fwrite(ch->out, 1, ch->outlen, out) != ch->outlen) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * score.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef SCORE_H_
+#define SCORE_H_
+
+#include "artifact.h"
+
+//number of rows encoded together before calling h for each model.
+#define SCORE_BLOCK 256
+
+/*
+ * Everything needed to turn a raw csv line in to a prediction. A Scorer only
+ * reads from the artifact, so the same Scorer can be shared by any number
+ * of threads as long as each thread uses its own buffers.
+ *
+ * support[k] lists the features of the k-th model whose theta is not 0, in
+ * used[k] of them, or is NULL when most of them are used.
+ */
+typedef struct Scorer{
+	Artifact* art;
+	size_t* offsets;
+	size_t cols;
+	size_t width;
+	size_t split;
+	size_t labellen;
+	size_t** support;
+	size_t* used;
+}Scorer;
+
+Scorer* scorernew(Artifact* art);
+void scorerfree(Scorer* sc);
+size_t scoreenc(Scorer* sc, char* line, size_t length, char** cells, float* x);
+void scoreblock(Scorer* sc, float* X, size_t rows, double* out);
+size_t scorefmt(Scorer* sc, double* scores, char* buf, size_t cap);
+int scoremain(int argc, char** argv);
+
+#endif /* SCORE_H_ */
@@ -0,0 +1,458 @@
+/*
+ * serve.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "utils.h"
+#include "ml.h"
+#include "serve.h"
+
+static volatile sig_atomic_t servestop = 0;
+
+static void servesignal(int sig);
+static void* servebatcher(void* arg);
+static void* serveclient(void* arg);
+static void servebatch(Server* server, ServeRequest** reqs, size_t count,
+		float* X, double* scores, char** cells);
+static short servestat(ServeRequest* req);
+
+/*
+ * Keeps a model loaded and answers prediction requests over a unix domain
+ * socket. Each request is a csv line, in the same format accepted by the
+ * score command, and each answer is the prediction followed by a new line.
+ * Requests from every connection are coalesced in micro batches of up to
+ * <max batch> rows, waiting at most <max wait> microseconds for the batch
+ * to fill up.
+ *
+ *   linfit serve <model file> <socket path> [max batch] [max wait]
+ *
+ * A blank line is answered with a blank line, and a line with missing
+ * columns or unknown values with '#error <n> unknown values'. The line
+ * '#stats' answers the request count and the p50/p99 latency in
+ * microseconds. The same report is printed when the server stops.
+ */
+int servemain(int argc, char** argv) {
+	if (argc < 2 || argc > 4) {
+		fprintf(stderr, "Usage: linfit serve <model file> <socket path> "
+				"[max batch] [max wait]\n");
+		fflush(stderr);
+		return EXIT_FAILURE;
+	}
+
+	size_t batch = argc > 2 ? strtoul(argv[2], NULL, 10) : 64;
+	double wait = (argc > 3 ? strtod(argv[3], NULL) : 200) * 1e-6;
+	if (batch == 0) {
+		batch = 1;
+	}
+
+	Artifact* art = artload(argv[0]);
+	if (art == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	char* path = argv[1];
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "The socket path %s is too long.\n", path);
+		fflush(stderr);
+		artfree(art);
+		return EXIT_FAILURE;
+	}
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(path);
+	if (fd == -1 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) == -1
+			|| listen(fd, 128) == -1) {
+		fprintf(stderr, "Could not listen on %s: %s.\n", path,
+				strerror(errno));
+		fflush(stderr);
+		if (fd != -1) {
+			close(fd);
+		}
+		artfree(art);
+		return EXIT_FAILURE;
+	}
+
+	//no SA_RESTART, so accept returns when the server is asked to stop.
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = servesignal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	Server server;
+	memset(&server, 0, sizeof(Server));
+	server.sc = scorernew(art);
+	server.batch = batch;
+	server.wait = wait;
+	server.latencies = malloc(sizeof(double) * SERVE_SAMPLES);
+	pthread_mutex_init(&server.lock, NULL);
+
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&server.ready, &attr);
+	pthread_condattr_destroy(&attr);
+
+	pthread_t batcher;
+	pthread_create(&batcher, NULL, servebatcher, &server);
+
+	fprintf(stderr, "Serving %s on %s (batch %zu, wait %.0f us).\n", argv[0],
+			path, batch, wait * 1e6);
+	fflush(stderr);
+
+	while (!servestop) {
+		int cfd = accept(fd, NULL, NULL);
+		if (cfd == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "accept failed: %s.\n", strerror(errno));
+			fflush(stderr);
+			break;
+		}
+
+		ServeClient* client = malloc(sizeof(ServeClient));
+		client->fd = cfd;
+		client->server = &server;
+		pthread_cond_init(&client->done, NULL);
+
+		pthread_t t;
+		if (pthread_create(&t, NULL, serveclient, client) != 0) {
+			close(cfd);
+			pthread_cond_destroy(&client->done);
+			free(client);
+			continue;
+		}
+		pthread_detach(t);
+	}
+
+	close(fd);
+	unlink(path);
+
+	pthread_mutex_lock(&server.lock);
+	server.stop = 1;
+	pthread_cond_broadcast(&server.ready);
+	pthread_mutex_unlock(&server.lock);
+	pthread_join(batcher, NULL);
+
+	size_t requests;
+	double p50;
+	double p99;
+	servestats(&server, &requests, &p50, &p99);
+	fprintf(stderr, "requests: %zu  batches: %zu  p50: %.1f us  p99: %.1f us\n",
+			requests, server.batches, p50, p99);
+	fflush(stderr);
+
+	//the client threads may still be blocked reading their sockets, so the
+	//shared state is left to the process exit.
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Reads the request count and computes the p50 and p99 latency, in
+ * microseconds, of the last SERVE_SAMPLES requests. The server lock must
+ * not be held.
+ */
+void servestats(Server* server, size_t* requests, double* p50, double* p99) {
+	pthread_mutex_lock(&server->lock);
+	*requests = server->requests;
+	size_t count = server->samples < SERVE_SAMPLES ?
+			server->samples : SERVE_SAMPLES;
+	double* sorted = malloc(sizeof(double) * (count + 1));
+	memcpy(sorted, server->latencies, sizeof(double) * count);
+	pthread_mutex_unlock(&server->lock);
+
+	if (count == 0) {
+		*p50 = 0;
+		*p99 = 0;
+	} else {
+		qsort(sorted, count, sizeof(double), dcmp);
+		*p50 = sorted[(size_t) ((count - 1) * 0.50)] * 1e6;
+		*p99 = sorted[(size_t) ((count - 1) * 0.99)] * 1e6;
+	}
+
+	free(sorted);
+}
+
+static void servesignal(int sig) {
+	servestop = 1;
+}
+
+/*
+ * Waits for requests and scores them in micro batches. A batch is closed
+ * when it has server->batch requests, or when the oldest request has waited
+ * server->wait seconds.
+ */
+static void* servebatcher(void* arg) {
+	Server* server = arg;
+	Scorer* sc = server->sc;
+	size_t batch = server->batch;
+
+	ServeRequest** reqs = malloc(sizeof(ServeRequest*) * batch);
+	float* X = malloc(sizeof(float) * sc->width * batch);
+	double* scores = malloc(sizeof(double) * sc->art->count * batch);
+	char** cells = malloc(sizeof(char*) * sc->split);
+
+	pthread_mutex_lock(&server->lock);
+	while (1) {
+		while (server->queued == 0 && !server->stop) {
+			pthread_cond_wait(&server->ready, &server->lock);
+		}
+
+		if (server->queued == 0) {
+			break;
+		}
+
+		double deadline = server->head->start + server->wait;
+		while (server->queued < batch && !server->stop) {
+			double left = deadline - wtime();
+			if (left <= 0) {
+				break;
+			}
+
+			struct timespec ts;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			long nsec = ts.tv_nsec + (long) (left * 1e9);
+			ts.tv_sec += nsec / 1000000000L;
+			ts.tv_nsec = nsec % 1000000000L;
+			pthread_cond_timedwait(&server->ready, &server->lock, &ts);
+		}
+
+		size_t count = 0;
+		while (count < batch && server->head) {
+			reqs[count++] = server->head;
+			server->head = server->head->next;
+		}
+		if (server->head == NULL) {
+			server->tail = NULL;
+		}
+		server->queued -= count;
+		pthread_mutex_unlock(&server->lock);
+
+		servebatch(server, reqs, count, X, scores, cells);
+
+		pthread_mutex_lock(&server->lock);
+		double end = wtime();
+		for (size_t i = 0; i < count; i++) {
+			ServeRequest* req = reqs[i];
+			server->latencies[server->samples % SERVE_SAMPLES] = end - req->start;
+			server->samples++;
+			req->done = 1;
+			pthread_cond_broadcast(&req->client->done);
+		}
+		server->requests += count;
+		server->batches++;
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	free(reqs);
+	free(X);
+	free(scores);
+	free(cells);
+	return NULL;
+}
+
+/*
+ * Encodes the requests of a batch in to a single block, so all of them are
+ * scored together by scoreblock. A blank line is answered with a blank line,
+ * and a line with missing columns or values the model does not know is
+ * answered with an error instead of a prediction.
+ */
+static void servebatch(Server* server, ServeRequest** reqs, size_t count,
+		float* X, double* scores, char** cells) {
+	Scorer* sc = server->sc;
+	size_t width = sc->width;
+	size_t models = sc->art->count;
+	size_t outmax = sc->labellen + 32;
+
+	for (size_t i = 0; i < count; i++) {
+		ServeRequest* req = reqs[i];
+		float* x = X + i * width;
+		size_t l = req->length;
+		if (l == 0 || (l == 1 && req->line[0] == '\r')) {
+			memset(x, 0, sizeof(float) * width);
+			req->out[0] = '\n';
+			req->outlen = 1;
+			continue;
+		}
+
+		size_t unknown = scoreenc(sc, req->line, l, cells, x);
+		if (unknown > 0) {
+			req->outlen = snprintf(req->out, outmax,
+					"#error %zu unknown values\n", unknown);
+		}
+	}
+
+	scoreblock(sc, X, count, scores);
+
+	for (size_t i = 0; i < count; i++) {
+		ServeRequest* req = reqs[i];
+		if (req->outlen == 0) {
+			req->outlen = scorefmt(sc, scores + i * models, req->out, outmax);
+		}
+	}
+}
+
+/*
+ * Reads the lines of a connection. All the complete lines available in the
+ * read buffer are queued together, and their answers are written back in
+ * the same order once the batcher has scored them.
+ */
+static void* serveclient(void* arg) {
+	ServeClient* client = arg;
+	Server* server = client->server;
+	Scorer* sc = server->sc;
+	size_t outmax = sc->labellen + 32;
+
+	size_t cap = 64 * 1024;
+	size_t len = 0;
+	char* buf = malloc(cap + 1);
+	size_t rcap = 0;
+	ServeRequest* reqs = NULL;
+	char* answer = NULL;
+	size_t acap = 0;
+
+	while (1) {
+		if (len == cap) {
+			cap *= 2;
+			buf = realloc(buf, cap + 1);
+		}
+
+		ssize_t r = read(client->fd, buf + len, cap - len);
+		if (r <= 0) {
+			break;
+		}
+		len += r;
+
+		//counts the complete lines in the buffer.
+		size_t lines = 0;
+		size_t last = 0;
+		for (size_t i = 0; i < len; i++) {
+			if (buf[i] == '\n') {
+				lines++;
+				last = i + 1;
+			}
+		}
+
+		if (lines == 0) {
+			continue;
+		}
+
+		if (lines > rcap) {
+			rcap = lines * 2;
+			reqs = realloc(reqs, sizeof(ServeRequest) * rcap);
+		}
+
+		if (lines * outmax > acap) {
+			acap = lines * outmax * 2;
+			answer = realloc(answer, acap);
+		}
+
+		double start = wtime();
+		size_t count = 0;
+		size_t pos = 0;
+		while (pos < last) {
+			char* line = buf + pos;
+			char* nl = memchr(line, '\n', last - pos);
+			size_t l = nl - line;
+			pos += l + 1;
+
+			ServeRequest* req = &reqs[count++];
+			req->line = line;
+			req->length = l;
+			req->start = start;
+			req->done = 0;
+			req->client = client;
+			req->next = NULL;
+			req->out = answer + (count - 1) * outmax;
+			req->outlen = 0;
+		}
+
+		//the stats request is answered right away and the rest are queued.
+		pthread_mutex_lock(&server->lock);
+		for (size_t i = 0; i < count; i++) {
+			ServeRequest* req = &reqs[i];
+			if (servestat(req)) {
+				req->done = 1;
+				continue;
+			}
+
+			if (server->tail) {
+				server->tail->next = req;
+			} else {
+				server->head = req;
+			}
+			server->tail = req;
+			server->queued++;
+		}
+		pthread_cond_signal(&server->ready);
+
+		for (size_t i = 0; i < count; i++) {
+			while (!reqs[i].done) {
+				pthread_cond_wait(&client->done, &server->lock);
+			}
+		}
+		pthread_mutex_unlock(&server->lock);
+
+		for (size_t i = 0; i < count; i++) {
+			ServeRequest* req = &reqs[i];
+			if (servestat(req)) {
+				size_t requests;
+				double p50;
+				double p99;
+				servestats(server, &requests, &p50, &p99);
+				req->outlen = snprintf(req->out, outmax,
+						"%zu %.1f %.1f\n", requests, p50, p99);
+			}
+		}
+
+		//answers are written with as few system calls as possible.
+		size_t total = 0;
+		for (size_t i = 0; i < count; i++) {
+			ServeRequest* req = &reqs[i];
+			memmove(answer + total, req->out, req->outlen);
+			total += req->outlen;
+		}
+
+		size_t written = 0;
+		while (written < total) {
+			ssize_t w = write(client->fd, answer + written, total - written);
+			if (w <= 0) {
+				break;
+			}
+			written += w;
+		}
+
+		memmove(buf, buf + last, len - last);
+		len -= last;
+	}
+
+	close(client->fd);
+	pthread_cond_destroy(&client->done);
+	free(client);
+	free(buf);
+	free(reqs);
+	free(answer);
+	return NULL;
+}
+
+static short servestat(ServeRequest* req) {
+	return req->length >= 6 && strncmp(req->line, "#stats", 6) == 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * serve.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef SERVE_H_
+#define SERVE_H_
+
+#include <pthread.h>
+#include "score.h"
+
+//number of latency samples kept for the p50/p99 report.
+#define SERVE_SAMPLES 65536
+
+typedef struct ServeClient{
+	int fd;
+	pthread_cond_t done;
+	struct Server* server;
+}ServeClient;
+
+typedef struct ServeRequest{
+	char* line;
+	size_t length;
+	double start;
+
+	char* out;
+	size_t outlen;
+	short done;
+
+	ServeClient* client;
+	struct ServeRequest* next;
+}ServeRequest;
+
+/*
+ * State shared by the client threads and the batcher thread. Every field
+ * below lock is protected by it.
+ */
+typedef struct Server{
+	Scorer* sc;
+	size_t batch;
+	double wait;
+
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	ServeRequest* head;
+	ServeRequest* tail;
+	size_t queued;
+	short stop;
+
+	double* latencies;
+	size_t samples;
+	size_t requests;
+	size_t batches;
+}Server;
+
+int servemain(int argc, char** argv);
+void servestats(Server* server, size_t* requests, double* p50, double* p99);
+
+#endif /* SERVE_H_ */
@@ -0,0 +1,377 @@
+/*
+ * sketch.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sketch.h"
+#include "mem.h"
+
+//a weighted item of a sketch, used to answer quantile queries.
+typedef struct KllItem{
+	float val;
+	uint64_t weight;
+}KllItem;
+
+static void klllevels(Kll* kll, size_t levels);
+static void kllpush(Kll* kll, size_t h, float val);
+static void kllcompress(Kll* kll);
+static void kllcompact(Kll* kll, size_t h);
+static void fsort(float* vals, size_t n);
+static int kllitemcmp(const void* a, const void* b);
+static uint64_t hllmix(uint64_t hash);
+
+Kll* kllnew(size_t k) {
+	Kll* kll = memcalloc(MEM_INFO, 1, sizeof(Kll));
+	kll->k = k;
+	kll->min = NAN;
+	kll->max = NAN;
+	kll->coin = UINT64_C(0x9e3779b97f4a7c15);
+	klllevels(kll, 1);
+	return kll;
+}
+
+Kll* kllcopy(Kll* kll) {
+	if (kll == NULL) {
+		return NULL;
+	}
+
+	Kll* copy = memalloc(MEM_INFO, sizeof(Kll));
+	*copy = *kll;
+	for (size_t h = 0; h < KLL_LEVELS; h++) {
+		copy->items[h] = NULL;
+		copy->room[h] = 0;
+		if (kll->size[h] > 0) {
+			copy->room[h] = kll->size[h];
+			copy->items[h] = memalloc(MEM_INFO, sizeof(float) * kll->size[h]);
+			memcpy(copy->items[h], kll->items[h], sizeof(float) * kll->size[h]);
+		}
+	}
+
+	return copy;
+}
+
+void kllfree(Kll* kll) {
+	if (kll) {
+		for (size_t h = 0; h < KLL_LEVELS; h++) {
+			memfree(MEM_INFO, kll->items[h]);
+		}
+		memfree(MEM_INFO, kll);
+	}
+}
+
+void klladd(Kll* kll, float val) {
+	if (isnan(val)) {
+		return;
+	}
+
+	kllpush(kll, 0, val);
+	kll->n++;
+	kll->min = kll->n == 1 || val < kll->min ? val : kll->min;
+	kll->max = kll->n == 1 || val > kll->max ? val : kll->max;
+
+	if (kll->held >= kll->capacity) {
+		kllcompress(kll);
+	}
+}
+
+/*
+ * Adds the values summarized by from to into. from is not modified.
+ */
+void kllmerge(Kll* into, Kll* from) {
+	if (from->n == 0) {
+		return;
+	}
+
+	if (from->levels > into->levels) {
+		klllevels(into, from->levels);
+	}
+
+	for (size_t h = 0; h < from->levels; h++) {
+		for (size_t i = 0; i < from->size[h]; i++) {
+			kllpush(into, h, from->items[h][i]);
+		}
+	}
+
+	into->min = into->n == 0 || from->min < into->min ? from->min : into->min;
+	into->max = into->n == 0 || from->max > into->max ? from->max : into->max;
+	into->n += from->n;
+
+	kllcompress(into);
+}
+
+/*
+ * Returns the value at the rank q * n, q in [0, 1], or NAN if the sketch is
+ * empty. The extremes are exact.
+ */
+float kllquantile(Kll* kll, double q) {
+	if (kll->n == 0) {
+		return NAN;
+	}
+
+	if (q <= 0) {
+		return kll->min;
+	}
+
+	if (q >= 1) {
+		return kll->max;
+	}
+
+	size_t total = kll->held;
+	KllItem* items = memalloc(MEM_SCRATCH, sizeof(KllItem) * total);
+	size_t t = 0;
+	uint64_t sum = 0;
+	for (size_t h = 0; h < kll->levels; h++) {
+		for (size_t i = 0; i < kll->size[h]; i++) {
+			items[t].val = kll->items[h][i];
+			items[t].weight = (uint64_t) 1 << h;
+			sum += items[t].weight;
+			t++;
+		}
+	}
+	qsort(items, total, sizeof(KllItem), kllitemcmp);
+
+	double target = q * sum;
+	double cum = 0;
+	float ans = kll->max;
+	for (size_t i = 0; i < total; i++) {
+		cum += items[i].weight;
+		if (cum >= target) {
+			ans = items[i].val;
+			break;
+		}
+	}
+	memfree(MEM_SCRATCH, items);
+
+	return ans;
+}
+
+/*
+ * Sets the number of levels and the capacity of each level. The top level
+ * holds k items, and each level below holds 2/3 of the one above, but never
+ * less than KLL_MIN.
+ */
+static void klllevels(Kll* kll, size_t levels) {
+	kll->levels = levels;
+	kll->capacity = 0;
+
+	double cap = kll->k;
+	for (size_t h = levels; h-- > 0;) {
+		size_t c = (size_t) ceil(cap);
+		kll->cap[h] = c < KLL_MIN ? KLL_MIN : c;
+		kll->capacity += kll->cap[h];
+		cap *= 2.0 / 3.0;
+	}
+}
+
+static void kllpush(Kll* kll, size_t h, float val) {
+	if (kll->size[h] == kll->room[h]) {
+		size_t room = kll->room[h] ? kll->room[h] * 2 : kll->cap[h] + 1;
+		float* items = memalloc(MEM_INFO, sizeof(float) * room);
+		if (kll->size[h] > 0) {
+			memcpy(items, kll->items[h], sizeof(float) * kll->size[h]);
+		}
+		memfree(MEM_INFO, kll->items[h]);
+		kll->items[h] = items;
+		kll->room[h] = room;
+	}
+
+	kll->items[h][kll->size[h]++] = val;
+	kll->held++;
+}
+
+/*
+ * Compacts the lowest full level until the sketch fits its capacity. A new
+ * level is added on top when the top level is the one that is full.
+ */
+static void kllcompress(Kll* kll) {
+	while (kll->held >= kll->capacity) {
+		size_t h = 0;
+		while (h + 1 < kll->levels && kll->size[h] < kll->cap[h]) {
+			h++;
+		}
+
+		if (h + 1 == kll->levels) {
+			if (kll->levels == KLL_LEVELS) {
+				return;
+			}
+			klllevels(kll, kll->levels + 1);
+		}
+
+		kllcompact(kll, h);
+	}
+}
+
+/*
+ * Sorts the level h and moves every other item, starting at a random one of
+ * the first two, to the level h + 1. With an odd number of items, the
+ * largest one stays in h.
+ */
+static void kllcompact(Kll* kll, size_t h) {
+	size_t size = kll->size[h];
+	float* items = kll->items[h];
+	fsort(items, size);
+
+	//xorshift64, the sketch only needs a fair bit per compaction.
+	uint64_t x = kll->coin;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	kll->coin = x;
+	size_t offset = x >> 63;
+
+	size_t pairs = size / 2;
+	for (size_t i = 0; i < pairs; i++) {
+		kllpush(kll, h + 1, items[2 * i + offset]);
+	}
+
+	kll->held -= 2 * pairs;
+	if (size % 2) {
+		items[0] = items[size - 1];
+		kll->size[h] = 1;
+	} else {
+		kll->size[h] = 0;
+	}
+}
+
+/*
+ * Sorts floats that are not NaN. Compactions sort small arrays very often,
+ * so this avoids the call per comparison of qsort.
+ */
+static void fsort(float* vals, size_t n) {
+	while (n > 16) {
+		//median of three, moved to the front as the pivot.
+		size_t mid = n / 2;
+		float a = vals[0];
+		float b = vals[mid];
+		float c = vals[n - 1];
+		size_t p = (a < b) == (b < c) ? mid : (b < a) == (a < c) ? 0 : n - 1;
+		float pivot = vals[p];
+		vals[p] = vals[0];
+		vals[0] = pivot;
+
+		size_t i = 1;
+		size_t j = n - 1;
+		while (1) {
+			while (i <= j && vals[i] < pivot) {
+				i++;
+			}
+			while (j >= i && vals[j] > pivot) {
+				j--;
+			}
+			if (i >= j) {
+				break;
+			}
+			float t = vals[i];
+			vals[i++] = vals[j];
+			vals[j--] = t;
+		}
+		vals[0] = vals[j];
+		vals[j] = pivot;
+
+		//recursion on the smaller side keeps the stack small.
+		if (j < n - j - 1) {
+			fsort(vals, j);
+			vals += j + 1;
+			n -= j + 1;
+		} else {
+			fsort(vals + j + 1, n - j - 1);
+			n = j;
+		}
+	}
+
+	for (size_t i = 1; i < n; i++) {
+		float v = vals[i];
+		size_t k = i;
+		while (k > 0 && vals[k - 1] > v) {
+			vals[k] = vals[k - 1];
+			k--;
+		}
+		vals[k] = v;
+	}
+}
+
+static int kllitemcmp(const void* a, const void* b) {
+	float x = ((const KllItem*) a)->val;
+	float y = ((const KllItem*) b)->val;
+	return (x > y) - (x < y);
+}
+
+Hll* hllnew() {
+	return memcalloc(MEM_INFO, 1, sizeof(Hll));
+}
+
+Hll* hllcopy(Hll* hll) {
+	if (hll == NULL) {
+		return NULL;
+	}
+
+	Hll* copy = memalloc(MEM_INFO, sizeof(Hll));
+	memcpy(copy, hll, sizeof(Hll));
+	return copy;
+}
+
+void hllfree(Hll* hll) {
+	memfree(MEM_INFO, hll);
+}
+
+/*
+ * Adds a value by its 64 bits hash. The hash is mixed again, so hashes
+ * with weak high bits, like FNV-1a, spread over every register.
+ */
+void hlladd(Hll* hll, uint64_t hash) {
+	uint64_t x = hllmix(hash);
+	size_t idx = x >> (64 - HLL_BITS);
+
+	//the bit under the remaining ones bounds the count of zeros.
+	uint64_t rest = (x << HLL_BITS) | ((uint64_t) 1 << (HLL_BITS - 1));
+	uint8_t rank = __builtin_clzll(rest) + 1;
+	if (rank > hll->reg[idx]) {
+		hll->reg[idx] = rank;
+	}
+}
+
+void hllmerge(Hll* into, Hll* from) {
+	for (size_t i = 0; i < HLL_REGS; i++) {
+		if (from->reg[i] > into->reg[i]) {
+			into->reg[i] = from->reg[i];
+		}
+	}
+}
+
+/*
+ * Estimated number of distinct values. Small counts, where many registers
+ * are still empty, are estimated from the empty registers instead, which
+ * is much more precise there.
+ */
+double hllcount(Hll* hll) {
+	double m = HLL_REGS;
+	double sum = 0;
+	size_t zeros = 0;
+	for (size_t i = 0; i < HLL_REGS; i++) {
+		sum += ldexp(1.0, -hll->reg[i]);
+		zeros += hll->reg[i] == 0;
+	}
+
+	double alpha = 0.7213 / (1 + 1.079 / m);
+	double estimate = alpha * m * m / sum;
+	if (estimate <= 2.5 * m && zeros > 0) {
+		estimate = m * log(m / zeros);
+	}
+
+	return estimate;
+}
+
+//finalizer of murmur3.
+static uint64_t hllmix(uint64_t hash) {
+	hash ^= hash >> 33;
+	hash *= UINT64_C(0xff51afd7ed558ccd);
+	hash ^= hash >> 33;
+	hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+	hash ^= hash >> 33;
+	return hash;
+}
@@ -0,0 +1,70 @@
+/*
+ * sketch.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef SKETCH_H_
+#define SKETCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+//accuracy parameter of the quantile sketches, the rank error is about
+//1.7 / KLL_K.
+#define KLL_K 200
+//smallest capacity of a level, and most levels a sketch can have.
+#define KLL_MIN 8
+#define KLL_LEVELS 48
+
+//the distinct count sketches have 2^HLL_BITS registers, about 1.6% error.
+#define HLL_BITS 12
+#define HLL_REGS (1 << HLL_BITS)
+
+/*
+ * KLL quantile sketch of a stream of floats. Level h holds items that stand
+ * for 2^h values each. When the sketch is over its capacity, the lowest
+ * full level is sorted and every other item is promoted to the next level,
+ * so the memory is O(k) whatever the number of values. Two sketches of
+ * different parts of a stream merge in to a sketch of the whole stream.
+ */
+typedef struct Kll{
+	size_t k;
+	uint64_t n;
+	size_t levels;
+	size_t held;
+	size_t capacity;
+	size_t cap[KLL_LEVELS];
+	size_t size[KLL_LEVELS];
+	size_t room[KLL_LEVELS];
+	float* items[KLL_LEVELS];
+	float min;
+	float max;
+	uint64_t coin;
+}Kll;
+
+/*
+ * HyperLogLog distinct count sketch. Each register keeps the longest run
+ * of leading zeros of the hashes that fall in it, and merging two sketches
+ * keeps the largest of each register.
+ */
+typedef struct Hll{
+	uint8_t reg[HLL_REGS];
+}Hll;
+
+Kll* kllnew(size_t k);
+Kll* kllcopy(Kll* kll);
+void kllfree(Kll* kll);
+void klladd(Kll* kll, float val);
+void kllmerge(Kll* into, Kll* from);
+float kllquantile(Kll* kll, double q);
+
+Hll* hllnew();
+Hll* hllcopy(Hll* hll);
+void hllfree(Hll* hll);
+void hlladd(Hll* hll, uint64_t hash);
+void hllmerge(Hll* into, Hll* from);
+double hllcount(Hll* hll);
+
+#endif /* SKETCH_H_ */
@@ -0,0 +1,625 @@
+/*
+ * stream.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <signal.h>
+
+#include "utils.h"
+#include "ml.h"
+#include "mem.h"
+#include "artifact.h"
+#include "stream.h"
+
+static volatile sig_atomic_t streamstop = 0;
+
+static void streamsignal(int sig);
+static void streamgrow(Stream* st, size_t count);
+static void streamtype(Stream* st, StreamCol* col, short type);
+static ssize_t streamword(Stream* st, StreamCol* col, char* val,
+		float* sign);
+static void streamindex(StreamCol* col, size_t room);
+static void streamhash(Stream* st, StreamCol* col);
+static void streamstats(Stream* st, StreamCol* col, char* val);
+static double streamvar(StreamCol* col);
+static size_t streamslots(StreamCol* col);
+
+Stream* streamnew(size_t cols, double alpha, double lambda) {
+	Stream* st = memcalloc(MEM_MODEL, 1, sizeof(Stream));
+	st->cols = cols;
+	st->alpha = alpha;
+	st->lambda = lambda;
+	st->columns = memcalloc(MEM_MODEL, cols, sizeof(StreamCol));
+	st->slot = memcalloc(MEM_SCRATCH, cols, sizeof(size_t));
+	st->fx = memcalloc(MEM_SCRATCH, cols, sizeof(double));
+
+	for (size_t j = 0; j < cols; j++) {
+		StreamCol* col = &st->columns[j];
+		col->type = STREAM_UNKNOWN;
+		col->max = NAN;
+		col->min = NAN;
+		col->discrete = 1;
+	}
+
+	return st;
+}
+
+void streamfree(Stream* st) {
+	if (st) {
+		for (size_t j = 0; j < st->cols; j++) {
+			StreamCol* col = &st->columns[j];
+			for (size_t i = 0; i < col->size; i++) {
+				memfree(MEM_MAPPER, col->vals[i]);
+			}
+			memfree(MEM_MAPPER, col->vals);
+			memfree(MEM_MAPPER, col->index);
+
+			for (size_t k = 0; k < st->count && col->w; k++) {
+				memfree(MEM_MODEL, col->w[k]);
+			}
+			memfree(MEM_MODEL, col->w);
+		}
+
+		memfree(MEM_MODEL, st->columns);
+		memfree(MEM_MODEL, st->bias);
+		memfree(MEM_SCRATCH, st->slot);
+		memfree(MEM_SCRATCH, st->fx);
+		memfree(MEM_MODEL, st);
+	}
+}
+
+/*
+ * Updates the statistics and dictionaries with a row of st->cols cells, and
+ * then takes a single gradient step on every model. The features are
+ * standardized with the statistics seen so far, the same way mtrrow does
+ * with the ones of a GridInfo. Returns 1 when the row was used for
+ * training, or 0 when its number y was missing or the y statistics are not
+ * ready yet. A missing word y is a class of its own, as in the mapper.
+ */
+short streamrow(Stream* st, char** cells) {
+	size_t cols = st->cols;
+	size_t ycol = cols - 1;
+
+	for (size_t j = 0; j < cols; j++) {
+		streamstats(st, &st->columns[j], cells[j]);
+	}
+	st->rows++;
+
+	//the target of the models, or the index of the class.
+	StreamCol* ycl = &st->columns[ycol];
+	char* yval = cells[ycol];
+	double target = 0;
+	ssize_t cls = -1;
+	if (ycl->type == STREAM_WORD) {
+		float sign;
+		cls = streamword(st, ycl, yval, &sign);
+		if (st->count < ycl->size) {
+			streamgrow(st, ycl->size);
+		}
+	} else {
+		double var = streamvar(ycl);
+		if (ycl->type != STREAM_NUMBER || yval == NULL
+				|| numparse(yval, -1, &target) == 0 || !(var > 0)) {
+			st->skipped++;
+			return 0;
+		}
+		target = (target - ycl->mean) / var;
+
+		if (st->count == 0) {
+			streamgrow(st, 1);
+		}
+	}
+
+	//finds the weight used by each column and the value of its feature.
+	for (size_t j = 0; j < ycol; j++) {
+		StreamCol* col = &st->columns[j];
+		char* val = cells[j];
+		double x;
+		if (col->type == STREAM_WORD) {
+			float sign;
+			st->slot[j] = streamword(st, col, val, &sign);
+			st->fx[j] = sign;
+		} else if (val == NULL || numparse(val, -1, &x) == 0) {
+			st->slot[j] = 0;
+			st->fx[j] = 1;
+		} else {
+			double var = streamvar(col);
+			st->slot[j] = 1;
+			st->fx[j] = var > 0 ? (x - col->mean) / var : 0;
+		}
+	}
+
+	double decay = 1 - st->alpha * st->lambda;
+	for (size_t k = 0; k < st->count; k++) {
+		double hk = st->bias[k];
+		for (size_t j = 0; j < ycol; j++) {
+			hk += st->columns[j].w[k][st->slot[j]] * st->fx[j];
+		}
+
+		double yk = cls == -1 ? target : (size_t) cls == k;
+		double err = hk - yk;
+		st->loss += err * err / 2;
+		st->losses++;
+
+		//only the weights of this row are decayed, the others are not
+		//touched by the step.
+		st->bias[k] -= st->alpha * err;
+		for (size_t j = 0; j < ycol; j++) {
+			double* w = &st->columns[j].w[k][st->slot[j]];
+			*w = *w * decay - st->alpha * err * st->fx[j];
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Writes the current state as a model artifact, with the same layout
+ * mtrcreate would produce for a grid with these statistics. The file is
+ * written next to path and renamed, so readers never see half of it.
+ */
+int streamsave(Stream* st, char* path) {
+	size_t cols = st->cols;
+	size_t ycol = cols - 1;
+
+	if (st->count == 0) {
+		fflush(stdout);
+		fprintf(stderr, "Nothing was learned yet, %s was not written.\n",
+				path);
+		fflush(stderr);
+		return -1;
+	}
+
+	GridInfo info;
+	info.max = malloc(sizeof(float) * cols);
+	info.min = malloc(sizeof(float) * cols);
+	info.mean = malloc(sizeof(float) * cols);
+	info.stdev = malloc(sizeof(float) * cols);
+	info.discrete = malloc(sizeof(short) * cols);
+	info.numbers = malloc(sizeof(size_t) * cols);
+	info.words = malloc(sizeof(size_t) * cols);
+	info.missing = malloc(sizeof(size_t) * cols);
+	info.quantiles = NULL;
+	info.distinct = NULL;
+	info.rows = st->rows;
+	info.columns = cols;
+
+	Mapper map;
+	map.cols = cols;
+	map.sizes = malloc(sizeof(size_t) * cols);
+	map.map = malloc(sizeof(char**) * cols);
+	map.buckets = calloc(cols, sizeof(size_t));
+	map.source = NULL;
+	map.width = cols;
+
+	for (size_t j = 0; j < cols; j++) {
+		StreamCol* col = &st->columns[j];
+		short word = col->type == STREAM_WORD;
+		info.max[j] = col->max;
+		info.min[j] = col->min;
+		info.mean[j] = !word && col->n > 0 ? col->mean : NAN;
+		info.stdev[j] = !word ? streamvar(col) : NAN;
+		info.discrete[j] = col->numbers > 0 && col->discrete;
+		info.numbers[j] = col->numbers;
+		info.words[j] = col->words;
+		info.missing[j] = col->missing;
+		map.sizes[j] = word && col->buckets == 0 ? col->size : 0;
+		map.map[j] = word && col->buckets == 0 ? col->vals : NULL;
+		map.buckets[j] = col->buckets;
+	}
+
+	size_t* offsets = mtroffsets(&map, info.missing);
+	size_t xn = offsets[ycol];
+
+	LinearModel** models = malloc(sizeof(LinearModel*) * st->count);
+	for (size_t k = 0; k < st->count; k++) {
+		LinearModel* model = modlinear(xn);
+		model->bias = st->bias[k];
+		for (size_t j = 0; j < ycol; j++) {
+			StreamCol* col = &st->columns[j];
+			double* w = col->w[k];
+			double* theta = model->theta + offsets[j];
+			if (col->buckets) {
+				copyd(theta, w, col->buckets);
+			} else if (col->type == STREAM_WORD) {
+				copyd(theta, w, col->size);
+			} else if (col->missing > 0) {
+				theta[0] = w[0];
+				theta[1] = w[1];
+			} else {
+				theta[0] = w[1];
+			}
+		}
+		models[k] = model;
+	}
+
+	char* tmp = cnew(strlen(path) + 4);
+	strcpy(tmp, path);
+	strcat(tmp, ".tmp");
+
+	int ret = artsave(tmp, &map, &info, NULL, NULL, models, NULL, ENGINE_SGD,
+			0, st->count, 0);
+	if (ret == 0 && rename(tmp, path) != 0) {
+		fflush(stdout);
+		fprintf(stderr, "Could not rename %s: %s.\n", tmp, strerror(errno));
+		fflush(stderr);
+		ret = -1;
+	}
+
+	for (size_t k = 0; k < st->count; k++) {
+		modfree(models[k]);
+	}
+	free(models);
+	free(tmp);
+	free(offsets);
+	free(map.sizes);
+	free(map.map);
+	free(map.buckets);
+	free(info.max);
+	free(info.min);
+	free(info.mean);
+	free(info.stdev);
+	free(info.discrete);
+	free(info.numbers);
+	free(info.words);
+	free(info.missing);
+
+	return ret;
+}
+
+/*
+ * Trains a model from rows read on the standard input, one step per row,
+ * and saves it every N rows and once the input ends (or on SIGINT and
+ * SIGTERM). Memory stays constant no matter how many rows are read.
+ *
+ *   linfit stream <model file> [--every N] [--alpha a] [--lambda l]
+ *
+ * The first row sets the number of columns, and the last column is y. A
+ * word column is hashed once it has more than --hash-above distinct values,
+ * so its weights stay at --buckets per model.
+ */
+int streammain(int argc, char** argv) {
+	if (argc < 1) {
+		fprintf(stderr, "Usage: linfit stream <model file> [--every N] "
+				"[--alpha a] [--lambda l]\n");
+		fflush(stderr);
+		return EXIT_FAILURE;
+	}
+
+	char* path = argv[0];
+	size_t every = 100000;
+	double alpha = 0.01;
+	double lambda = 0;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (strcmp(argv[i], "--every") == 0) {
+			every = strtoul(argv[i + 1], NULL, 10);
+		} else if (strcmp(argv[i], "--alpha") == 0) {
+			alpha = strtod(argv[i + 1], NULL);
+		} else if (strcmp(argv[i], "--lambda") == 0) {
+			lambda = strtod(argv[i + 1], NULL);
+		} else {
+			fprintf(stderr, "Unknown option '%s'.\n", argv[i]);
+			fflush(stderr);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (every == 0) {
+		every = 100000;
+	}
+
+	//no SA_RESTART, so a blocked read returns when asked to stop.
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = streamsignal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	Stream* st = NULL;
+	char** cells = NULL;
+	char* line = NULL;
+	size_t cap = 0;
+	ssize_t l;
+	int ret = EXIT_SUCCESS;
+	double start = wtime();
+	while (!streamstop && (l = getline(&line, &cap, stdin)) != -1) {
+		if (l > 0 && line[l - 1] == '\n') {
+			l--;
+		}
+		if (l == 0) {
+			continue;
+		}
+
+		if (st == NULL) {
+			size_t cols = ccount(line, l, ',') + 1;
+			if (cols < 2) {
+				fprintf(stderr, "Rows need at least 2 columns.\n");
+				fflush(stderr);
+				ret = EXIT_FAILURE;
+				break;
+			}
+			st = streamnew(cols, alpha, lambda);
+			cells = malloc(sizeof(char*) * cols);
+		}
+
+		if (rowsplit(line, l, ',', cells, st->cols) != st->cols) {
+			st->skipped++;
+			continue;
+		}
+
+		streamrow(st, cells);
+
+		if (st->rows % every == 0) {
+			if (streamsave(st, path) == 0) {
+				fprintf(stderr, "%zu rows, %zu skipped, loss %.6f, %.0f rows/s.\n",
+						st->rows, st->skipped,
+						st->losses ? st->loss / st->losses : 0,
+						st->rows / (wtime() - start));
+				fflush(stderr);
+			}
+			st->loss = 0;
+			st->losses = 0;
+		}
+	}
+
+	if (st) {
+		if (streamsave(st, path) != 0) {
+			ret = EXIT_FAILURE;
+		}
+		fprintf(stderr, "Done: %zu rows, %zu skipped, %zu models.\n",
+				st->rows, st->skipped, st->count);
+		fflush(stderr);
+	} else if (ret == EXIT_SUCCESS) {
+		fprintf(stderr, "No rows were read.\n");
+		fflush(stderr);
+		ret = EXIT_FAILURE;
+	}
+
+	free(line);
+	free(cells);
+	streamfree(st);
+	return ret;
+}
+
+static void streamsignal(int sig) {
+	streamstop = 1;
+}
+
+/*
+ * Adds models up to count, with their weights set to 0.
+ */
+static void streamgrow(Stream* st, size_t count) {
+	size_t old = st->count;
+	double* bias = memcalloc(MEM_MODEL, count, sizeof(double));
+	if (st->bias) {
+		copyd(bias, st->bias, old);
+		memfree(MEM_MODEL, st->bias);
+	}
+	st->bias = bias;
+
+	for (size_t j = 0; j < st->cols; j++) {
+		StreamCol* col = &st->columns[j];
+		double** w = memcalloc(MEM_MODEL, count, sizeof(double*));
+		for (size_t k = 0; k < old; k++) {
+			w[k] = col->w[k];
+		}
+		for (size_t k = old; k < count; k++) {
+			w[k] = memcalloc(MEM_MODEL, streamslots(col), sizeof(double));
+		}
+		memfree(MEM_MODEL, col->w);
+		col->w = w;
+	}
+
+	st->count = count;
+}
+
+/*
+ * Sets the type of a column that had only blank values so far. A word
+ * column starts with a blank word when blanks were seen, like struniq.
+ */
+static void streamtype(Stream* st, StreamCol* col, short type) {
+	col->type = type;
+	if (type != STREAM_WORD) {
+		return;
+	}
+
+	//the weights are allocated with the dictionary, by streamword.
+	for (size_t k = 0; k < st->count; k++) {
+		memfree(MEM_MODEL, col->w[k]);
+		col->w[k] = NULL;
+	}
+
+	if (col->missing > 0) {
+		float sign;
+		streamword(st, col, NULL, &sign);
+	}
+}
+
+/*
+ * Returns the index of a word in the dictionary of the column, adding it
+ * (with a weight of 0 in every model) if it was not there. sign is the
+ * value of the feature, which is -1 for some words of a hashed column.
+ */
+static ssize_t streamword(Stream* st, StreamCol* col, char* val,
+		float* sign) {
+	if (col->buckets) {
+		return maphash(val, col->buckets, sign);
+	}
+
+	*sign = 1;
+	size_t mask = col->room - 1;
+	for (size_t h = strhash(val) & mask; col->room && col->index[h];
+			h = (h + 1) & mask) {
+		char* crt = col->vals[col->index[h] - 1];
+		if (crt == val || (crt && val && strcmp(crt, val) == 0)) {
+			return col->index[h] - 1;
+		}
+	}
+
+	//the classes of y are never hashed, each one has its own model.
+	short feature = col != &st->columns[st->cols - 1];
+	if (feature && maphashabove > 0 && col->size == maphashabove) {
+		streamhash(st, col);
+		return maphash(val, col->buckets, sign);
+	}
+
+	size_t size = col->size;
+	if (size == col->cap) {
+		size_t cap = size > 0 ? size * 2 : 4;
+		char** vals = memalloc(MEM_MAPPER, sizeof(char*) * cap);
+		if (size > 0) {
+			memcpy(vals, col->vals, sizeof(char*) * size);
+		}
+		memfree(MEM_MAPPER, col->vals);
+		col->vals = vals;
+
+		for (size_t k = 0; k < st->count; k++) {
+			double* w = memcalloc(MEM_MODEL, cap, sizeof(double));
+			if (size > 0) {
+				copyd(w, col->w[k], size);
+			}
+			memfree(MEM_MODEL, col->w[k]);
+			col->w[k] = w;
+		}
+		col->cap = cap;
+	}
+
+	if (val) {
+		col->vals[size] = memalloc(MEM_MAPPER, strlen(val) + 1);
+		strcpy(col->vals[size], val);
+	} else {
+		col->vals[size] = NULL;
+	}
+	col->size = size + 1;
+
+	//the index is kept at most half full.
+	if (col->size * 2 > col->room) {
+		streamindex(col, col->room > 0 ? col->room * 2 : 16);
+	} else {
+		size_t h = strhash(val) & mask;
+		while (col->index[h]) {
+			h = (h + 1) & mask;
+		}
+		col->index[h] = col->size;
+	}
+
+	return size;
+}
+
+/*
+ * Builds the index of the dictionary again with room slots, a power of 2.
+ */
+static void streamindex(StreamCol* col, size_t room) {
+	memfree(MEM_MAPPER, col->index);
+	col->index = memcalloc(MEM_MAPPER, room, sizeof(size_t));
+	col->room = room;
+
+	size_t mask = room - 1;
+	for (size_t i = 0; i < col->size; i++) {
+		size_t h = strhash(col->vals[i]) & mask;
+		while (col->index[h]) {
+			h = (h + 1) & mask;
+		}
+		col->index[h] = i + 1;
+	}
+}
+
+/*
+ * Turns a word column into a hashed one with mapbuckets weights per model.
+ * The weight of each word is added to its bucket, times its sign, so the
+ * models give the same predictions as long as two words do not share a
+ * bucket. The dictionary is freed.
+ */
+static void streamhash(Stream* st, StreamCol* col) {
+	size_t buckets = mapbuckets;
+	for (size_t k = 0; k < st->count; k++) {
+		double* w = memcalloc(MEM_MODEL, buckets, sizeof(double));
+		for (size_t i = 0; i < col->size; i++) {
+			float sign;
+			size_t idx = maphash(col->vals[i], buckets, &sign);
+			w[idx] += sign * col->w[k][i];
+		}
+		memfree(MEM_MODEL, col->w[k]);
+		col->w[k] = w;
+	}
+
+	for (size_t i = 0; i < col->size; i++) {
+		memfree(MEM_MAPPER, col->vals[i]);
+	}
+	memfree(MEM_MAPPER, col->vals);
+	memfree(MEM_MAPPER, col->index);
+	col->vals = NULL;
+	col->index = NULL;
+	col->size = 0;
+	col->cap = 0;
+	col->room = 0;
+	col->buckets = buckets;
+}
+
+/*
+ * Adds a value to the statistics of its column. Values of a number column
+ * that are not numbers are counted as missing.
+ */
+static void streamstats(Stream* st, StreamCol* col, char* val) {
+	double x = 0;
+	size_t parsed = val ? numparse(val, -1, &x) : 0;
+
+	if (val != NULL && col->type == STREAM_UNKNOWN) {
+		streamtype(st, col, parsed > 0 ? STREAM_NUMBER : STREAM_WORD);
+	}
+
+	if (col->type == STREAM_WORD) {
+		if (val) {
+			col->words++;
+		} else {
+			col->missing++;
+		}
+		float sign;
+		streamword(st, col, val, &sign);
+		return;
+	}
+
+	if (val == NULL || parsed == 0) {
+		col->missing++;
+		return;
+	}
+
+	float num = (float) x;
+	if (ceil(num) != num) {
+		col->discrete = 0;
+	}
+	col->max = higher(col->max, num);
+	col->min = lower(col->min, num);
+	col->numbers++;
+
+	col->n++;
+	double delta = x - col->mean;
+	col->mean += delta / col->n;
+	col->m2 += delta * (x - col->mean);
+}
+
+/*
+ * The value stored as stdev in a GridInfo, see ginfo.
+ */
+static double streamvar(StreamCol* col) {
+	if (col->n < 2) {
+		return NAN;
+	}
+
+	return col->m2 / (col->n - 1);
+}
+
+static size_t streamslots(StreamCol* col) {
+	if (col->buckets) {
+		return col->buckets;
+	}
+
+	return col->type == STREAM_WORD ? col->cap : 2;
+}
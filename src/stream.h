@@ -0,0 +1,76 @@
+/*
+ * stream.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include "utils.h"
+
+#define STREAM_UNKNOWN 0
+#define STREAM_NUMBER 1
+#define STREAM_WORD 2
+
+/*
+ * Running state of a single column. The type is decided by the first value
+ * that is not blank: a number column keeps Welford's mean and m2, and a
+ * word column keeps its dictionary, which grows as new words show up.
+ *
+ * w[k] holds the weights of the k-th model for this column: [missing flag,
+ * value] for a number column, or one weight per word.
+ *
+ * The dictionary has room for cap words, and index finds a word in it by
+ * its strhash, with room slots that hold its position plus one (0 when
+ * empty). Once a feature column goes past maphashabove words it is hashed
+ * like mapcreate does: the dictionary is dropped and w[k] has buckets
+ * weights, one per hash bucket.
+ */
+typedef struct StreamCol{
+	short type;
+	double n;
+	double mean;
+	double m2;
+	float max;
+	float min;
+	short discrete;
+	size_t numbers;
+	size_t words;
+	size_t missing;
+	char** vals;
+	size_t size;
+	size_t cap;
+	size_t* index;
+	size_t room;
+	size_t buckets;
+	double** w;
+}StreamCol;
+
+/*
+ * Model trained one row at a time. Memory depends on the number of columns,
+ * words and classes, never on the number of rows.
+ */
+typedef struct Stream{
+	size_t cols;
+	StreamCol* columns;
+	double* bias;
+	size_t count;
+	size_t rows;
+	size_t skipped;
+	double alpha;
+	double lambda;
+	double loss;
+	size_t losses;
+	size_t* slot;
+	double* fx;
+}Stream;
+
+Stream* streamnew(size_t cols, double alpha, double lambda);
+void streamfree(Stream* st);
+short streamrow(Stream* st, char** cells);
+int streamsave(Stream* st, char* path);
+int streammain(int argc, char** argv);
+
+#endif /* STREAM_H_ */
@@ -0,0 +1,422 @@
+/*
+ * synth.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "utils.h"
+#include "ml.h"
+#include "ui.h"
+#include "synth.h"
+
+#define SCALE_OK 0
+#define SCALE_FAILED 1
+#define SCALE_TIMEOUT 2
+
+static uint64_t synthnext(uint64_t* state);
+static double synthunif(uint64_t* state);
+static double synthgauss(uint64_t* state);
+static void scalerun(char* path, short train, ScalePoint* point, double limit);
+static void scaleprint(ScalePoint* point, ScalePoint* first, SynthSpec* spec);
+
+void synthdefault(SynthSpec* spec) {
+	spec->rows = 10000;
+	spec->numeric = 8;
+	spec->categorical = 2;
+	spec->cardinality = 10;
+	spec->missing = 0;
+	spec->classes = 0;
+	spec->seed = 1;
+}
+
+/*
+ * Parses the option at argv[*i] in to spec, consuming its value. Returns 0
+ * when the option is not a dataset option.
+ */
+short synthopt(SynthSpec* spec, int argc, char** argv, int* i) {
+	char* opt = argv[*i];
+	if (*i + 1 >= argc) {
+		return 0;
+	}
+
+	char* val = argv[*i + 1];
+	if (strcmp(opt, "--rows") == 0) {
+		spec->rows = strtoul(val, NULL, 10);
+	} else if (strcmp(opt, "--numeric") == 0) {
+		spec->numeric = strtoul(val, NULL, 10);
+	} else if (strcmp(opt, "--categorical") == 0) {
+		spec->categorical = strtoul(val, NULL, 10);
+	} else if (strcmp(opt, "--cardinality") == 0) {
+		spec->cardinality = strtoul(val, NULL, 10);
+	} else if (strcmp(opt, "--missing") == 0) {
+		spec->missing = strtod(val, NULL);
+	} else if (strcmp(opt, "--classes") == 0) {
+		spec->classes = strtoul(val, NULL, 10);
+	} else if (strcmp(opt, "--seed") == 0) {
+		spec->seed = strtoull(val, NULL, 10);
+	} else {
+		return 0;
+	}
+
+	(*i)++;
+	return 1;
+}
+
+/*
+ * Writes a synthetic csv file. y is a fixed linear function of the numeric
+ * columns plus an effect per category and some noise, so the models have
+ * something to learn. Missing values are written as blank cells, except in
+ * the y column. The same spec always produces the same file.
+ */
+int synthwrite(char* path, SynthSpec* spec) {
+	FILE* f = fopen(path, "w");
+	if (f == NULL) {
+		fprintf(stderr, "Could not open %s for writing.\n", path);
+		fflush(stderr);
+		return -1;
+	}
+
+	size_t card = spec->cardinality > 0 ? spec->cardinality : 1;
+	uint64_t state = spec->seed;
+
+	double* weights = malloc(sizeof(double) * (spec->numeric + 1));
+	double* means = malloc(sizeof(double) * (spec->numeric + 1));
+	double* scales = malloc(sizeof(double) * (spec->numeric + 1));
+	for (size_t j = 0; j < spec->numeric; j++) {
+		weights[j] = synthgauss(&state);
+		means[j] = synthunif(&state) * 100 - 50;
+		scales[j] = 0.5 + synthunif(&state) * 20;
+	}
+
+	double* effects = malloc(sizeof(double) * (spec->categorical * card + 1));
+	for (size_t k = 0; k < spec->categorical * card; k++) {
+		effects[k] = synthgauss(&state);
+	}
+
+	double spread = sqrt(spec->numeric + spec->categorical + 1.0);
+
+	for (size_t i = 0; i < spec->rows; i++) {
+		double score = 0;
+		for (size_t j = 0; j < spec->numeric; j++) {
+			double z = synthgauss(&state);
+			score += weights[j] * z;
+			if (synthunif(&state) >= spec->missing) {
+				fprintf(f, "%.4f", means[j] + z * scales[j]);
+			}
+			fputc(',', f);
+		}
+
+		for (size_t j = 0; j < spec->categorical; j++) {
+			size_t k = synthnext(&state) % card;
+			score += effects[j * card + k];
+			if (synthunif(&state) >= spec->missing) {
+				fprintf(f, "c%zuv%zu", j, k);
+			}
+			fputc(',', f);
+		}
+
+		score += synthgauss(&state) * 0.1;
+		if (spec->classes > 0) {
+			double t = (tanh(score / spread) + 1) / 2;
+			size_t c = (size_t) (t * spec->classes);
+			if (c >= spec->classes) {
+				c = spec->classes - 1;
+			}
+			fprintf(f, "class%zu", c);
+		} else {
+			fprintf(f, "%.4f", score);
+		}
+
+		//gcreate does not accept a new line at the end of the file.
+		if (i + 1 < spec->rows) {
+			fputc('\n', f);
+		}
+	}
+
+	free(weights);
+	free(means);
+	free(scales);
+	free(effects);
+
+	if (fclose(f) != 0) {
+		fprintf(stderr, "Could not write %s.\n", path);
+		fflush(stderr);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Writes a single synthetic dataset.
+ *
+ *   linfit synth <output file> [--rows N] [--numeric N] [--categorical N]
+ *       [--cardinality N] [--missing rate] [--classes N] [--seed N]
+ */
+int synthmain(int argc, char** argv) {
+	SynthSpec spec;
+	synthdefault(&spec);
+
+	char* path = NULL;
+	for (int i = 0; i < argc; i++) {
+		if (synthopt(&spec, argc, argv, &i)) {
+			continue;
+		}
+
+		if (argv[i][0] == '-' || path) {
+			fprintf(stderr, "Unknown option '%s'.\n", argv[i]);
+			fflush(stderr);
+			return EXIT_FAILURE;
+		}
+		path = argv[i];
+	}
+
+	if (path == NULL) {
+		fprintf(stderr, "Usage: linfit synth <output file> [--rows N] "
+				"[--numeric N] [--categorical N] [--cardinality N] "
+				"[--missing rate] [--classes N] [--seed N]\n");
+		fflush(stderr);
+		return EXIT_FAILURE;
+	}
+
+	return synthwrite(path, &spec) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * Generates a synthetic dataset for each size of a sweep and runs the full
+ * dataload + trainstep pipeline over it, in a child process so the peak RSS
+ * of each size is measured on its own. Prints one JSON line per size, where
+ * 'efficiency' is the rows/s of the size relative to the first one: values
+ * well below 1 show where the pipeline stops scaling linearly.
+ *
+ *   linfit scale [--sizes 1000,10000,...] [--no-train] [--limit seconds]
+ *       [--dir path] [dataset options of synth]
+ *
+ * When a size takes longer than --limit seconds it is stopped, and the
+ * larger sizes are skipped.
+ */
+int scalemain(int argc, char** argv) {
+	SynthSpec spec;
+	synthdefault(&spec);
+
+	char* sizes = "1000,10000,100000,1000000";
+	char* dir = "/tmp";
+	short train = 1;
+	double limit = 600;
+
+	for (int i = 0; i < argc; i++) {
+		if (synthopt(&spec, argc, argv, &i)) {
+			continue;
+		}
+
+		if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+			sizes = argv[++i];
+		} else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+			dir = argv[++i];
+		} else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+			limit = strtod(argv[++i], NULL);
+		} else if (strcmp(argv[i], "--no-train") == 0) {
+			train = 0;
+		} else {
+			fprintf(stderr, "Unknown option '%s'.\n", argv[i]);
+			fflush(stderr);
+			return EXIT_FAILURE;
+		}
+	}
+
+	char* path = cnew(strlen(dir) + 64);
+	sprintf(path, "%s/linfit-scale-%ld.data", dir, (long) getpid());
+
+	ScalePoint first;
+	memset(&first, 0, sizeof(ScalePoint));
+	int ret = EXIT_SUCCESS;
+
+	char* p = sizes;
+	while (*p) {
+		char* end;
+		spec.rows = strtoul(p, &end, 10);
+		if (end == p) {
+			break;
+		}
+		p = *end == ',' ? end + 1 : end;
+
+		ScalePoint point;
+		memset(&point, 0, sizeof(ScalePoint));
+		point.rows = spec.rows;
+
+		double start = wtime();
+		if (synthwrite(path, &spec) != 0) {
+			ret = EXIT_FAILURE;
+			break;
+		}
+		point.gensec = wtime() - start;
+
+		scalerun(path, train, &point, limit);
+		unlink(path);
+
+		if (first.rows == 0 && point.status == SCALE_OK) {
+			first = point;
+		}
+		scaleprint(&point, &first, &spec);
+
+		if (point.status != SCALE_OK) {
+			ret = EXIT_FAILURE;
+			break;
+		}
+	}
+
+	free(path);
+	return ret;
+}
+
+/*
+ * Runs the pipeline over the file in a child process. The child sends its
+ * timings through a pipe, and the peak RSS comes from wait4.
+ */
+static void scalerun(char* path, short train, ScalePoint* point, double limit) {
+	FILE* f = fopen(path, "r");
+	if (f) {
+		fseek(f, 0, SEEK_END);
+		point->bytes = ftell(f);
+		fclose(f);
+	}
+
+	int fds[2];
+	if (pipe(fds) == -1) {
+		point->status = SCALE_FAILED;
+		return;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+	pid_t pid = fork();
+	if (pid == -1) {
+		close(fds[0]);
+		close(fds[1]);
+		point->status = SCALE_FAILED;
+		return;
+	}
+
+	if (pid == 0) {
+		close(fds[0]);
+		double times[2] = { 0, 0 };
+
+		double start = wtime();
+		Data* data = dataload(path, 0);
+		times[0] = wtime() - start;
+		if (data == NULL || data->matrix == NULL) {
+			_exit(1);
+		}
+
+		if (train) {
+			start = wtime();
+			trainstep(data);
+			times[1] = wtime() - start;
+		}
+
+		if (write(fds[1], times, sizeof(times)) != sizeof(times)) {
+			_exit(1);
+		}
+		_exit(0);
+	}
+
+	close(fds[1]);
+
+	int status = 0;
+	struct rusage usage;
+	memset(&usage, 0, sizeof(usage));
+	double start = wtime();
+	while (1) {
+		pid_t r = wait4(pid, &status, WNOHANG, &usage);
+		if (r == pid) {
+			break;
+		}
+
+		if (r == -1 || wtime() - start > limit) {
+			kill(pid, SIGKILL);
+			wait4(pid, &status, 0, &usage);
+			point->status = SCALE_TIMEOUT;
+			break;
+		}
+
+		usleep(10000);
+	}
+
+	double times[2];
+	if (point->status == SCALE_OK) {
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0
+				&& read(fds[0], times, sizeof(times)) == sizeof(times)) {
+			point->loadsec = times[0];
+			point->trainsec = times[1];
+		} else {
+			point->status = SCALE_FAILED;
+		}
+	}
+	close(fds[0]);
+
+	//ru_maxrss is in kilobytes on linux.
+	point->peakkb = usage.ru_maxrss;
+}
+
+static void scaleprint(ScalePoint* point, ScalePoint* first, SynthSpec* spec) {
+	static char* names[] = { "ok", "failed", "timeout" };
+
+	double total = point->loadsec + point->trainsec;
+	double rate = total > 0 ? point->rows / total : 0;
+	double firstTotal = first->loadsec + first->trainsec;
+	double firstRate = firstTotal > 0 ? first->rows / firstTotal : 0;
+
+	printf("{\"rows\":%zu,\"numeric\":%zu,\"categorical\":%zu,"
+			"\"cardinality\":%zu,\"status\":\"%s\",\"bytes\":", point->rows,
+			spec->numeric, spec->categorical, spec->cardinality,
+			names[point->status]);
+	fjsonnum(stdout, point->bytes);
+	printf(",\"gen_s\":");
+	fjsonnum(stdout, point->gensec);
+	printf(",\"load_s\":");
+	fjsonnum(stdout, point->loadsec);
+	printf(",\"train_s\":");
+	fjsonnum(stdout, point->trainsec);
+	printf(",\"peak_rss_kb\":%ld,\"rows_s\":", point->peakkb);
+	fjsonnum(stdout, rate);
+	printf(",\"mb_s\":");
+	fjsonnum(stdout, total > 0 ? point->bytes / total / 1e6 : 0);
+	printf(",\"efficiency\":");
+	fjsonnum(stdout, firstRate > 0 && rate > 0 ? rate / firstRate : NAN);
+	printf("}\n");
+	flush();
+}
+
+/*
+ * splitmix64: small and good enough for test data.
+ */
+static uint64_t synthnext(uint64_t* state) {
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static double synthunif(uint64_t* state) {
+	return (synthnext(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double synthgauss(uint64_t* state) {
+	double u = synthunif(state);
+	double v = synthunif(state);
+	if (u < 1e-300) {
+		u = 1e-300;
+	}
+	return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
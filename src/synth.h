@@ -0,0 +1,47 @@
+/*
+ * synth.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef SYNTH_H_
+#define SYNTH_H_
+
+#include <stdint.h>
+
+/*
+ * Shape of a synthetic dataset. The numeric columns come first, then the
+ * categorical ones, and the last column is y: a number when classes is 0,
+ * or one of 'classes' words otherwise.
+ */
+typedef struct SynthSpec{
+	size_t rows;
+	size_t numeric;
+	size_t categorical;
+	size_t cardinality;
+	double missing;
+	size_t classes;
+	uint64_t seed;
+}SynthSpec;
+
+/*
+ * Result of running the pipeline over a single size of the sweep.
+ */
+typedef struct ScalePoint{
+	size_t rows;
+	double bytes;
+	double gensec;
+	double loadsec;
+	double trainsec;
+	long peakkb;
+	short status;
+}ScalePoint;
+
+void synthdefault(SynthSpec* spec);
+short synthopt(SynthSpec* spec, int argc, char** argv, int* i);
+int synthwrite(char* path, SynthSpec* spec);
+int synthmain(int argc, char** argv);
+int scalemain(int argc, char** argv);
+
+#endif /* SYNTH_H_ */
@@ -0,0 +1,185 @@
+/*
+ * telem.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "utils.h"
+#include "telem.h"
+
+Telemetry telem;
+
+static __thread int telemtid = -1;
+
+static void* telemdrain(void* arg);
+static size_t telemflush();
+static void telemwrite(TelemRecord* rec);
+
+/*
+ * Preallocates the ring buffer and starts the thread that writes the
+ * records to path, one JSON object per line.
+ */
+int telemopen(char* path) {
+	FILE* f = fopen(path, "w");
+	if (f == NULL) {
+		fflush(stdout);
+		fprintf(stderr, "Could not open %s for writing.\n", path);
+		fflush(stderr);
+		return -1;
+	}
+
+	telem.slots = malloc(sizeof(TelemSlot) * TELEM_SLOTS);
+	for (uint64_t i = 0; i < TELEM_SLOTS; i++) {
+		telem.slots[i].seq = i;
+	}
+
+	telem.file = f;
+	telem.head = 0;
+	telem.tail = 0;
+	telem.dropped = 0;
+	telem.written = 0;
+	telem.threads = 0;
+	telem.stop = 0;
+	telem.origin = wtime();
+	pthread_create(&telem.drainer, NULL, telemdrain, NULL);
+	telem.on = 1;
+
+	return 0;
+}
+
+/*
+ * Stops recording, writes whatever is left in the ring and closes the file.
+ */
+void telemclose() {
+	if (!telem.on) {
+		return;
+	}
+
+	telem.on = 0;
+	__atomic_store_n(&telem.stop, 1, __ATOMIC_RELEASE);
+	pthread_join(telem.drainer, NULL);
+	telemflush();
+	fclose(telem.file);
+	free(telem.slots);
+	telem.slots = NULL;
+
+	if (telem.dropped > 0) {
+		fflush(stdout);
+		fprintf(stderr, "Telemetry: %llu records written, %llu dropped.\n",
+				(unsigned long long) telem.written,
+				(unsigned long long) telem.dropped);
+		fflush(stderr);
+	}
+}
+
+/*
+ * Copies the record into the ring. The elapsed time and the thread id are
+ * filled in here. Never blocks, and does nothing until telemopen is called.
+ */
+void telemrecord(TelemRecord* rec) {
+	if (!telem.on) {
+		return;
+	}
+
+	if (telemtid == -1) {
+		telemtid = __sync_fetch_and_add(&telem.threads, 1);
+	}
+
+	uint64_t pos = __atomic_load_n(&telem.tail, __ATOMIC_RELAXED);
+	TelemSlot* slot;
+	for (;;) {
+		slot = &telem.slots[pos & (TELEM_SLOTS - 1)];
+		uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		int64_t diff = (int64_t) (seq - pos);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&telem.tail, &pos, pos + 1, 1,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (diff < 0) {
+			//full, the drainer is behind.
+			__sync_fetch_and_add(&telem.dropped, 1);
+			return;
+		} else {
+			pos = __atomic_load_n(&telem.tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->rec = *rec;
+	slot->rec.tid = telemtid;
+	slot->rec.elapsed = wtime() - telem.origin;
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+static void* telemdrain(void* arg) {
+	struct timespec pause;
+	pause.tv_sec = 0;
+	pause.tv_nsec = 2000000;
+
+	while (!__atomic_load_n(&telem.stop, __ATOMIC_ACQUIRE)) {
+		if (telemflush() == 0) {
+			nanosleep(&pause, NULL);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Writes every published record, in order. Only the drain thread, or
+ * telemclose once it has joined it, calls this.
+ */
+static size_t telemflush() {
+	size_t count = 0;
+	for (;;) {
+		uint64_t pos = telem.head;
+		TelemSlot* slot = &telem.slots[pos & (TELEM_SLOTS - 1)];
+		uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq != pos + 1) {
+			break;
+		}
+
+		telemwrite(&slot->rec);
+		__atomic_store_n(&slot->seq, pos + TELEM_SLOTS, __ATOMIC_RELEASE);
+		telem.head = pos + 1;
+		count++;
+	}
+
+	if (count > 0) {
+		telem.written += count;
+		fflush(telem.file);
+	}
+
+	return count;
+}
+
+static void telemwrite(TelemRecord* rec) {
+	FILE* f = telem.file;
+	fprintf(f, "{\"kind\":\"%s\",\"tid\":%d,\"t\":",
+			rec->kind == TELEM_EPOCH ? "epoch" : "lambda", rec->tid);
+	fjsonnum(f, rec->elapsed);
+	fputs(",\"lambda\":", f);
+	fjsonnum(f, rec->lambda);
+	if (rec->kind == TELEM_EPOCH) {
+		fprintf(f, ",\"epoch\":%d,\"accepted\":%d", rec->epoch, rec->accepted);
+	}
+	fputs(",\"loss\":", f);
+	fjsonnum(f, rec->loss);
+	if (rec->kind == TELEM_EPOCH) {
+		fputs(",\"alpha\":", f);
+		fjsonnum(f, rec->alpha);
+		fputs(",\"grad\":", f);
+		fjsonnum(f, rec->grad);
+	} else {
+		fputs(",\"test\":", f);
+		fjsonnum(f, rec->test);
+		fprintf(f, ",\"accepted\":%d", rec->accepted);
+	}
+	fputs("}\n", f);
+}
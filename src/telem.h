@@ -0,0 +1,69 @@
+/*
+ * telem.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef TELEM_H_
+#define TELEM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+//must be a power of two.
+#define TELEM_SLOTS 8192
+
+#define TELEM_EPOCH 0
+#define TELEM_LAMBDA 1
+
+/*
+ * A single point of a convergence curve. Epoch records come from
+ * autostogdcent, or from each iteration of lbfgs, and lambda records from
+ * train once the model of a lambda was evaluated on the test rows.
+ */
+typedef struct TelemRecord{
+	short kind;
+	int tid;
+	int epoch;
+	short accepted;
+	double elapsed;
+	double lambda;
+	double loss;
+	double test;
+	double alpha;
+	double grad;
+}TelemRecord;
+
+typedef struct TelemSlot{
+	uint64_t seq;
+	TelemRecord rec;
+}TelemSlot;
+
+/*
+ * Bounded multi-producer ring buffer, drained to a file by a background
+ * thread. Producers never block: when the ring is full the record is
+ * dropped and counted.
+ */
+typedef struct Telemetry{
+	short on;
+	short stop;
+	double origin;
+	TelemSlot* slots;
+	uint64_t head;
+	uint64_t tail;
+	uint64_t dropped;
+	uint64_t written;
+	int threads;
+	FILE* file;
+	pthread_t drainer;
+}Telemetry;
+
+extern Telemetry telem;
+
+int telemopen(char* path);
+void telemclose();
+void telemrecord(TelemRecord* rec);
+
+#endif /* TELEM_H_ */
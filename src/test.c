@@ -0,0 +1,1320 @@
+/*
+ * test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "ml.h"
+#include "ui.h"
+#include "artifact.h"
+#include "rng.h"
+#include "quant.h"
+#include "score.h"
+#include "refresh.h"
+#include "sketch.h"
+#include "lbfgs.h"
+#include "enet.h"
+#include "test.h"
+
+/*
+ * Fails the running test when cond does not hold, printing where.
+ */
+#define TEST(cond) do { \
+	if (!(cond)) { \
+		fflush(stdout); \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		fflush(stderr); \
+		return 1; \
+	} \
+} while (0)
+
+//rounds a section of an artifact up to its 8 bytes boundary.
+#define TEST_PAD(b) (((b) + 7) & ~(size_t) 7)
+
+/*
+ * A behavior test, which returns 0 when it passes.
+ */
+typedef struct TestCase{
+	char* name;
+	int (*fn)();
+}TestCase;
+
+static int testartifact();
+static int testquant();
+static int testnumparse();
+static int testrefresh();
+static int testhash();
+static int testexpand();
+static int testsketch();
+static int testsample();
+static int testproject();
+static int testprune();
+static int testdedup();
+static int testsparse();
+static int testlbfgs();
+static int testcd();
+
+static TestCase tests[] = {
+	{ "artifact", testartifact },
+	{ "quant", testquant },
+	{ "numparse", testnumparse },
+	{ "refresh", testrefresh },
+	{ "hash", testhash },
+	{ "expand", testexpand },
+	{ "sketch", testsketch },
+	{ "sample", testsample },
+	{ "project", testproject },
+	{ "prune", testprune },
+	{ "dedup", testdedup },
+	{ "sparse", testsparse },
+	{ "lbfgs", testlbfgs },
+	{ "cd", testcd },
+};
+
+static char* testfile(char* text);
+static int testwrite(char* path, char* bytes, size_t size);
+static char* testread(char* path, size_t* size);
+static double testmse(char* path, char* text);
+static int testscores(Data* data, char* text, char* path);
+static int testsolve(double* A, double* b, size_t n);
+
+/*
+ * Runs the behavior tests of the program, or only the ones named, and
+ * prints the result of each one.
+ *
+ *   linfit test [names...]
+ *
+ * The exit status is 1 when any test failed.
+ */
+int testmain(int argc, char** argv) {
+	size_t count = sizeof(tests) / sizeof(TestCase);
+	size_t run = 0;
+	size_t failed = 0;
+
+	rnginit(1, 0);
+	for (size_t t = 0; t < count; t++) {
+		short chosen = argc == 0;
+		for (int i = 0; i < argc && !chosen; i++) {
+			chosen = strcmp(argv[i], tests[t].name) == 0;
+		}
+
+		if (!chosen) {
+			continue;
+		}
+
+		double start = wtime();
+		int ret = tests[t].fn();
+		printf("%-4s %-12s %8.3f s\n", ret ? "FAIL" : "ok", tests[t].name,
+				wtime() - start);
+		fflush(stdout);
+		run++;
+		failed += ret != 0;
+	}
+
+	if (run == 0) {
+		fprintf(stderr, "No test matches the given names.\n");
+		fflush(stderr);
+		return EXIT_FAILURE;
+	}
+
+	printf("%zu tests, %zu failed.\n", run, failed);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*
+ * A saved model loads back with the same parameters, words and
+ * standardization, and a file whose word offsets or word blob were
+ * corrupted is rejected instead of read out of bounds.
+ */
+static int testartifact() {
+	char* csv = testfile("1.5,red,a\n2.0,blue,b\n0.5,red,a\n3.5,green,b\n"
+			"1.0,blue,a\n2.5,green,b\n0.0,red,a\n4.0,blue,b\n"
+			"3.0,red,b\n0.5,green,a\n2.0,blue,a\n1.5,green,b");
+	char* path = testfile("");
+	TEST(csv && path);
+
+	Data* data = dataload(csv, 0);
+	TEST(data);
+	dataalloc(data);
+	size_t xn = dataxn(data);
+	for (size_t k = 0; k < data->count; k++) {
+		data->models[k] = modlinear(xn);
+		data->models[k]->bias = k + 0.5;
+		for (size_t i = 0; i < xn; i++) {
+			data->models[k]->theta[i] = (double) i / (k + 1) - 1;
+		}
+	}
+	double* lambdas = datalambdas(data);
+	TEST(artsave(path, data->map, data->info, data->expand, data->prune,
+			data->models, lambdas, ENGINE_CD, 0.5, data->count, 0) == 0);
+
+	Artifact* art = artload(path);
+	TEST(art);
+	TEST(art->count == data->count && art->xn == xn);
+	TEST(art->engine == ENGINE_CD && art->mix == 0.5);
+	for (size_t k = 0; k < art->count; k++) {
+		TEST(art->models[k]->bias == data->models[k]->bias);
+		for (size_t i = 0; i < xn; i++) {
+			TEST(art->models[k]->theta[i] == data->models[k]->theta[i]);
+		}
+	}
+
+	size_t cols = art->map->cols;
+	size_t strings = 0;
+	for (size_t j = 0; j < cols; j++) {
+		TEST(memcmp(art->info->mean + j, data->info->mean + j,
+				sizeof(float)) == 0);
+		TEST(memcmp(art->info->stdev + j, data->info->stdev + j,
+				sizeof(float)) == 0);
+		TEST(art->map->sizes[j] == data->map->sizes[j]);
+		if (art->map->map[j]) {
+			for (size_t i = 0; i < art->map->sizes[j]; i++) {
+				TEST(strcmp(art->map->map[j][i], data->map->map[j][i]) == 0);
+			}
+			strings += art->map->sizes[j];
+		}
+	}
+	TEST(strings > 0);
+
+	//the word offsets follow the lambdas, and the words follow them.
+	size_t pos = TEST_PAD((char*) (art->lambdas + art->count)
+			- (char*) art->base);
+	size_t blob = pos + TEST_PAD(sizeof(uint64_t) * strings);
+	artfree(art);
+
+	size_t size;
+	char* bytes = testread(path, &size);
+	TEST(bytes);
+	ArtHeader* header = (ArtHeader*) bytes;
+	TEST(header->strings == strings && blob + header->strbytes <= size);
+
+	uint64_t saved;
+	memcpy(&saved, bytes + pos, sizeof(uint64_t));
+	uint64_t bad = header->strbytes + 1000;
+	memcpy(bytes + pos, &bad, sizeof(uint64_t));
+	TEST(testwrite(path, bytes, size) == 0);
+	TEST(artload(path) == NULL);
+
+	memcpy(bytes + pos, &saved, sizeof(uint64_t));
+	bytes[blob + header->strbytes - 1] = 'x';
+	TEST(testwrite(path, bytes, size) == 0);
+	TEST(artload(path) == NULL);
+
+	//a missing flag on the first column widens the encoded rows by one,
+	//past the features of the models.
+	bytes[blob + header->strbytes - 1] = '\0';
+	size_t missing = TEST_PAD(sizeof(ArtHeader)) + 4 * TEST_PAD(sizeof(float)
+			* cols) + TEST_PAD(sizeof(short) * cols) + 2 * TEST_PAD(
+			sizeof(uint64_t) * cols);
+	uint64_t one = 1;
+	memcpy(bytes + missing, &one, sizeof(uint64_t));
+	TEST(testwrite(path, bytes, size) == 0);
+	TEST(artload(path) == NULL);
+
+	free(bytes);
+	free(lambdas);
+	datafree(data);
+	unlink(csv);
+	unlink(path);
+	free(csv);
+	free(path);
+	return 0;
+}
+
+/*
+ * Every half and bfloat16 value converts back to itself, floats come back
+ * within half a unit of the last place, and int8 columns come back within
+ * half a step, with 0/1 and constant columns exact.
+ */
+static int testquant() {
+	for (uint32_t v = 0; v < 0x10000; v++) {
+		float h = fromfp16(v);
+		float b = frombf16(v);
+		TEST(isnan(h) || tofp16(h) == v);
+		TEST(isnan(b) || tobf16(b) == v);
+	}
+
+	Rng* rng = rngthread();
+	for (int i = 0; i < 100000; i++) {
+		float x = (rngunit(rng) * 2 - 1) * ldexp(1, (int) rngbelow(rng, 30) - 12);
+		float b = frombf16(tobf16(x));
+		float h = fromfp16(tofp16(x));
+		TEST(fabsf(b - x) <= fabsf(x) * 0x1p-8f);
+		TEST(fabsf(x) < 0x1p-14f || fabsf(x) > 65504
+				|| fabsf(h - x) <= fabsf(x) * 0x1p-11f);
+	}
+	TEST(isinf(fromfp16(tofp16(1e6f))) && fromfp16(tofp16(-0.0f)) == 0);
+
+	size_t m = 200;
+	size_t n = 4;
+	Matrix* X = mtrnew(m, n);
+	for (size_t i = 0; i < m; i++) {
+		float* x = X->values + i * n;
+		x[0] = rngunit(rng) * 6 - 3;
+		x[1] = rngbelow(rng, 2);
+		x[2] = 2.5f;
+		x[3] = rngunit(rng) * 4000;
+	}
+
+	short types[] = { MTR_BF16, MTR_FP16, MTR_INT8 };
+	float* row = malloc(sizeof(float) * n);
+	for (size_t t = 0; t < 3; t++) {
+		Matrix* P = mtrpack(X, 0, m, types[t]);
+		TEST(P && P->type == types[t] && P->values == NULL);
+
+		for (size_t i = 0; i < m; i++) {
+			float* x = X->values + i * n;
+			float* p = mtrload(P, i, row);
+			TEST(p[1] == x[1] && p[2] == x[2]);
+			for (size_t j = 0; j < n; j++) {
+				if (types[t] == MTR_BF16) {
+					TEST(p[j] == frombf16(tobf16(x[j])));
+				} else if (types[t] == MTR_FP16) {
+					TEST(p[j] == fromfp16(tofp16(x[j])));
+				} else {
+					TEST(fabsf(p[j] - x[j]) <= P->scale[j] * 0.5001f);
+				}
+			}
+		}
+		mtrfree(P);
+	}
+
+	free(row);
+	mtrfree(X);
+	return 0;
+}
+
+/*
+ * numparse reads the same value as strtod, to the last bit, and uses the
+ * same number of chars, whether it takes the fast path or falls back.
+ */
+static int testnumparse() {
+	//the fast path, the strtod fallback and the edges of the grammar: an
+	//'e' without digits, a lone '.' or sign, hex, inf and leading spaces.
+	char* cases[] = { "0", "-0", "1", "+2", "-1.5", "3.14159", "0.1", ".5",
+			"5.", "-.5", "1e5", "1E-3", "2.5e+10", "1e", "1e+", "3e-", "1.5e",
+			".", "-", "+", "-.", "", "abc", "e5", "1.5,2", "7 8", " 7", "0x1A",
+			"inf", "-Infinity", "nan", "12345678901234567890123",
+			"123456789012345678.9", "9007199254740993", "0.30000000000000004",
+			"1e400", "1e-400", "4.9e-324", "1e22", "1e23", "00000000000000000000012",
+			"0.000000000000000000000000001" };
+	size_t count = sizeof(cases) / sizeof(char*);
+
+	char str[64];
+	Rng* rng = rngthread();
+	for (size_t t = 0; t < count + 10000; t++) {
+		if (t < count) {
+			strcpy(str, cases[t]);
+		} else {
+			//random decimals, some of them too long for the fast path.
+			size_t digits = 1 + rngbelow(rng, 24);
+			size_t dot = rngbelow(rng, digits + 1);
+			size_t l = 0;
+			if (rngbelow(rng, 2)) {
+				str[l++] = '-';
+			}
+			for (size_t k = 0; k < digits; k++) {
+				if (k == dot) {
+					str[l++] = '.';
+				}
+				str[l++] = '0' + rngbelow(rng, 10);
+			}
+			if (rngbelow(rng, 2)) {
+				l += sprintf(str + l, "e%d", (int) rngbelow(rng, 80) - 40);
+			}
+			str[l] = '\0';
+		}
+
+		char* end;
+		double expected = strtod(str, &end);
+		double x = 0;
+		size_t used = numparse(str, -1, &x);
+		TEST(used == (size_t) (end - str));
+		if (used > 0) {
+			TEST(memcmp(&x, &expected, sizeof(double)) == 0
+					|| (isnan(x) && isnan(expected)));
+		}
+
+		//a slice reads only its own chars, even when the next ones would
+		//still be part of the number.
+		size_t length = strlen(str);
+		if (length > 1) {
+			char saved = str[length - 1];
+			str[length - 1] = '\0';
+			expected = strtod(str, &end);
+			str[length - 1] = saved;
+			used = numparse(str, length - 1, &x);
+			TEST(used == (size_t) (end - str));
+			if (used > 0) {
+				TEST(memcmp(&x, &expected, sizeof(double)) == 0
+						|| (isnan(x) && isnan(expected)));
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * A model refreshed with a few appended rows is no worse than the model
+ * it started from on all the rows, with either engine. Fitting the new
+ * rows alone made it several times worse.
+ */
+static int testrefresh() {
+	size_t base = 400;
+	size_t rows = 420;
+	char* text = malloc(rows * 64);
+	char* p = text;
+	char* end = NULL;
+	Rng* rng = rngthread();
+	for (size_t i = 0; i < rows; i++) {
+		double a = rngunit(rng) * 10;
+		double b = rngunit(rng) * 4 - 2;
+		double y = 3 * a - 2 * b + 5 + (rngunit(rng) - 0.5) * 2;
+		p += sprintf(p, "%s%.4f,%.4f,%.4f", i ? "\n" : "", a, b, y);
+		if (i + 1 == base) {
+			end = p;
+		}
+	}
+
+	short engines[] = { ENGINE_SGD, ENGINE_LBFGS };
+	for (size_t e = 0; e < 2; e++) {
+		trainengine = engines[e];
+
+		//the data file as it was when the model was trained.
+		char saved = *end;
+		*end = '\0';
+		char* csv = testfile(text);
+		*end = saved;
+		char* path = testfile("");
+		TEST(csv && path);
+
+		Data* data = dataload(csv, 0);
+		TEST(data);
+		trainstep(data);
+		double* lambdas = datalambdas(data);
+		TEST(artsave(path, data->map, data->info, data->expand, data->prune,
+				data->models, lambdas, trainengine, enetmix, data->count,
+				data->bytes) == 0);
+		free(lambdas);
+		datafree(data);
+
+		double before = testmse(path, text);
+		TEST(testwrite(csv, text, strlen(text)) == 0);
+		char* argv[] = { csv, path };
+		TEST(refreshmain(2, argv) == EXIT_SUCCESS);
+		double after = testmse(path, text);
+
+		//sgd ends a little away from the minimum on each run.
+		TEST(before > 0 && after <= before * 1.01);
+
+		unlink(csv);
+		unlink(path);
+		free(csv);
+		free(path);
+	}
+	trainengine = ENGINE_SGD;
+
+	free(text);
+	return 0;
+}
+
+/*
+ * A word column with more distinct values than maphashabove is hashed to
+ * mapbuckets columns, and the saved model scores each row of the file the
+ * same as the rows it was trained on, and words it never saw without
+ * counting them as unknown.
+ */
+static int testhash() {
+	size_t above = maphashabove;
+	size_t buckets = mapbuckets;
+	maphashabove = 4;
+	mapbuckets = 8;
+
+	char text[2048];
+	size_t l = 0;
+	for (size_t i = 0; i < 40; i++) {
+		size_t id = i * 7 % 12;
+		l += sprintf(text + l, "%s%.2f,u%zu,%.1f", i ? "\n" : "", i * 0.25,
+				id, i % 5 + id * 0.5);
+	}
+	char* csv = testfile(text);
+	char* path = testfile("");
+	TEST(csv && path);
+
+	Data* data = dataload(csv, 0);
+	maphashabove = above;
+	mapbuckets = buckets;
+	TEST(data);
+	TEST(data->map->map[1] == NULL && data->map->buckets[1] == 8);
+	TEST(testscores(data, text, path) == 0);
+
+	Artifact* art = artload(path);
+	TEST(art);
+	Scorer* sc = scorernew(art);
+	char** cells = malloc(sizeof(char*) * sc->split);
+	float* x = malloc(sizeof(float) * sc->width);
+	char line[] = "1.5,never-seen,0";
+	TEST(scoreenc(sc, line, strlen(line), cells, x) == 0);
+
+	free(x);
+	free(cells);
+	scorerfree(sc);
+	artfree(art);
+	datafree(data);
+	unlink(csv);
+	unlink(path);
+	free(csv);
+	free(path);
+	return 0;
+}
+
+/*
+ * expnew gives every monomial of the base features up to the degree once,
+ * in order of degree, and only the ones of distinct features for
+ * EXP_CROSS. expapply computes each of them, and a model trained on an
+ * expansion scores a file the same as the rows it was trained on.
+ */
+static int testexpand() {
+	float x[256];
+	unsigned char exps[256 * 5];
+	for (short kind = EXP_ALL; kind <= EXP_CROSS; kind++) {
+		for (size_t n = 1; n <= 5; n++) {
+			for (size_t degree = 1; degree <= 4; degree++) {
+				Expand* e = expnew(n, degree, kind);
+				TEST(e && e->n == n && e->length <= 256);
+				size_t length = e->length;
+
+				//counts the monomials by going over every exponent vector
+				//with exponents up to the degree.
+				size_t expected = 0;
+				size_t vectors = 1;
+				for (size_t f = 0; f < n; f++) {
+					vectors *= degree + 1;
+				}
+				for (size_t v = 1; v < vectors; v++) {
+					size_t total = 0;
+					short distinct = 1;
+					for (size_t f = 0, r = v; f < n; f++, r /= degree + 1) {
+						total += r % (degree + 1);
+						distinct &= r % (degree + 1) <= 1;
+					}
+					expected += total <= degree && (kind == EXP_ALL || distinct);
+				}
+				TEST(length == expected);
+
+				for (size_t t = 0; t < n; t++) {
+					memset(exps + t * n, 0, n);
+					exps[t * n + t] = 1;
+					x[t] = 1 + 0.5 * t;
+				}
+				expapply(e, x);
+
+				size_t last = 1;
+				for (size_t t = n; t < length; t++) {
+					size_t parent = e->parent[t - n];
+					size_t factor = e->factor[t - n];
+					TEST(parent < t && factor < n);
+					memcpy(exps + t * n, exps + parent * n, n);
+					exps[t * n + factor]++;
+
+					size_t total = 0;
+					double product = 1;
+					for (size_t f = 0; f < n; f++) {
+						total += exps[t * n + f];
+						TEST(kind == EXP_ALL || exps[t * n + f] <= 1);
+						product *= pow(1 + 0.5 * f, exps[t * n + f]);
+					}
+					TEST(total >= last && total <= degree);
+					last = total;
+					TEST(fabs(x[t] - product) <= 1e-5 * product);
+
+					for (size_t u = 0; u < t; u++) {
+						TEST(memcmp(exps + u * n, exps + t * n, n) != 0);
+					}
+				}
+
+				expfree(e);
+			}
+		}
+	}
+
+	size_t degree = expdegree;
+	expdegree = 2;
+	char* text = "1,2,0.5\n2,1,1.5\n3,0,2\n0,3,1\n2,2,2.5\n1,0,0\n"
+			"0,1,0.5\n3,3,4\n1,1,1\n2,0,1.5\n0,2,1\n3,1,2.5";
+	char* csv = testfile(text);
+	char* path = testfile("");
+	TEST(csv && path);
+	Data* data = dataload(csv, 0);
+	expdegree = degree;
+	TEST(data && data->expand && data->expand->length == 5);
+	TEST(testscores(data, text, path) == 0);
+
+	datafree(data);
+	unlink(csv);
+	unlink(path);
+	free(csv);
+	free(path);
+	return 0;
+}
+
+/*
+ * The quantiles of a KLL sketch are within a few times 1.7 / KLL_K of
+ * their rank, also after merging the sketches of two halves of the
+ * stream, and a HyperLogLog count is within a few times its 1.6% error.
+ */
+static int testsketch() {
+	size_t n = 200000;
+	float* vals = malloc(sizeof(float) * n);
+	for (size_t i = 0; i < n; i++) {
+		vals[i] = i;
+	}
+	Rng* rng = rngthread();
+	for (size_t i = n - 1; i > 0; i--) {
+		size_t r = rngbelow(rng, i + 1);
+		float tmp = vals[i];
+		vals[i] = vals[r];
+		vals[r] = tmp;
+	}
+
+	//the value i has rank i, so the error of a quantile is its distance
+	//to q * n.
+	Kll* all = kllnew(KLL_K);
+	Kll* half = kllnew(KLL_K);
+	Kll* other = kllnew(KLL_K);
+	for (size_t i = 0; i < n; i++) {
+		klladd(all, vals[i]);
+		klladd(i < n / 2 ? half : other, vals[i]);
+	}
+	kllmerge(half, other);
+	TEST(all->n == n && half->n == n);
+	TEST(kllquantile(all, 0) == 0 && kllquantile(all, 1) == n - 1);
+
+	double bound = 3 * 1.7 / KLL_K * n;
+	for (double q = 0.01; q < 1; q += 0.01) {
+		TEST(fabs(kllquantile(all, q) - q * n) <= bound);
+		TEST(fabs(kllquantile(half, q) - q * n) <= bound);
+	}
+	kllfree(all);
+	kllfree(half);
+	kllfree(other);
+	free(vals);
+
+	size_t counts[] = { 100, 5000, 200000 };
+	for (size_t c = 0; c < 3; c++) {
+		Hll* hll = hllnew();
+		Hll* low = hllnew();
+		Hll* high = hllnew();
+		char word[32];
+		for (size_t i = 0; i < counts[c]; i++) {
+			sprintf(word, "w%zu", i);
+			uint64_t hash = strhash(word);
+			hlladd(hll, hash);
+			hlladd(hll, hash);
+
+			//two overlapping thirds of the words and the rest.
+			hlladd(i < counts[c] * 2 / 3 ? low : high, hash);
+			if (i >= counts[c] / 3 && i < counts[c] * 2 / 3) {
+				hlladd(high, hash);
+			}
+		}
+		hllmerge(low, high);
+
+		double err = 3 * 1.04 / sqrt(HLL_REGS);
+		TEST(fabs(hllcount(hll) - counts[c]) <= err * counts[c]);
+		TEST(hllcount(low) == hllcount(hll));
+		hllfree(hll);
+		hllfree(low);
+		hllfree(high);
+	}
+
+	return 0;
+}
+
+/*
+ * A word that the type sample missed makes its column a word column in the
+ * full pass, and the data ends up the same as the one inferred from every
+ * row.
+ */
+static int testsample() {
+	//the sample of 10 rows reads every 20th row, so the word in row 197 is
+	//only found by the full pass.
+	char text[4096];
+	size_t l = 0;
+	for (size_t i = 0; i < 200; i++) {
+		l += sprintf(text + l, "%s%zu,", i ? "\n" : "", i % 13);
+		if (i == 197) {
+			l += sprintf(text + l, "late");
+		} else {
+			l += sprintf(text + l, "%zu", i % 3);
+		}
+		l += sprintf(text + l, ",%.1f", i % 7 * 0.5);
+	}
+	char* csv = testfile(text);
+	TEST(csv);
+
+	size_t sample = ginfosample;
+	ginfosample = 10;
+	Data* sampled = dataload(csv, 0);
+	ginfosample = 0;
+	Data* full = dataload(csv, 0);
+	ginfosample = sample;
+	TEST(sampled && full);
+
+	Mapper* a = sampled->map;
+	Mapper* b = full->map;
+	TEST(b->map[1] && b->sizes[1] == 4);
+	TEST(a->cols == b->cols);
+	for (size_t j = 0; j < a->cols; j++) {
+		TEST(a->sizes[j] == b->sizes[j] && !a->map[j] == !b->map[j]);
+		for (size_t i = 0; a->map[j] && i < a->sizes[j]; i++) {
+			TEST(strcmp(a->map[j][i], b->map[j][i]) == 0);
+		}
+
+		GridInfo* x = sampled->info;
+		GridInfo* y = full->info;
+		TEST(x->words[j] == y->words[j] && x->numbers[j] == y->numbers[j]);
+		TEST(x->missing[j] == y->missing[j]);
+		TEST(x->discrete[j] == y->discrete[j]);
+		TEST(memcmp(x->mean + j, y->mean + j, sizeof(float)) == 0);
+		TEST(memcmp(x->stdev + j, y->stdev + j, sizeof(float)) == 0);
+	}
+
+	Matrix* X = sampled->matrix;
+	Matrix* Y = full->matrix;
+	TEST(X->m == Y->m && X->n == Y->n);
+	TEST(memcmp(X->values, Y->values, sizeof(float) * X->m * X->n) == 0);
+
+	datafree(sampled);
+	datafree(full);
+	unlink(csv);
+	free(csv);
+	return 0;
+}
+
+/*
+ * Loading only some columns of a file, in any order and with any of them
+ * as the target, gives the same matrix columns as loading all of them.
+ */
+static int testproject() {
+	char* colors[] = { "red", "green", "blue" };
+	char text[4096];
+	size_t l = 0;
+	for (size_t i = 0; i < 60; i++) {
+		l += sprintf(text + l, "%s%.1f,%s,%zu,%.2f", i ? "\n" : "", i * 0.5,
+				colors[i * 7 % 3], i % 9, (i % 4) * 1.25);
+	}
+	char* csv = testfile(text);
+	TEST(csv);
+
+	Data* all = dataload(csv, 0);
+	TEST(all && all->map->source == NULL);
+	size_t* full = mtroffsets(all->map, all->info->missing);
+
+	size_t features[2][2] = { { 0, 2 }, { 2, 0 } };
+	ssize_t targets[2] = { -1, 1 };
+	for (size_t c = 0; c < 2; c++) {
+		gfeatures = features[c];
+		gfeaturecount = 2;
+		gtarget = targets[c];
+		Data* data = dataload(csv, 0);
+		gfeatures = NULL;
+		gfeaturecount = 0;
+		gtarget = -1;
+		TEST(data && data->map->cols == 3 && data->map->source);
+
+		size_t* offsets = mtroffsets(data->map, data->info->missing);
+		Matrix* X = data->matrix;
+		Matrix* Y = all->matrix;
+		TEST(X->m == Y->m && X->n == offsets[3]);
+		for (size_t j = 0; j < 3; j++) {
+			size_t f = data->map->source[j];
+			TEST(f == (j < 2 ? features[c][j] : targets[c] == -1 ? 3 : 1));
+
+			size_t width = offsets[j + 1] - offsets[j];
+			TEST(width == full[f + 1] - full[f]);
+			for (size_t i = 0; i < X->m; i++) {
+				TEST(memcmp(X->values + i * X->n + offsets[j],
+						Y->values + i * Y->n + full[f],
+						sizeof(float) * width) == 0);
+			}
+		}
+
+		free(offsets);
+		datafree(data);
+	}
+
+	free(full);
+	datafree(all);
+	unlink(csv);
+	free(csv);
+	return 0;
+}
+
+/*
+ * A model trained on pruned features scores every row the same as it does
+ * on the unpruned encoding, with its parameters put back at the kept
+ * features and 0 at the others, and the y of each class is still read from
+ * its own column after the pruned ones are gone.
+ */
+static int testprune() {
+	char* colors[] = { "red", "green", "blue", "gray" };
+	char* classes[] = { "a", "b", "c" };
+	char text[4096];
+	size_t l = 0;
+	for (size_t i = 0; i < 60; i++) {
+		//the second column is constant, the third one repeats the first
+		//one, and gray shows up once.
+		l += sprintf(text + l, "%s%.1f,7,%.1f,%s,%s", i ? "\n" : "", i % 11 * 0.5,
+				i % 11 * 0.5, colors[i == 30 ? 3 : i * 7 % 3],
+				classes[i * 5 % 3]);
+	}
+	char* csv = testfile(text);
+	char* path = testfile("");
+	TEST(csv && path);
+
+	size_t support = prunesupport;
+	Data* full = dataload(csv, 0);
+	prunesupport = 2;
+	Data* data = dataload(csv, 0);
+	prunesupport = support;
+	TEST(full && data && full->prune == NULL && data->prune);
+
+	Prune* p = data->prune;
+	size_t n = dataxn(full);
+	TEST(p->n == n && p->kept < n);
+	TEST(p->constant >= 1 && p->duplicate >= 1 && p->rare >= 1);
+	TEST(testscores(data, text, path) == 0);
+
+	Matrix* X = datax(full);
+	Matrix* P = datax(data);
+	double* theta = malloc(sizeof(double) * n);
+	for (size_t k = 0; k < data->count; k++) {
+		Matrix* y = datay(full, k);
+		Matrix* yp = datay(data, k);
+		TEST(y->m == yp->m);
+		TEST(memcmp(y->values, yp->values, sizeof(float) * y->m) == 0);
+		mtrfree(y);
+		mtrfree(yp);
+
+		LinearModel* model = data->models[k];
+		memset(theta, 0, sizeof(double) * n);
+		for (size_t i = 0; i < p->kept; i++) {
+			theta[p->keep[i]] = model->theta[i];
+		}
+		for (size_t i = 0; i < X->m; i++) {
+			double expected = h(P->values + i * P->n, P->n, model->bias,
+					model->theta);
+			double unpruned = h(X->values + i * X->n, n, model->bias, theta);
+			TEST(fabs(unpruned - expected) <= 1e-6 * (1 + fabs(expected)));
+		}
+	}
+
+	free(theta);
+	mtrfree(X);
+	mtrfree(P);
+	datafree(full);
+	datafree(data);
+	unlink(csv);
+	unlink(path);
+	free(csv);
+	free(path);
+	return 0;
+}
+
+/*
+ * A matrix with repeated rows and the weighted matrix mtrdedup collapses
+ * it in to are fit to the same model: the same minimum by L-BFGS, and a
+ * cost within 1% of it by single row gradient steps, which only holds if
+ * each unique row is drawn as often as the rows it stands for.
+ */
+static int testdedup() {
+	size_t m = 2000;
+	size_t n = 3;
+	Matrix* all = mtrnew(m, n + 1);
+	Rng* rng = rngthread();
+	for (size_t i = 0; i < m; i++) {
+		float* x = all->values + i * (n + 1);
+		//skewed, so the weights are far from each other.
+		x[0] = rngbelow(rng, rngbelow(rng, 4) + 1);
+		x[1] = rngbelow(rng, 3);
+		x[2] = rngbelow(rng, 2);
+		x[3] = 1.5 * x[0] - x[1] + 2 * x[2] + 0.4 * x[0] * x[0]
+				+ sin(x[0] * 6 + x[1] * 2 + x[2]);
+	}
+
+	Matrix* dedup = mtrdedup(all);
+	TEST(dedup && dedup->m <= 24 && mtrweight(dedup, 0, dedup->m) == m);
+
+	Matrix* X = mtrslct(all, 0, n);
+	Matrix* y = mtrslct(all, n, n + 1);
+	Matrix* Xd = mtrslct(dedup, 0, n);
+	Matrix* yd = mtrslct(dedup, n, n + 1);
+	TEST(Xd->weights && Xd->m == dedup->m);
+
+	LinearModel* best = modlinear(n);
+	LinearModel* bestd = modlinear(n);
+	lbfgs(X, best, y, 0);
+	lbfgs(Xd, bestd, yd, 0);
+	TEST(fabs(best->bias - bestd->bias) < 1e-4);
+	for (size_t k = 0; k < n; k++) {
+		TEST(fabs(best->theta[k] - bestd->theta[k]) < 1e-4);
+	}
+	double jbest = j(X, best, y, 0);
+
+	LinearModel* sgd = modlinear(n);
+	LinearModel* sgdd = modlinear(n);
+	for (double alpha = 0.01; alpha > 1e-4; alpha /= 3) {
+		stogdcent(X, sgd, y, alpha, 0, 1, 100000);
+		stogdcent(Xd, sgdd, yd, alpha, 0, 1, 100000);
+	}
+	TEST(j(X, sgd, y, 0) < jbest * 1.01);
+	TEST(j(X, sgdd, y, 0) < jbest * 1.01);
+
+	modfree(best);
+	modfree(bestd);
+	modfree(sgd);
+	modfree(sgdd);
+	mtrfree(X);
+	mtrfree(y);
+	mtrfree(Xd);
+	mtrfree(yd);
+	mtrfree(dedup);
+	mtrfree(all);
+	return 0;
+}
+
+/*
+ * The sparse gradient steps, with their lazy L2 decay, give the model of
+ * the dense steps up to rounding. X is one-hot, so it is sparse enough
+ * and too wide for the fixed size kernels, and its bfloat16 copy holds the
+ * same values but is only read by the dense loop.
+ */
+static int testsparse() {
+	size_t m = 500;
+	size_t groups = 3;
+	size_t width = 20;
+	size_t n = groups * width;
+	Matrix* X = mtrnew(m, n);
+	Matrix* y = mtrnew(m, 1);
+	Rng* rng = rngthread();
+	memset(X->values, 0, sizeof(float) * m * n);
+	for (size_t i = 0; i < m; i++) {
+		double yi = rngunit(rng) - 0.5;
+		for (size_t g = 0; g < groups; g++) {
+			size_t k = rngbelow(rng, width);
+			X->values[i * n + g * width + k] = 1;
+			yi += (k % 5) * (g + 1) * 0.3;
+		}
+		y->values[i] = yi;
+	}
+
+	Matrix* P = mtrpack(X, 0, m, MTR_BF16);
+	TEST(P && !mtrdirect(P));
+
+	double lambdas[] = { 0, 0.01, 1 };
+	LinearModel* sparse = modlinear(n);
+	LinearModel* dense = modlinear(n);
+	for (size_t l = 0; l < 3; l++) {
+		modrand(sparse);
+		dense->bias = sparse->bias;
+		copyd(dense->theta, sparse->theta, n);
+
+		//the same seed gives both the same order of the rows.
+		rnginit(7, 0);
+		stogdcent(X, sparse, y, 0.1, lambdas[l], 10, 5000);
+		rnginit(7, 0);
+		stogdcent(P, dense, y, 0.1, lambdas[l], 10, 5000);
+
+		TEST(fabs(sparse->bias - dense->bias) < 1e-9);
+		for (size_t k = 0; k < n; k++) {
+			TEST(fabs(sparse->theta[k] - dense->theta[k])
+					< 1e-9 * (1 + fabs(dense->theta[k])));
+		}
+	}
+
+	modfree(sparse);
+	modfree(dense);
+	mtrfree(P);
+	mtrfree(X);
+	mtrfree(y);
+	return 0;
+}
+
+/*
+ * L-BFGS reaches the minimum of the ridge cost given by its normal
+ * equations, and its gradient passes add the blocks of rows in the same
+ * order with any number of threads, so the model does not change with
+ * them.
+ */
+static int testlbfgs() {
+	size_t m = 10000;
+	size_t n = 5;
+	Matrix* X = mtrnew(m, n);
+	Matrix* y = mtrnew(m, 1);
+	Rng* rng = rngthread();
+	for (size_t i = 0; i < m; i++) {
+		float* x = X->values + i * n;
+		double yi = 0.5 + (rngunit(rng) - 0.5) * 0.2;
+		for (size_t k = 0; k < n; k++) {
+			x[k] = rngunit(rng) * 2 - 1 + (k == 1 ? x[0] : 0);
+			yi += (k + 1.0) * x[k];
+		}
+		y->values[i] = yi;
+	}
+
+	//the minimum of j: (A' A + lambda I) v = A' y, with A = [1 X], where the
+	//bias, v[0], is not penalized.
+	double lambda = 50;
+	size_t len = n + 1;
+	double* A = calloc(len * len, sizeof(double));
+	double* v = calloc(len, sizeof(double));
+	for (size_t i = 0; i < m; i++) {
+		float* x = X->values + i * n;
+		for (size_t a = 0; a < len; a++) {
+			double xa = a ? x[a - 1] : 1;
+			v[a] += xa * y->values[i];
+			for (size_t b = 0; b < len; b++) {
+				A[a * len + b] += xa * (b ? x[b - 1] : 1);
+			}
+		}
+	}
+	for (size_t a = 1; a < len; a++) {
+		A[a * len + a] += lambda;
+	}
+	TEST(testsolve(A, v, len) == 0);
+
+	size_t threads[] = { 1, 3 };
+	LinearModel* models[2];
+	for (size_t t = 0; t < 2; t++) {
+		lbfgsthreads = threads[t];
+		models[t] = modlinear(n);
+		lbfgs(X, models[t], y, lambda);
+	}
+	lbfgsthreads = 0;
+
+	TEST(fabs(models[0]->bias - v[0]) < 1e-5);
+	for (size_t k = 0; k < n; k++) {
+		TEST(fabs(models[0]->theta[k] - v[k + 1]) < 1e-5);
+	}
+	TEST(models[0]->bias == models[1]->bias);
+	TEST(memcmp(models[0]->theta, models[1]->theta, sizeof(double) * n) == 0);
+
+	modfree(models[0]);
+	modfree(models[1]);
+	free(A);
+	free(v);
+	mtrfree(X);
+	mtrfree(y);
+	return 0;
+}
+
+/*
+ * Coordinate descent stops at a point that meets the optimality conditions
+ * of the elastic net: the bias zeroes the mean residual, a feature at 0 has
+ * a gradient within the l1 share of lambda, and any other one cancels it.
+ * With no l1 share, its minimum is the one of L-BFGS for m times its
+ * lambda, which is how refresh converts the lambdas between engines.
+ */
+static int testcd() {
+	size_t m = 2000;
+	size_t n = 8;
+	Matrix* X = mtrnew(m, n);
+	Matrix* y = mtrnew(m, 1);
+	Rng* rng = rngthread();
+	for (size_t i = 0; i < m; i++) {
+		float* x = X->values + i * n;
+		double yi = 1 + (rngunit(rng) - 0.5) * 0.5;
+		for (size_t k = 0; k < n; k++) {
+			x[k] = rngunit(rng) * 2 - 1 + (k % 2 ? x[k - 1] * 0.5 : 0);
+			//only the first half of the features matter.
+			yi += k < n / 2 ? (k + 1.0) * x[k] : 0;
+		}
+		y->values[i] = yi;
+	}
+
+	double mixes[] = { 1, 0.5 };
+	double lambda = 0.2;
+	LinearModel* model = modlinear(n);
+	double* grad = malloc(sizeof(double) * (n + 1));
+	for (size_t t = 0; t < 2; t++) {
+		enetmix = mixes[t];
+		modrand(model);
+		enetfit(X, model, y, lambda);
+
+		//the gradient of the mean squared error over 2.
+		memset(grad, 0, sizeof(double) * (n + 1));
+		for (size_t i = 0; i < m; i++) {
+			float* x = X->values + i * n;
+			double r = h(x, n, model->bias, model->theta) - y->values[i];
+			grad[0] += r / m;
+			for (size_t k = 0; k < n; k++) {
+				grad[k + 1] += r * x[k] / m;
+			}
+		}
+
+		size_t zeros = 0;
+		double l1 = lambda * enetmix;
+		TEST(fabs(grad[0]) < 1e-4);
+		for (size_t k = 0; k < n; k++) {
+			double theta = model->theta[k];
+			double g = grad[k + 1] + lambda * (1 - enetmix) * theta;
+			if (theta == 0) {
+				TEST(fabs(g) <= l1 + 1e-4);
+				zeros++;
+			} else {
+				TEST(fabs(g + (theta > 0 ? l1 : -l1)) < 1e-4);
+			}
+		}
+		TEST(zeros > 0);
+	}
+
+	enetmix = 0;
+	LinearModel* ridge = modlinear(n);
+	enetfit(X, model, y, lambda);
+	lbfgs(X, ridge, y, lambda * m);
+	TEST(fabs(model->bias - ridge->bias) < 1e-4);
+	for (size_t k = 0; k < n; k++) {
+		TEST(fabs(model->theta[k] - ridge->theta[k]) < 1e-4);
+	}
+	enetmix = 1;
+
+	free(grad);
+	modfree(model);
+	modfree(ridge);
+	mtrfree(X);
+	mtrfree(y);
+	return 0;
+}
+
+/*
+ * Writes text to a new temporary file and returns its path.
+ */
+static char* testfile(char* text) {
+	char* path = malloc(32);
+	strcpy(path, "/tmp/linfit-test-XXXXXX");
+	int fd = mkstemp(path);
+	if (fd == -1) {
+		free(path);
+		return NULL;
+	}
+	close(fd);
+
+	if (testwrite(path, text, strlen(text)) != 0) {
+		unlink(path);
+		free(path);
+		return NULL;
+	}
+
+	return path;
+}
+
+static int testwrite(char* path, char* bytes, size_t size) {
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) {
+		return -1;
+	}
+
+	int ret = fwrite(bytes, 1, size, f) == size ? 0 : -1;
+	if (fclose(f) != 0) {
+		ret = -1;
+	}
+	return ret;
+}
+
+static char* testread(char* path, size_t* size) {
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) {
+		return NULL;
+	}
+
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	char* bytes = malloc(*size);
+	if (fread(bytes, 1, *size, f) != *size) {
+		free(bytes);
+		bytes = NULL;
+	}
+	fclose(f);
+	return bytes;
+}
+
+/*
+ * Mean squared error of the model saved in path on the rows of text, whose
+ * y is a number in the last column.
+ */
+static double testmse(char* path, char* text) {
+	Artifact* art = artload(path);
+	if (art == NULL) {
+		return NAN;
+	}
+
+	Scorer* sc = scorernew(art);
+	char** cells = malloc(sizeof(char*) * sc->split);
+	float* x = malloc(sizeof(float) * sc->width);
+	size_t ycol = sc->cols - 1;
+	double sum = 0;
+	size_t rows = 0;
+	for (char* p = text; *p;) {
+		char* nl = strchr(p, '\n');
+		size_t l = nl ? (size_t) (nl - p) : strlen(p);
+		char* last = p + l;
+		while (last > p && last[-1] != ',') {
+			last--;
+		}
+		double y = strtod(last, NULL);
+
+		//the line is split in place.
+		char* line = malloc(l + 1);
+		memcpy(line, p, l);
+		line[l] = '\0';
+
+		double h;
+		memset(x, 0, sizeof(float) * sc->width);
+		scoreenc(sc, line, l, cells, x);
+		free(line);
+		scoreblock(sc, x, 1, &h);
+		h = h * art->info->stdev[ycol] + art->info->mean[ycol];
+		sum += (h - y) * (h - y);
+		rows++;
+
+		p += nl ? l + 1 : l;
+	}
+
+	free(x);
+	free(cells);
+	scorerfree(sc);
+	artfree(art);
+	return sum / rows;
+}
+
+/*
+ * Gives the models of data made up parameters, saves them to path and
+ * checks that the saved model scores each row of text, the file data was
+ * loaded from, the same as h over the row of data->matrix. Covers the
+ * hashing, pruning and expansion data was loaded with.
+ */
+static int testscores(Data* data, char* text, char* path) {
+	dataalloc(data);
+	size_t xn = dataxn(data);
+	Matrix* X = datax(data);
+	size_t n = X->n;
+	for (size_t k = 0; k < data->count; k++) {
+		data->models[k] = modlinear(n);
+		data->models[k]->bias = k * 0.25;
+		for (size_t i = 0; i < n; i++) {
+			data->models[k]->theta[i] = ((i * 7 + k * 3) % 11) * 0.1 - 0.5;
+		}
+	}
+	double* lambdas = datalambdas(data);
+	TEST(artsave(path, data->map, data->info, data->expand, data->prune,
+			data->models, lambdas, ENGINE_SGD, 0, data->count, 0) == 0);
+	free(lambdas);
+
+	Artifact* art = artload(path);
+	TEST(art && art->count == data->count && art->xn == n);
+	for (size_t j = 0; j < data->map->cols; j++) {
+		TEST(art->map->buckets[j] == data->map->buckets[j]);
+	}
+	TEST((art->prune == NULL) == (data->prune == NULL));
+	if (art->prune) {
+		TEST(art->prune->n == data->prune->n);
+		TEST(art->prune->kept == data->prune->kept && art->prune->kept == xn);
+		for (size_t i = 0; i < xn; i++) {
+			TEST(art->prune->keep[i] == data->prune->keep[i]);
+		}
+	}
+
+	Scorer* sc = scorernew(art);
+	char** cells = malloc(sizeof(char*) * sc->split);
+	float* x = malloc(sizeof(float) * sc->width);
+	float* row = malloc(sizeof(float) * n);
+	double* scores = malloc(sizeof(double) * data->count);
+	size_t i = 0;
+	for (char* p = text; *p; i++) {
+		char* nl = strchr(p, '\n');
+		size_t l = nl ? (size_t) (nl - p) : strlen(p);
+
+		//the line is split in place.
+		char* line = malloc(l + 1);
+		memcpy(line, p, l);
+		line[l] = '\0';
+		TEST(scoreenc(sc, line, l, cells, x) == 0);
+		free(line);
+		scoreblock(sc, x, 1, scores);
+
+		TEST(i < X->m);
+		float* xi = mtrload(X, i, row);
+		for (size_t k = 0; k < data->count; k++) {
+			LinearModel* model = data->models[k];
+			double expected = h(xi, n, model->bias, model->theta);
+			TEST(fabs(scores[k] - expected) <= 1e-5 * (1 + fabs(expected)));
+		}
+
+		p += nl ? l + 1 : l;
+	}
+	TEST(i == X->m);
+
+	free(scores);
+	free(row);
+	free(x);
+	free(cells);
+	scorerfree(sc);
+	artfree(art);
+	mtrfree(X);
+	return 0;
+}
+
+/*
+ * Solves A x = b for a n x n matrix by Gaussian elimination with partial
+ * pivoting, leaving x in b. A is overwritten. Returns -1 when A is
+ * singular.
+ */
+static int testsolve(double* A, double* b, size_t n) {
+	for (size_t c = 0; c < n; c++) {
+		size_t p = c;
+		for (size_t r = c + 1; r < n; r++) {
+			if (fabs(A[r * n + c]) > fabs(A[p * n + c])) {
+				p = r;
+			}
+		}
+		if (A[p * n + c] == 0) {
+			return -1;
+		}
+
+		for (size_t k = 0; k < n; k++) {
+			double tmp = A[c * n + k];
+			A[c * n + k] = A[p * n + k];
+			A[p * n + k] = tmp;
+		}
+		double tmp = b[c];
+		b[c] = b[p];
+		b[p] = tmp;
+
+		for (size_t r = c + 1; r < n; r++) {
+			double f = A[r * n + c] / A[c * n + c];
+			for (size_t k = c; k < n; k++) {
+				A[r * n + k] -= f * A[c * n + k];
+			}
+			b[r] -= f * b[c];
+		}
+	}
+
+	for (size_t c = n; c-- > 0;) {
+		for (size_t k = c + 1; k < n; k++) {
+			b[c] -= A[c * n + k] * b[k];
+		}
+		b[c] /= A[c * n + c];
+	}
+	return 0;
+}
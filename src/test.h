@@ -0,0 +1,13 @@
+/*
+ * test.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: yaison
+ */
+
+#ifndef TEST_H_
+#define TEST_H_
+
+int testmain(int argc, char** argv);
+
+#endif /* TEST_H_ */
@@ -9,9 +9,11 @@
 #include <string.h>
 #include <stdio.h>
 #include <dirent.h>
+#include <unistd.h>
 
 #include "utils.h"
 #include "ui.h"
+#include "quant.h"
 
 
 /*
@@ -20,6 +22,14 @@
  * the Data pointer use datafree function.
  */
 Data* datastep(char* filePath) {
+	return dataload(filePath, 1);
+}
+
+/*
+ * Same as datastep, but the progress and the column details are only
+ * printed when verbose is not 0. Errors are always printed to stderr.
+ */
+Data* dataload(char* filePath, short verbose) {
 
 	String* raw = ffull(filePath);
 	if (raw) {
@@ -36,35 +46,100 @@ Data* datastep(char* filePath) {
 			}
 		}
 
-		printf("Read file content %s.\n", filePath);
-		printf("Building structures:\n");
-		flush();
+		if (verbose) {
+			printf("Read file content %s.\n", filePath);
+			printf("Building structures:\n");
+			flush();
+		}
+		size_t bytes = raw->length;
 		Grid* g = gcreate(raw->value, ',');
 		if (g) {
 			//after the Grid struct is created, we no longer need the
 			//raw pointer.
 			strfree(raw);
-			printf("Grid created.\n");
+			if (verbose) {
+				printf("Grid created.\n");
+			}
 			Mapper* map = mapcreate(g);
 			if (map) {
 
-				printf("Mapper created.\n");
+				if (verbose) {
+					printf("Mapper created.\n");
+				}
 				//let's create a clone of the info struct
-				GridInfo* info = ginfo(g, g->info->rows, g->info->columns);
+				GridInfo* info = ginfocopy(g->info);
 				if (info) {
 
-					printf("GridInfo created.\n");
-					flush();
+					if (verbose) {
+						printf("GridInfo created.\n");
+						flush();
+						pcolinf(map, info);
+						pyinf(map, info);
+					}
 					//at this point we no longer need the Grid struct.
 
-					pcolinf(info);
-					pyinf(map, info);
 					Data* d = malloc(sizeof(Data));
 					d->info = info;
 					d->map = map;
 					d->matrix = mtrcreate(g, map);
+					d->models = NULL;
+					d->fits = NULL;
+					d->count = 0;
+					d->bytes = bytes;
+					d->verbose = verbose;
+					d->expand = NULL;
+					d->prune = NULL;
 					gfree(g);
 
+					if (d->matrix) {
+						d->prune = prunenew(d->matrix, dataxn(d));
+					}
+
+					if (d->prune) {
+						Matrix* pruned = prunematrix(d->prune, d->matrix);
+						mtrfree(d->matrix);
+						d->matrix = pruned;
+
+						if (verbose) {
+							Prune* p = d->prune;
+							printf("Pruned %zu of %zu features: %zu constant, "
+									"%zu in fewer than %zu rows, %zu "
+									"duplicated.\n", p->n - p->kept, p->n,
+									p->constant, p->rare, prunesupport,
+									p->duplicate);
+						}
+					}
+
+					//rows that encode the same way, y included, are trained
+					//on once with the number of them as the weight. This is
+					//done before train splits the rows, so the copies of a
+					//row are no longer spread over the train and test rows.
+					Matrix* dedup = mtrdedupe && d->matrix ?
+							mtrdedup(d->matrix) : NULL;
+					if (dedup) {
+						if (verbose) {
+							printf("Collapsed %zu rows in to %zu unique rows.\n",
+									d->matrix->m, dedup->m);
+						}
+						mtrfree(d->matrix);
+						d->matrix = dedup;
+					}
+
+					if (expdegree > 1 && d->matrix) {
+						d->expand = expnew(dataxn(d), expdegree, expterms);
+						if (d->expand == NULL) {
+							datafree(d);
+							return NULL;
+						}
+
+						if (verbose) {
+							printf("Expanded %zu features to %zu, degree %zu, "
+									"%s terms.\n", d->expand->n,
+									d->expand->length, expdegree,
+									expkindname(expterms));
+						}
+					}
+
 					return d;
 				}
 
@@ -77,13 +152,14 @@ Data* datastep(char* filePath) {
 			strfree(raw);
 		}
 	} else {
-		printf("There was a problem with the file %s.\n", abs);
+		fflush(stdout);
+		fprintf(stderr, "There was a problem with the file %s.\n", filePath);
+		fflush(stderr);
 	}
 
 	return NULL;
 }
 
-
 /*
  * This function checks the y column (last right) and determines if it's
  * numeric or a word column. In case it's a word column, it will delegate
@@ -113,25 +189,28 @@ void trainstep(Data* data) {
  * data's matrix.
  */
 void numerictrain(Data* data) {
-	Matrix* mtr = data->matrix;
-	size_t n = mtr->n;
+	short verbose = data->verbose;
 
-	printf("====================================================\n");
-	Matrix* X = mtrslct(mtr, 0, n - 1);
-	size_t xn = X->n;
+	if (verbose) {
+		printf("====================================================\n");
+	}
+	Matrix* X = datax(data);
 
-	LinearModel* model = modlinear(xn);
+	//the trained model is kept in the Data struct, so it can be saved
+	//as an artifact later on.
+	dataalloc(data);
 
-	Matrix* y = mtrslct(mtr, n - 1, n);
+	Matrix* y = datay(data, 0);
 	//once the X, model, and y structures are built, training is as
 	//simple as calling the dotrain function.
-	dotrain(X, model, y);
+	data->models[0] = modlinear(X->n);
+	dotrain(X, data->models[0], y, &data->fits[0], verbose);
 
 	mtrfree(X);
 	mtrfree(y);
-	modfree(model);
-	printf("====================================================\n\n");
-	
+	if (verbose) {
+		printf("====================================================\n\n");
+	}
 }
 
 /*
@@ -140,69 +219,184 @@ void numerictrain(Data* data) {
  * train for each class and compute it's own cost value.
  */
 void wordtrain(Data* data) {
-
-	Matrix* mtr = data->matrix;
-	char*** map = data->map->map;
-	size_t* sizes = data->map->sizes;
-	size_t* missing = data->info->missing;
-
-	size_t cols = data->map->cols;
-	size_t ycol = cols - 1;
-	size_t ycount = data->map->sizes[ycol];
-	size_t ystart = mtrcols(map, sizes, missing, ycol);
+	short verbose = data->verbose;
+	size_t ycol = data->map->cols - 1;
 
 	//it doesn't matter the the type of class of the y column, the X matrix
 	//will be the same for all classes. That is why we can safely create
 	//the X matrix at this point and reuse it for each class.
-	Matrix* X = mtrslct(mtr, 0, ystart);
+	Matrix* X = datax(data);
 	size_t xn = X->n;
 
-	for (size_t i = 0; i < ycount; i++) {
-		char* yval = map[ycol][i];
-		//since each class has a corresponding column in the Data's matrix,
-		//we need to compute that index. yidx is the class target idx in the
-		//Data's matrix.
-		size_t yidx = tomtrcol(map, sizes, missing, ycol, yval);
+	//one model per class, in the same order of the y values of the mapper.
+	dataalloc(data);
 
-		printf("====================================================\n");
-		printf("y: %s\n\n", yval);
+	for (size_t i = 0; i < data->count; i++) {
+		char* yval = data->map->map[ycol][i];
+
+		if (verbose) {
+			printf("====================================================\n");
+			printf("y: %s\n\n", yval);
+		}
 		
-		//the +1 is just for indexing purpose: [yidx, yidx+1)
-		Matrix* y = mtrslct(mtr, yidx, yidx + 1);
+		Matrix* y = datay(data, i);
 
 		LinearModel* model = modlinear(xn);
 
 		//once the X, model, and y structures are built, training is as
 		//simple as calling the dotrain function.
-		dotrain(X, model, y);
+		dotrain(X, model, y, &data->fits[i], verbose);
+		data->models[i] = model;
 
 		mtrfree(y);
-		modfree(model);
-		printf("====================================================\n\n");
+		if (verbose) {
+			printf("====================================================\n\n");
+		}
 	}
 	
 	mtrfree(X);
 }
 
-void dotrain(Matrix* X, LinearModel* model, Matrix* y) {
+/*
+ * Allocates the models and fits arrays of the Data struct: one entry for a
+ * number y column, or one entry per y value for a word y column.
+ */
+void dataalloc(Data* data) {
+	size_t ycol = data->map->cols - 1;
+	size_t count = 1;
+	if (data->map->map[ycol]) {
+		count = data->map->sizes[ycol];
+	}
+
+	data->models = calloc(count, sizeof(LinearModel*));
+	data->fits = calloc(count, sizeof(Fit));
+	data->count = count;
+}
+
+/*
+ * Creates the X matrix of the data: every matrix column at the left of the
+ * y column. If the data has an expansion, the matrix keeps the base
+ * features and its n is the expanded width.
+ */
+Matrix* datax(Data* data) {
+	Matrix* X = mtrslct(data->matrix, 0, dataxn(data));
+	if (X && data->expand) {
+		X->expand = expcopy(data->expand);
+		X->n = data->expand->length;
+	}
+
+	return X;
+}
+
+/*
+ * Number of matrix columns at the left of the y column, which are only the
+ * kept features when the data was pruned.
+ */
+size_t dataxn(Data* data) {
+	size_t ycol = data->map->cols - 1;
+
+	if (data->prune) {
+		return data->prune->kept;
+	}
+
+	if (data->map->map[ycol] == NULL) {
+		return data->matrix->n - 1;
+	}
+
+	return mtrcols(data->map, data->info->missing, ycol);
+}
+
+/*
+ * Creates the y matrix of the i-th model of the data. For a word y column,
+ * each y value has its own column in the data's matrix.
+ */
+Matrix* datay(Data* data, size_t i) {
+	Matrix* mtr = data->matrix;
+	char*** map = data->map->map;
+	size_t* missing = data->info->missing;
+	size_t ycol = data->map->cols - 1;
+
+	if (map[ycol] == NULL) {
+		return mtrslct(mtr, mtr->n - 1, mtr->n);
+	}
+
+	//since each class has a corresponding column in the Data's matrix,
+	//we need to compute that index. yidx is the class target idx in the
+	//Data's matrix.
+	size_t yidx = tomtrcol(data->map, missing, ycol, map[ycol][i]);
+	if (data->prune) {
+		yidx -= data->prune->n - data->prune->kept;
+	}
+
+	//the +1 is just for indexing purpose: [yidx, yidx+1)
+	return mtrslct(mtr, yidx, yidx + 1);
+}
+
+/*
+ * Trains the model and records the chosen lambda, the cost before and after
+ * the training and the time it took in the fit parameter.
+ */
+void dotrain(Matrix* X, LinearModel* model, Matrix* y, Fit* fit,
+		short verbose) {
 	size_t xn = X->n;
 
 	double jbefore = j(X, model, y, 0);
-	printf("Before j: %12.8f\n", jbefore);
-	printf("Training... please wait.\n");
-	flush();
-	train(X, model, y);
+	if (verbose) {
+		printf("Before j: %12.8f\n", jbefore);
+		printf("Training... please wait.\n");
+		flush();
+	}
+	double start = wtime();
+	double lambda = train(X, model, y);
+	double seconds = wtime() - start;
 	double jafter = j(X, model, y, 0);
+
+	fit->lambda = lambda;
+	fit->jbefore = jbefore;
+	fit->jafter = jafter;
+	fit->seconds = seconds;
+
+	if (!verbose) {
+		return;
+	}
+
+	printf("lambda: %f\n", lambda);
 	printf("After  j: %12.8f\n", jafter);
 
+	size_t used = 0;
+	for (size_t k = 0; k < xn; k++) {
+		used += model->theta[k] != 0;
+	}
+	if (used < xn) {
+		printf("Features used: %zu of %zu\n", used, xn);
+	}
+
 	printf("\nSome examples\n\n");
 
-	for (int i = 0; i < 10; i++) {
-		float* x = X->values + i * xn;
+	float* row = malloc(sizeof(float) * xn);
+	for (int i = 0; i < 10 && i < X->m; i++) {
+		float* x = mtrload(X, i, row);
 		double ans = h(x, xn, model->bias, model->theta);
 		printf("%8.4f  ->  %8.4f\n", y->values[i], ans);
 	}
+	free(row);
+
+}
+
+/*
+ * Returns a new array with the lambda chosen for each model, or NULL if the
+ * models were not trained yet.
+ */
+double* datalambdas(Data* data) {
+	if (data->fits == NULL) {
+		return NULL;
+	}
 
+	double* lambdas = malloc(sizeof(double) * data->count);
+	for (size_t k = 0; k < data->count; k++) {
+		lambdas[k] = data->fits[k].lambda;
+	}
+	return lambdas;
 }
 
 void datafree(Data* data) {
@@ -219,6 +413,19 @@ void datafree(Data* data) {
 			mtrfree(data->matrix);
 		}
 
+		if (data->models) {
+			for (size_t i = 0; i < data->count; i++) {
+				modfree(data->models[i]);
+			}
+			free(data->models);
+		}
+
+		if (data->fits) {
+			free(data->fits);
+		}
+
+		expfree(data->expand);
+		prunefree(data->prune);
 		free(data);
 	}
 }
@@ -246,23 +453,26 @@ void pyinf(Mapper* map, GridInfo* info) {
 }
 
 /*
- * Prints information of the GridInfo struct.
+ * Prints the statistics of each column, numbered as in the data file. The
+ * median of a number column and the distinct values of a word column are
+ * estimated by the sketches of the info, and printed as - when it has none.
  */
-void pcolinf(GridInfo* info) {
+void pcolinf(Mapper* map, GridInfo* info) {
 	size_t cols = info->columns;
+	char* line = "---------------------------------------------------------------"
+			"---------------------------------------------------------------"
+			"----------\n";
 	printf("\nColumn details:\n\n");
+	printf("%s", line);
 	printf(
-			"------------------------------------------------------------------------------------------------------------\n");
-	printf(
-			"|  Index  |   Type   |   Count   |  Missing  |     Max     |     Min     |     Mean     |   Standard Dev   |\n");
-	printf(
-			"------------------------------------------------------------------------------------------------------------\n");
+			"|  Index  |   Type   |   Count   |  Missing  |     Max     |     Min     |     Mean     |   Standard Dev   |    Median    |  Distinct  |\n");
+	printf("%s", line);
 	flush();
 	for (size_t j = 0; j < cols; j++) {
 		short numeric = info->words[j] == 0;
 
 		size_t missing = info->missing[j];
-		printf("| %6d ", (j + 1));
+		printf("| %6d ", (map->source ? map->source[j] : j) + 1);
 		flush();
 		if (numeric) {
 			size_t count = info->numbers[j];
@@ -271,6 +481,7 @@ void pcolinf(GridInfo* info) {
 			float min = info->min[j];
 			float mean = info->mean[j];
 			float stdev = info->stdev[j];
+			Kll* kll = info->quantiles ? info->quantiles[j] : NULL;
 
 			if (discrete) {
 				printf(
@@ -281,19 +492,32 @@ void pcolinf(GridInfo* info) {
 						" |   float  | %9d | %9d |  %9.2f  |  %9.2f  | %12.2f | %16.2f |",
 						count, missing, max, min, mean, stdev);
 			}
+
+			if (kll) {
+				printf(" %12.2f |          -  |", kllquantile(kll, 0.5));
+			} else {
+				printf("          -   |          -  |");
+			}
 		} else {
 			size_t count = 0;
 			count += info->words[j];
 			count += info->numbers[j];
 			printf(
-					" |   word   | %9d | %9d |         -   |         -   |          -   |              -   |",
+					" |   word   | %9d | %9d |         -   |         -   |          -   |              -   |          -   |",
 					count, missing);
+
+			if (info->distinct && info->distinct[j]) {
+				char est[32];
+				snprintf(est, sizeof(est), "~%.0f", hllcount(info->distinct[j]));
+				printf(" %10s  |", est);
+			} else {
+				printf("          -  |");
+			}
 		}
 
 		printf("\n");
 	}
-	printf(
-			"------------------------------------------------------------------------------------------------------------\n");
+	printf("%s", line);
 }
 
 void pfiles(char** fileNames, char* buf, size_t buflen, size_t* l, short* found) {
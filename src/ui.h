@@ -8,19 +8,47 @@
 #ifndef UI_H_
 #define UI_H_
 
+#include <dirent.h>
+
+/*
+ * Result of training a single model.
+ */
+typedef struct Fit{
+	double lambda;
+	double jbefore;
+	double jafter;
+	double seconds;
+}Fit;
+
 typedef struct Data{
 	Mapper* map;
 	GridInfo* info;
 	Matrix* matrix;
+	LinearModel** models;
+	Fit* fits;
+	size_t count;
+	size_t bytes;
+	short verbose;
+	Expand* expand;
+	Prune* prune;
 }Data;
 
 
 void datafree(Data* data);
 Data* datastep(char* filePath);
+Data* dataload(char* filePath, short verbose);
 void trainstep(Data* data);
+void numerictrain(Data* data);
 void wordtrain(Data* data);
+void dataalloc(Data* data);
+double* datalambdas(Data* data);
+Matrix* datax(Data* data);
+size_t dataxn(Data* data);
+Matrix* datay(Data* data, size_t i);
+void dotrain(Matrix* X, LinearModel* model, Matrix* y, Fit* fit,
+		short verbose);
 void pyinf(Mapper* map, GridInfo* info);
-void pcolinf(GridInfo* info);
+void pcolinf(Mapper* map, GridInfo* info);
 void pfiles(char** fileNames, char* buf, size_t buflen, size_t* l, short* found);
 void pdir(struct dirent* ent, char** fileNames, short* found);
 void mtrprint(Matrix* matrix);
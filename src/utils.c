@@ -1,13 +1,59 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <limits.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <time.h>
 
 #include "utils.h"
 #include "ml.h"
+#include "prof.h"
+#include "mem.h"
+#include "rng.h"
+#include "pool.h"
+
+//largest mantissa and powers of ten that are exact in a double.
+#define NUM_MANTISSA (1ULL << 53)
+#define NUM_DIGITS 19
+#define NUM_POWERS 22
+
+//fewest rows read by each thread of ginfo.
+#define GINFO_ROWS 65536
+
+static const double numpowers[NUM_POWERS + 1] = { 1e0, 1e1, 1e2, 1e3, 1e4,
+		1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16,
+		1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+static Grid* gtokenize(char* raw, char d, size_t* rowsOut, size_t* colsOut,
+		size_t* bytes);
+static size_t numslow(const char* str, size_t length, double* dest);
+static size_t mapwidth(Mapper* mapper, size_t* missing, size_t j);
+static size_t mtrcell(Mapper* mapper, GridInfo* info, size_t j, size_t left,
+		char* val, float* dest);
+static float mtrstd(GridInfo* info, size_t j, double x);
+struct ColStats;
+static short* ginfotypes(Grid* g, size_t rows, size_t cols);
+static void inforows(void* arg);
+static void colscan(Grid* g, short word, size_t j, size_t from, size_t to,
+		struct ColStats* st);
+static void colmerge(struct ColStats* into, struct ColStats* from);
+static void gparsedfree(Grid* g, size_t cols);
+static int gselect(size_t width, size_t** sourceOut, size_t* colsOut);
+
+//distinct values above which a word column is hashed, 0 never hashes.
+size_t maphashabove = 1000;
+//matrix columns of a hashed column.
+size_t mapbuckets = 256;
+//rows the column types are inferred from, 0 reads every row.
+size_t ginfosample = 1000;
+//file columns kept by gcreate, 0 based. gfeatures NULL keeps every column
+//but the target, and gtarget -1 takes the last column as the target.
+size_t* gfeatures = NULL;
+size_t gfeaturecount = 0;
+ssize_t gtarget = -1;
 
 
 /*
@@ -38,145 +84,196 @@ unsigned int lowercmp(char* str, char* other) {
 }
 
 /*
- * Shuffles the rows of a given matrix.
+ * Shuffles the rows of a given matrix. No row is moved, the new order is
+ * kept in matrix->perm and the rows are gathered in that order when the
+ * matrix is copied.
  */
 void mtrshuffle(Matrix* matrix) {
 
-	float* values = matrix->values;
+	profbegin("shuffle");
 	size_t m = matrix->m;
-	size_t n = matrix->n;
-
-	float* buffer = malloc(sizeof(float) * n);
-	for (size_t i = 0; i < m; i++) {
-		size_t idxTo = (size_t) ((m - 1) * (rand() / (double) RAND_MAX));
-		mtrswap(values, n, buffer, i, idxTo);
-	}
-	free(buffer);
-}
-
-
-/*
- * Swaps two rows.
- */
-void mtrswap(float* values, size_t n, float* buffer, size_t idxFrom,
-		size_t idxTo) {
-	if (idxFrom == idxTo) {
-		return;
-	}
-
-	//first copies the row at idxTo row in to a buffer.
-	for (size_t j = 0; j < n; j++) {
-		buffer[j] = values[idxTo * n + j];
-	}
-
-	//then writes the values of the row at idxFrom to the row at idxTo
-	for (size_t j = 0; j < n; j++) {
-		values[idxTo * n + j] = values[idxFrom * n + j];
-	}
-
-	//and last, writes the values of the buffer to the row at idxFrom
-	for (size_t j = 0; j < n; j++) {
-		values[idxFrom * n + j] = buffer[j];
+	if (matrix->perm == NULL) {
+		matrix->perm = memalloc(MEM_MATRIX, sizeof(size_t) * m);
+		rngperm(rngthread(), matrix->perm, m);
+	} else {
+		rngshuffle(rngthread(), matrix->perm, m);
 	}
+	profend();
 }
 
 Matrix* mtrcreate(Grid* g, Mapper* mapper) {
 
+	profbegin("matrix");
 	size_t m = g->info->rows;
-
-	size_t* missing = g->info->missing;
-
-	size_t* sizes = mapper->sizes;
-	char*** map = mapper->map;
-
 	size_t cols = mapper->cols;
 
-	size_t n = mtrcols(map, sizes, missing, cols);
+	size_t* offsets = mtroffsets(mapper, g->info->missing);
+	size_t n = offsets[cols];
 
 	Matrix* matrix = mtrnew(m, n);
 	float* values = matrix->values;
 
-	size_t rows = g->info->rows;
+	//number columns are read from the values parsed by ginfo, so each
+	//cell is only parsed once.
+	GridInfo* info = g->info;
+	float** parsed = g->parsed;
 	char*** body = g->body;
-	for (size_t i = 0; i < rows; i++) {
+	for (size_t i = 0; i < m; i++) {
+		float* dest = values + i * n;
+		size_t unknown = 0;
 		for (size_t j = 0; j < cols; j++) {
-			char* val = body[i][j];
-			size_t mtrcol = tomtrcol(map, sizes, missing, j, val);
-			if (mtrcol == -1) {
-				fprintf(stderr, "Could not create Matrix");
-				fflush(stderr);
-				return NULL;
+			size_t left = offsets[j];
+			if (parsed == NULL || parsed[j] == NULL || mapper->map[j]
+					|| mapper->buckets[j]) {
+				unknown += mtrcell(mapper, info, j, left, body[i][j], dest);
+				continue;
 			}
 
-			size_t words = g->info->words[j];
-			if (val == NULL || words > 0) {
-				values[i * n + mtrcol] = 1;
+			float x = parsed[j][i];
+			if (isnan(x)) {
+				dest[left] = 1;
 			} else {
-				float mean = g->info->mean[j];
-				float stdev = g->info->stdev[j];
-
-				float v = (atof(val) - mean) / stdev;
-				values[i * n + mtrcol] = v;
+				size_t idx = info->missing[j] > 0 ? left + 1 : left;
+				dest[idx] = mtrstd(info, j, x);
 			}
 		}
+
+		if (unknown > 0) {
+			fprintf(stderr, "Could not create Matrix");
+			fflush(stderr);
+			free(offsets);
+			mtrfree(matrix);
+			profend();
+			return NULL;
+		}
 	}
 
+	free(offsets);
+	profend();
 	return matrix;
 }
 
-void fillstdev(GridInfo* info, Grid* g) {
+/*
+ * Encodes the first cols values of a grid row in to dest, with the same
+ * layout used by mtrcreate: word columns are one-hot encoded and number
+ * columns are standardized with the mean and stdev of the GridInfo. The
+ * offsets parameter must be the array returned by mtroffsets.
+ *
+ * Values that can not be encoded (words that are not part of the mapper, or
+ * words in a number column) are left as 0 and counted in the returned value.
+ */
+size_t mtrrow(Mapper* mapper, GridInfo* info, size_t* offsets, char** row,
+		size_t cols, float* dest) {
+
+	size_t unknown = 0;
+	for (size_t j = 0; j < cols; j++) {
+		size_t left = offsets[j];
+		size_t right = offsets[j + 1];
+		for (size_t k = left; k < right; k++) {
+			dest[k] = 0;
+		}
+
+		unknown += mtrcell(mapper, info, j, left, row[j], dest);
+	}
 
-	size_t cols = info->columns;
-	float* means = info->mean;
-	float* stdevs = info->stdev;
+	return unknown;
+}
 
-	for (size_t i = 0; i < cols; i++) {
-		float mean;
-		float stdev;
-		onlinestdev(info, g, i, &mean, &stdev);
-		means[i] = mean;
-		stdevs[i] = stdev;
+/*
+ * Encodes the value of the column j, whose first matrix column is left, in
+ * to dest, which must be zero in the columns of j. Returns 1 if the value
+ * can not be encoded, and 0 otherwise.
+ */
+static size_t mtrcell(Mapper* mapper, GridInfo* info, size_t j, size_t left,
+		char* val, float* dest) {
+	size_t unknown = 0;
+	if (mapper->buckets[j]) {
+		float sign;
+		size_t idx = maphash(val, mapper->buckets[j], &sign);
+		dest[left + idx] = sign;
+	} else if (mapper->map[j]) {
+		ssize_t idx = mapidx(mapper, j, val);
+		if (idx == -1) {
+			unknown++;
+		} else {
+			dest[left + idx] = 1;
+		}
+	} else if (val == NULL) {
+		if (info->missing[j] > 0) {
+			dest[left] = 1;
+		} else {
+			unknown++;
+		}
+	} else {
+		double x;
+		if (numparse(val, -1, &x) == 0) {
+			unknown++;
+		} else {
+			size_t idx = info->missing[j] > 0 ? left + 1 : left;
+			dest[idx] = mtrstd(info, j, x);
+		}
 	}
+
+	return unknown;
 }
 
-void onlinestdev(GridInfo* info, Grid* g, size_t col, float* mean, float* stdev) {
+/*
+ * Standardizes a value of the number column j. A column with a single value
+ * is 0 everywhere instead of 0 / 0.
+ */
+static float mtrstd(GridInfo* info, size_t j, double x) {
+	float stdev = info->stdev[j];
+	return stdev > 0 ? (x - info->mean[j]) / stdev : 0;
+}
 
-	size_t m = info->rows;
-	if (m < 2 || info->words[col] > 0) {
-		*mean = NAN;
-		*stdev = NAN;
-		return;
-	}
+/*
+ * Returns an array with cols + 1 values, where the j-th value is the first
+ * matrix column of the grid column j, and the last value is the total
+ * number of matrix columns.
+ */
+size_t* mtroffsets(Mapper* mapper, size_t* missing) {
+	size_t cols = mapper->cols;
+	size_t* offsets = malloc(sizeof(size_t) * (cols + 1));
 
-	char*** body = g->body;
+	offsets[0] = 0;
+	for (size_t j = 0; j < cols; j++) {
+		offsets[j + 1] = offsets[j] + mapwidth(mapper, missing, j);
+	}
 
-	double n = 0;
-	double _mean = 0.0;
-	double m2 = 0.0;
-	for (size_t i = 0; i < m; i++) {
-		char* val = body[i][col];
+	return offsets;
+}
 
-		char* tailptr;
-		double x = strtod(val, &tailptr);
-		if (val == tailptr) {
-			//not a number
-		} else {
+/*
+ * Returns the index of the value in the dictionary of the given column, or
+ * -1 if the value is not part of it.
+ */
+ssize_t mapidx(Mapper* mapper, size_t col, char* val) {
+	char** words = mapper->map[col];
+	size_t l = mapper->sizes[col];
+	for (size_t i = 0; i < l; i++) {
+		char* crt = words[i];
 
-			n++;
+		if (crt == NULL && val == NULL) {
+			return i;
+		}
 
-			double delta = x - _mean;
-			_mean += delta / n;
-			m2 += delta * (x - _mean);
+		if ((crt != NULL && val != NULL) && strcmp(crt, val) == 0) {
+			return i;
 		}
 	}
 
-	*mean = (float) _mean;
-	*stdev = (float) m2 / (n - 1);
+	return -1;
 }
 
-size_t tomtrcol(char*** map, size_t* sizes, size_t* missing, size_t col,
-		char* val) {
-	size_t left = mtrcols(map, sizes, missing, col);
+size_t tomtrcol(Mapper* mapper, size_t* missing, size_t col, char* val) {
+	char*** map = mapper->map;
+	size_t* sizes = mapper->sizes;
+	size_t left = mtrcols(mapper, missing, col);
+	if (mapper->buckets[col]) {
+		float sign;
+		return left + maphash(val, mapper->buckets[col], &sign);
+	}
+
 	if (map[col] == NULL) {
 		if (missing[col] == 0) {
 			return left;
@@ -208,35 +305,75 @@ size_t tomtrcol(char*** map, size_t* sizes, size_t* missing, size_t col,
 	return -1;
 }
 
-size_t mtrcols(char*** map, size_t* sizes, size_t* missing, size_t col) {
+size_t mtrcols(Mapper* mapper, size_t* missing, size_t col) {
 	size_t n = 0;
 	for (size_t j = 0; j < col; j++) {
-		if (map[j] == NULL) {
-			//numeric type
-			if (missing[j] == 0) {
-				n++;
-			} else {
-				n += 2;
-			}
-		} else {
-			n += sizes[j];
-		}
+		n += mapwidth(mapper, missing, j);
 	}
 	return n;
 }
 
+/*
+ * Number of matrix columns of the grid column j.
+ */
+static size_t mapwidth(Mapper* mapper, size_t* missing, size_t j) {
+	if (mapper->buckets[j]) {
+		return mapper->buckets[j];
+	}
+
+	if (mapper->map[j]) {
+		return mapper->sizes[j];
+	}
+
+	//numeric type, with a flag column when there are missing values.
+	return missing[j] == 0 ? 1 : 2;
+}
+
+/*
+ * Returns the bucket of a value of a hashed column, and its sign in sign.
+ * The sign is taken from another bit of the hash, so two words that share
+ * a bucket cancel out on average instead of adding up. A blank value is
+ * hashed as an empty word.
+ */
+size_t maphash(char* val, size_t buckets, float* sign) {
+	uint64_t hash = strhash(val);
+	*sign = hash >> 63 ? -1 : 1;
+	return (hash & INT64_MAX) % buckets;
+}
+
+/*
+ * 64 bits FNV-1a hash of a string, NULL hashes as an empty string.
+ */
+uint64_t strhash(char* val) {
+	uint64_t hash = UINT64_C(14695981039346656037);
+	for (char* p = val; p && *p; p++) {
+		hash ^= (unsigned char) *p;
+		hash *= UINT64_C(1099511628211);
+	}
+	return hash;
+}
+
 Mapper* mapcreate(Grid* g) {
 
+	profbegin("map");
 	size_t n = g->info->columns;
 
-	size_t* sizes = calloc(n, sizeof(size_t));
-	char*** map = calloc(n, sizeof(char**));
+	size_t* sizes = memcalloc(MEM_MAPPER, n, sizeof(size_t));
+	char*** map = memcalloc(MEM_MAPPER, n, sizeof(char**));
+	size_t* buckets = memcalloc(MEM_MAPPER, n, sizeof(size_t));
 
 	for (size_t j = 0; j < n; j++) {
 		size_t numbers = g->info->numbers[j];
 		size_t words = g->info->words[j];
 
-		if (numbers == 0 && words == 0) {
+		if (words > 0 && j + 1 < n && maphashabove > 0
+				&& ginfodistinct(g->info, j) > maphashabove) {
+			//too many values for a dictionary. The y column always keeps
+			//its dictionary, since its values name the models.
+			sizes[j] = 0;
+			map[j] = NULL;
+			buckets[j] = mapbuckets;
+		} else if (numbers == 0 && words == 0) {
 			//empty column
 			sizes[j] = 0;
 			map[j] = NULL;
@@ -260,11 +397,19 @@ Mapper* mapcreate(Grid* g) {
 		}
 	}
 
-	Mapper* mapper = malloc(sizeof(Mapper));
+	Mapper* mapper = memalloc(MEM_MAPPER, sizeof(Mapper));
 	mapper->cols = n;
 	mapper->sizes = sizes;
 	mapper->map = map;
+	mapper->buckets = buckets;
+	mapper->source = NULL;
+	mapper->width = g->width;
+	if (g->source) {
+		mapper->source = memalloc(MEM_MAPPER, sizeof(size_t) * n);
+		memcpy(mapper->source, g->source, sizeof(size_t) * n);
+	}
 
+	profend();
 	return mapper;
 }
 
@@ -278,85 +423,404 @@ void mapfree(Mapper* mapper) {
 			for (size_t i = 0; i < cols; i++) {
 				size_t size = sizes[i];
 				for (size_t j = 0; j < size; j++) {
-					free(map[i][j]);
+					memfree(MEM_MAPPER, map[i][j]);
 				}
-				free(map[i]);
+				memfree(MEM_MAPPER, map[i]);
 			}
+			memfree(MEM_MAPPER, map);
 		}
 
 		if (sizes) {
-			free(sizes);
+			memfree(MEM_MAPPER, sizes);
+		}
+
+		memfree(MEM_MAPPER, mapper->buckets);
+		memfree(MEM_MAPPER, mapper->source);
+
+		memfree(MEM_MAPPER, mapper);
+	}
+}
+
+/*
+ * Creates a copy of the mapper that owns all its words, so it can be
+ * extended and released with mapfree.
+ */
+Mapper* mapcopy(Mapper* mapper) {
+	size_t n = mapper->cols;
+
+	Mapper* copy = memalloc(MEM_MAPPER, sizeof(Mapper));
+	copy->cols = n;
+	copy->sizes = memalloc(MEM_MAPPER, sizeof(size_t) * n);
+	copy->map = memcalloc(MEM_MAPPER, n, sizeof(char**));
+	copy->buckets = memalloc(MEM_MAPPER, sizeof(size_t) * n);
+	memcpy(copy->buckets, mapper->buckets, sizeof(size_t) * n);
+	copy->source = NULL;
+	copy->width = mapper->width;
+	if (mapper->source) {
+		copy->source = memalloc(MEM_MAPPER, sizeof(size_t) * n);
+		memcpy(copy->source, mapper->source, sizeof(size_t) * n);
+	}
+
+	for (size_t j = 0; j < n; j++) {
+		size_t size = mapper->map[j] ? mapper->sizes[j] : 0;
+		copy->sizes[j] = size;
+		if (mapper->map[j] == NULL) {
+			continue;
 		}
 
-		free(mapper);
+		copy->map[j] = memalloc(MEM_MAPPER, sizeof(char*) * size);
+		for (size_t i = 0; i < size; i++) {
+			char* word = mapper->map[j][i];
+			if (word) {
+				copy->map[j][i] = memalloc(MEM_MAPPER, strlen(word) + 1);
+				strcpy(copy->map[j][i], word);
+			} else {
+				copy->map[j][i] = NULL;
+			}
+		}
 	}
+
+	return copy;
 }
 
+/*
+ * Statistics of a column over a range of rows. Ranges read by different
+ * threads are merged with colmerge.
+ */
+typedef struct ColStats{
+	size_t missing;
+	size_t numbers;
+	size_t words;
+	size_t integers;
+	float max;
+	float min;
+	double n;
+	double mean;
+	double m2;
+	short contradicted;
+	Kll* kll;
+	Hll* hll;
+}ColStats;
+
+/*
+ * Rows of the grid read by each task of ginfo.
+ */
+typedef struct InfoTask{
+	Grid* g;
+	short* word;
+	size_t from;
+	size_t to;
+	size_t cols;
+	ColStats* stats;
+}InfoTask;
+
+/*
+ * Computes the statistics of every column in a single pass over the grid.
+ * The type of each column is inferred first from ginfosample rows spread
+ * over the grid, so the pass parses every cell only once: a number column
+ * gets its range, mean, variance and quantile sketch, and keeps its parsed
+ * values in g->parsed for mtrcreate, while a word column gets its counts
+ * and distinct count sketch. A word found in a column inferred as numbers
+ * stops that column, and only that column is read again as words.
+ *
+ * Large grids are split in row ranges read by different threads, and the
+ * statistics of the ranges are merged in order.
+ */
 GridInfo* ginfo(Grid* g, size_t rows, size_t cols) {
 
+	profbegin("stats");
+
+	GridInfo* info = memalloc(MEM_INFO, sizeof(GridInfo));
+	info->max = memalloc(MEM_INFO, sizeof(float) * cols);
+	info->min = memalloc(MEM_INFO, sizeof(float) * cols);
+	info->mean = memalloc(MEM_INFO, sizeof(float) * cols);
+	info->stdev = memalloc(MEM_INFO, sizeof(float) * cols);
+	info->discrete = memalloc(MEM_INFO, sizeof(short) * cols);
+	info->missing = memalloc(MEM_INFO, sizeof(size_t) * cols);
+	info->numbers = memalloc(MEM_INFO, sizeof(size_t) * cols);
+	info->words = memalloc(MEM_INFO, sizeof(size_t) * cols);
+	info->quantiles = memcalloc(MEM_INFO, cols, sizeof(Kll*));
+	info->distinct = memcalloc(MEM_INFO, cols, sizeof(Hll*));
+
+	short* word = ginfotypes(g, rows, cols);
+
+	gparsedfree(g, cols);
+	g->parsed = memcalloc(MEM_GRID, cols, sizeof(float*));
+	for (size_t j = 0; j < cols; j++) {
+		if (!word[j]) {
+			g->parsed[j] = memalloc(MEM_GRID, sizeof(float) * rows);
+		}
+	}
+
+	size_t tasks = rows / GINFO_ROWS;
+	size_t cpus = cpucount();
+	tasks = tasks > cpus ? cpus : tasks;
+	tasks = tasks < 1 ? 1 : tasks;
+
+	InfoTask* list = memalloc(MEM_SCRATCH, sizeof(InfoTask) * tasks);
+	for (size_t t = 0; t < tasks; t++) {
+		InfoTask* task = list + t;
+		task->g = g;
+		task->word = word;
+		task->from = rows * t / tasks;
+		task->to = rows * (t + 1) / tasks;
+		task->cols = cols;
+		task->stats = memalloc(MEM_SCRATCH, sizeof(ColStats) * cols);
+	}
+
+	if (tasks == 1) {
+		inforows(list);
+	} else {
+		Pool* pool = poolnew(tasks);
+		for (size_t t = 0; t < tasks; t++) {
+			poolsubmit(pool, inforows, list + t);
+		}
+		poolwait(pool);
+		poolfree(pool);
+	}
+
+	ColStats* stats = list[0].stats;
+	for (size_t t = 1; t < tasks; t++) {
+		for (size_t j = 0; j < cols; j++) {
+			colmerge(&stats[j], &list[t].stats[j]);
+		}
+		memfree(MEM_SCRATCH, list[t].stats);
+	}
+
+	for (size_t j = 0; j < cols; j++) {
+		ColStats* st = &stats[j];
+		if (st->contradicted) {
+			//the sample missed the words of this column.
+			kllfree(st->kll);
+			memfree(MEM_GRID, g->parsed[j]);
+			g->parsed[j] = NULL;
+			word[j] = 1;
+			colscan(g, 1, j, 0, rows, st);
+			profcount(PROF_REENCODED, 1);
+		}
+
+		info->missing[j] = st->missing;
+		info->numbers[j] = st->numbers;
+		info->words[j] = st->words;
+		info->discrete[j] = st->numbers > 0 && st->integers == st->numbers;
+		info->max[j] = st->max;
+		info->min[j] = st->min;
+
+		if (rows < 2 || st->words > 0) {
+			info->mean[j] = NAN;
+			info->stdev[j] = NAN;
+		} else {
+			//the stdev field holds the variance.
+			info->mean[j] = (float) st->mean;
+			info->stdev[j] = (float) st->m2 / (st->n - 1);
+		}
+
+		if (st->numbers == 0) {
+			kllfree(st->kll);
+			st->kll = NULL;
+		}
+		info->quantiles[j] = st->kll;
+		info->distinct[j] = st->hll;
+	}
+
+	info->rows = rows;
+	info->columns = cols;
+
+	memfree(MEM_SCRATCH, stats);
+	memfree(MEM_SCRATCH, list);
+	memfree(MEM_SCRATCH, word);
+
+	profend();
+	return info;
+}
+
+/*
+ * Infers which columns hold words from ginfosample rows spread evenly over
+ * the grid, or from every row when ginfosample is 0 or more than the rows.
+ * Returns an array with 1 for the word columns.
+ */
+static short* ginfotypes(Grid* g, size_t rows, size_t cols) {
+	size_t sample = rows;
+	if (ginfosample > 0 && ginfosample < rows) {
+		sample = ginfosample;
+	}
+
+	short* word = memcalloc(MEM_SCRATCH, cols, sizeof(short));
+	for (size_t s = 0; s < sample; s++) {
+		char** row = g->body[s * rows / sample];
+		for (size_t j = 0; j < cols; j++) {
+			double x;
+			if (!word[j] && row[j] && numparse(row[j], -1, &x) == 0) {
+				word[j] = 1;
+			}
+		}
+	}
+
+	return word;
+}
+
+/*
+ * Task of ginfo, reads every column of its rows.
+ */
+static void inforows(void* arg) {
+	InfoTask* task = arg;
+	for (size_t j = 0; j < task->cols; j++) {
+		colscan(task->g, task->word[j], j, task->from, task->to,
+				&task->stats[j]);
+	}
+}
+
+/*
+ * Statistics of the column j over the rows [from, to). A word column gets a
+ * distinct count sketch of all its values, blanks included, since each of
+ * them would be a value of its dictionary. A number column stops at the
+ * first word, and marks the statistics as contradicted.
+ */
+static void colscan(Grid* g, short word, size_t j, size_t from, size_t to,
+		ColStats* st) {
 	char*** body = g->body;
 
-	GridInfo* info = malloc(sizeof(GridInfo));
-	info->max = malloc(sizeof(float) * cols);
-	info->min = malloc(sizeof(float) * cols);
-	info->mean = malloc(sizeof(float) * cols);
-	info->stdev = malloc(sizeof(float) * cols);
-	info->discrete = malloc(sizeof(short) * cols);
-	info->missing = malloc(sizeof(size_t) * cols);
-	info->numbers = malloc(sizeof(size_t) * cols);
-	info->words = malloc(sizeof(size_t) * cols);
-
-	for (int j = 0; j < cols; j++) {
-		short discrete;
-		float max = NAN;
-		float min = NAN;
-		size_t missing = 0;
-		size_t numbers = 0;
-		size_t words = 0;
-
-		size_t discreteCount = 0;
-		for (int i = 0; i < rows; i++) {
+	memset(st, 0, sizeof(ColStats));
+	st->max = NAN;
+	st->min = NAN;
+
+	if (word) {
+		st->hll = hllnew();
+		for (size_t i = from; i < to; i++) {
 			char* val = body[i][j];
+			hlladd(st->hll, strhash(val));
+
+			double x;
 			if (val == NULL) {
-				missing++;
+				st->missing++;
+			} else if (numparse(val, -1, &x) == 0) {
+				st->words++;
 			} else {
-				char* end;
-				float num = strtof(val, &end);
-				if (val == end) {
-					//not a number
-					words++;
-				} else {
-					if (ceil(num) == num) {
-						discreteCount++;
-					}
-					max = higher(max, num);
-					min = lower(min, num);
-					numbers++;
-				}
+				st->max = higher(st->max, (float) x);
+				st->min = lower(st->min, (float) x);
+				st->numbers++;
 			}
 		}
+		return;
+	}
 
-		if (numbers > 0) {
-			discrete = discreteCount == numbers;
+	float* parsed = g->parsed[j];
+	st->kll = kllnew(KLL_K);
+	for (size_t i = from; i < to; i++) {
+		char* val = body[i][j];
+		if (val == NULL) {
+			st->missing++;
+			parsed[i] = NAN;
+			continue;
 		}
 
-		info->discrete[j] = discrete;
-		info->max[j] = max;
-		info->min[j] = min;
-		info->missing[j] = missing;
-		info->numbers[j] = numbers;
-		info->words[j] = words;
+		double x;
+		if (numparse(val, -1, &x) == 0) {
+			st->contradicted = 1;
+			return;
+		}
 
+		float num = (float) x;
+		parsed[i] = num;
+		if (ceil(num) == num) {
+			st->integers++;
+		}
+		st->max = higher(st->max, num);
+		st->min = lower(st->min, num);
+		st->numbers++;
+		klladd(st->kll, num);
+
+		st->n++;
+		double delta = x - st->mean;
+		st->mean += delta / st->n;
+		st->m2 += delta * (x - st->mean);
 	}
-	info->rows = rows;
-	info->columns = cols;
+}
 
-	fillstdev(info, g);
+/*
+ * Adds the statistics of the rows that follow the ones of into, and
+ * releases the sketches of from.
+ */
+static void colmerge(ColStats* into, ColStats* from) {
+	into->missing += from->missing;
+	into->numbers += from->numbers;
+	into->words += from->words;
+	into->integers += from->integers;
+	into->max = higher(into->max, from->max);
+	into->min = lower(into->min, from->min);
+	into->contradicted |= from->contradicted;
+
+	//Chan's parallel form of Welford's algorithm.
+	double n = into->n + from->n;
+	if (n > 0) {
+		double delta = from->mean - into->mean;
+		into->mean += delta * from->n / n;
+		into->m2 += from->m2 + delta * delta * into->n * from->n / n;
+		into->n = n;
+	}
 
-	return info;
+	if (from->kll) {
+		kllmerge(into->kll, from->kll);
+		kllfree(from->kll);
+	}
+
+	if (from->hll) {
+		hllmerge(into->hll, from->hll);
+		hllfree(from->hll);
+	}
+}
+
+/*
+ * Releases the parsed values of the grid.
+ */
+static void gparsedfree(Grid* g, size_t cols) {
+	if (g->parsed) {
+		for (size_t j = 0; j < cols; j++) {
+			memfree(MEM_GRID, g->parsed[j]);
+		}
+		memfree(MEM_GRID, g->parsed);
+		g->parsed = NULL;
+	}
+}
+
+/*
+ * Estimated number of distinct values of a column with words, blanks
+ * count as a value. Returns 0 when the column has no sketch.
+ */
+double ginfodistinct(GridInfo* info, size_t col) {
+	if (info->distinct == NULL || info->distinct[col] == NULL) {
+		return 0;
+	}
+
+	return hllcount(info->distinct[col]);
 }
 
+/*
+ * Splits the raw content in rows (by '\n') and columns (by d), and computes
+ * the GridInfo of the result. Blank values are stored as NULL.
+ */
 Grid* gcreate(char* raw, char d) {
+	size_t rows;
+	size_t cols;
+	size_t bytes;
+
+	profbegin("tokenize");
+	Grid* g = gtokenize(raw, d, &rows, &cols, &bytes);
+	profend();
+	if (g == NULL) {
+		return NULL;
+	}
+
+	profcount(PROF_BYTES_PARSED, bytes);
+	profcount(PROF_ROWS, rows);
+
+	g->info = ginfo(g, rows, cols);
+
+	return g;
+}
+
+static Grid* gtokenize(char* raw, char d, size_t* rowsOut, size_t* colsOut,
+		size_t* bytes) {
 	ssize_t lines = cfind(raw, '\n');
 	if (lines == -1) {
 		fflush(stdout);
@@ -365,15 +829,36 @@ Grid* gcreate(char* raw, char d) {
 		return NULL;
 	}
 
-	size_t cols = ccount(raw, lines, d);
+	size_t width = ccount(raw, lines, d);
 	size_t rows = ccount(raw, -1, '\n');
-	cols++;
+	width++;
 	rows++;
-	
+
+	//slot[f] is the grid column of the file column f, or -1 when the
+	//column is skipped without even being copied.
+	size_t* source;
+	size_t cols;
+	if (gselect(width, &source, &cols) == -1) {
+		return NULL;
+	}
+
+	ssize_t* slot = NULL;
+	if (source) {
+		slot = memalloc(MEM_SCRATCH, sizeof(ssize_t) * width);
+		for (size_t f = 0; f < width; f++) {
+			slot[f] = -1;
+		}
+		for (size_t j = 0; j < cols; j++) {
+			slot[source[j]] = j;
+		}
+	}
+
 	if (cols < 2) {
 		fflush(stdout);
 		fprintf(stderr, "Error creating Grid. Less than 2 columns.");
 		fflush(stderr);
+		memfree(MEM_GRID, source);
+		memfree(MEM_SCRATCH, slot);
 		return NULL;
 	}
 
@@ -381,23 +866,28 @@ Grid* gcreate(char* raw, char d) {
 		fflush(stdout);
 		fprintf(stderr, "Error creating Grid. Less than 10 rows.");
 		fflush(stderr);
+		memfree(MEM_GRID, source);
+		memfree(MEM_SCRATCH, slot);
 		return NULL;
 	}
 
-	Grid* g = malloc(sizeof(Grid));
+	Grid* g = memalloc(MEM_GRID, sizeof(Grid));
 	g->info = NULL;
-	char*** body = calloc(rows, sizeof(char**));
+	g->parsed = NULL;
+	g->source = source;
+	g->width = width;
+	char*** body = memcalloc(MEM_GRID, rows, sizeof(char**));
 	g->body = body;
 
 	size_t start = 0;
 	char* p = raw;
 	for (int i = 0; i < rows; i++) {
-		char** row = calloc(cols, sizeof(char*));
+		char** row = memcalloc(MEM_GRID, cols, sizeof(char*));
 
-		for (int j = 0; j < cols; j++) {
+		for (int f = 0; f < width; f++) {
 			p = p + start;
 
-			if (p[0] == '\n' && j == 0) {
+			if (p[0] == '\n' && f == 0) {
 				//at this point there is an empty line.
 				//we are going to stop there
 
@@ -405,12 +895,13 @@ Grid* gcreate(char* raw, char d) {
 				fprintf(stderr, "\nBlank line detected at line %d.\n", (i + 1));
 				fflush(stderr);
 				gpartialfree(g, i - 1, cols);
-				free(row);
+				memfree(MEM_GRID, row);
+				memfree(MEM_SCRATCH, slot);
 				return NULL;
 			}
 
 			ssize_t l;
-			if (j + 1 < cols) {
+			if (f + 1 < width) {
 				l = cfind(p, d);
 			} else if (i + 1 < rows) {
 				l = cfind(p, '\n');
@@ -421,23 +912,30 @@ Grid* gcreate(char* raw, char d) {
 			if (l == -1) {
 				fflush(stdout);
 				fprintf(stderr, "\nInvalid row. Row %d, detected at col %d.\n",
-						(i + 1), (j + 1));
+						(i + 1), (f + 1));
 				fflush(stderr);
 				gpartialfree(g, i - 1, cols);
-				free(row);
+				memfree(MEM_GRID, row);
+				memfree(MEM_SCRATCH, slot);
 				return NULL;
 			}
 
+			ssize_t j = slot ? slot[f] : f;
+			start = l + 1;
+			if (j == -1) {
+				continue;
+			}
+
 			size_t tl = triml(p, l);
 			if (tl > 0) {
-				char* col = cnew(tl);
+				char* col = memalloc(MEM_GRID, tl + 1);
+				col[tl] = '\0';
 				trim(p, l, col, tl);
 
 				row[j] = col;
 			} else {
 				row[j] = NULL;
 			}
-			start = l + 1;
 		}
 
 		size_t allNull = 1;
@@ -455,18 +953,192 @@ Grid* gcreate(char* raw, char d) {
 					(i + 1));
 			fflush(stderr);
 			gpartialfree(g, i - 1, cols);
-			free(row);
+			memfree(MEM_GRID, row);
+			memfree(MEM_SCRATCH, slot);
 			return NULL;
 		}
 
 		body[i] = row;
 	}
+	memfree(MEM_SCRATCH, slot);
 
-	g->info = ginfo(g, rows, cols);
-
+	*rowsOut = rows;
+	*colsOut = cols;
+	*bytes = (p + start - 1) - raw;
 	return g;
 }
 
+/*
+ * Splits a single line in place, replacing the delimiters with '\0' and
+ * trimming the spaces of each value, the same way gcreate does. Blank
+ * values are stored as NULL. At most cols values are stored in cells and
+ * the number of values found in the line is returned.
+ */
+size_t rowsplit(char* line, size_t length, char d, char** cells, size_t cols) {
+
+	if (length > 0 && line[length - 1] == '\r') {
+		length--;
+	}
+
+	size_t found = 0;
+	size_t start = 0;
+	for (size_t i = 0; i <= length; i++) {
+		if (i < length && line[i] != d) {
+			continue;
+		}
+
+		size_t left = start;
+		size_t right = i;
+		while (left < right && line[left] == ' ') {
+			left++;
+		}
+		while (right > left && line[right - 1] == ' ') {
+			right--;
+		}
+
+		if (found < cols) {
+			if (right > left) {
+				line[right] = '\0';
+				cells[found] = line + left;
+			} else {
+				cells[found] = NULL;
+			}
+		}
+
+		found++;
+		start = i + 1;
+	}
+
+	return found;
+}
+
+/*
+ * Picks the columns of the mapper from the found values of a line split
+ * with rowsplit, in to cells, which must have room for mapper->cols
+ * pointers. Columns past the end of the line are NULL. Returns the number
+ * of columns of the mapper that the line has.
+ */
+size_t rowpick(Mapper* mapper, char** split, size_t found, char** cells) {
+	size_t cols = mapper->cols;
+	size_t have = 0;
+	for (size_t j = 0; j < cols; j++) {
+		size_t f = mapper->source ? mapper->source[j] : j;
+		if (f < found) {
+			cells[j] = split[f];
+			have++;
+		} else {
+			cells[j] = NULL;
+		}
+	}
+
+	return have;
+}
+
+/*
+ * Parses a list of 1 based column numbers and ranges, like "1,4-6", in to
+ * an array of 0 based columns. Returns NULL if the list is not valid.
+ */
+size_t* colparse(char* list, size_t* count) {
+	size_t cap = 16;
+	size_t n = 0;
+	size_t* cols = malloc(sizeof(size_t) * cap);
+
+	char* p = list;
+	while (1) {
+		char* end;
+		size_t from = strtoul(p, &end, 10);
+		size_t to = from;
+		if (end != p && *end == '-') {
+			p = end + 1;
+			to = strtoul(p, &end, 10);
+		}
+
+		if (end == p || from == 0 || to < from || (*end != ',' && *end)) {
+			fflush(stdout);
+			fprintf(stderr, "Invalid column list '%s'.\n", list);
+			fflush(stderr);
+			free(cols);
+			return NULL;
+		}
+
+		for (size_t c = from; c <= to; c++) {
+			if (n == cap) {
+				cap *= 2;
+				cols = realloc(cols, sizeof(size_t) * cap);
+			}
+			cols[n++] = c - 1;
+		}
+
+		if (*end == '\0') {
+			break;
+		}
+		p = end + 1;
+	}
+
+	*count = n;
+	return cols;
+}
+
+/*
+ * Resolves gfeatures and gtarget for a file of width columns. The target
+ * goes last, after the features in the order they were given. sourceOut is
+ * set to NULL when every column is kept in the order of the file. Returns
+ * -1 if a column is out of the file, repeated, or both a feature and the
+ * target.
+ */
+static int gselect(size_t width, size_t** sourceOut, size_t* colsOut) {
+	*sourceOut = NULL;
+	*colsOut = width;
+	if (gfeatures == NULL && gtarget == -1) {
+		return 0;
+	}
+
+	size_t target = gtarget == -1 ? width - 1 : (size_t) gtarget;
+	if (target >= width) {
+		fflush(stdout);
+		fprintf(stderr, "Column %zu is not in the file.\n", target + 1);
+		fflush(stderr);
+		return -1;
+	}
+
+	size_t cols = gfeatures ? gfeaturecount + 1 : width;
+	size_t* source = memalloc(MEM_GRID, sizeof(size_t) * cols);
+	short* used = memcalloc(MEM_SCRATCH, width, sizeof(short));
+
+	size_t j = 0;
+	if (gfeatures) {
+		for (size_t k = 0; k < gfeaturecount; k++) {
+			source[j++] = gfeatures[k];
+		}
+	} else {
+		for (size_t f = 0; f < width; f++) {
+			if (f != target) {
+				source[j++] = f;
+			}
+		}
+	}
+	source[j] = target;
+
+	for (j = 0; j < cols; j++) {
+		size_t f = source[j];
+		if (f >= width || used[f]) {
+			fflush(stdout);
+			fprintf(stderr, "Column %zu is %s.\n", f + 1,
+					f >= width ? "not in the file" : "selected twice");
+			fflush(stderr);
+			memfree(MEM_GRID, source);
+			memfree(MEM_SCRATCH, used);
+			return -1;
+		}
+		used[f] = 1;
+	}
+	memfree(MEM_SCRATCH, used);
+
+	*sourceOut = source;
+	*colsOut = cols;
+	return 0;
+}
+
 void gprint(Grid* g) {
 	size_t m = g->info->rows;
 	size_t n = g->info->columns;
@@ -486,7 +1158,7 @@ char** struniq(Grid* g, size_t col, size_t* destLength) {
 	char*** body = g->body;
 	size_t m = g->info->rows;
 
-	char** temp = malloc(sizeof(char*) * m);
+	char** temp = memalloc(MEM_SCRATCH, sizeof(char*) * m);
 
 	size_t assigned = 0;
 	for (int i = 0; i < m; i++) {
@@ -513,7 +1185,7 @@ char** struniq(Grid* g, size_t col, size_t* destLength) {
 		if (!found) {
 			if (crt) {
 				size_t l = strlen(crt);
-				char* copy = cnew(l);
+				char* copy = memalloc(MEM_MAPPER, l + 1);
 				strcpy(copy, crt);
 				temp[assigned] = copy;
 				assigned++;
@@ -524,13 +1196,13 @@ char** struniq(Grid* g, size_t col, size_t* destLength) {
 		}
 	}
 
-	char** uniq = malloc(sizeof(char*) * assigned);
+	char** uniq = memalloc(MEM_MAPPER, sizeof(char*) * assigned);
 
 	for (int i = 0; i < assigned; i++) {
 		uniq[i] = temp[i];
 	}
 
-	free(temp);
+	memfree(MEM_SCRATCH, temp);
 	*destLength = assigned;
 	return uniq;
 }
@@ -582,6 +1254,119 @@ short blank(char* str, size_t length) {
 	return 1;
 }
 
+/*
+ * Parses the number at the start of the first length chars of str, which do
+ * not need to be NUL terminated; a length of -1 reads up to the first NUL
+ * instead. Returns the number of chars used, or 0 when the slice does not
+ * start with a number, just like the end pointer of strtod. The value is
+ * stored in dest.
+ *
+ * Plain decimals with up to 19 significant digits and a small exponent
+ * are computed with a single, correctly rounded, operation. Anything else
+ * (long mantissas, large exponents, hex, inf and nan) goes to strtod.
+ */
+size_t numparse(const char* str, size_t length, double* dest) {
+	if (length == -1) {
+		length = LONG_MAX;
+	}
+
+	size_t i = 0;
+	short negative = 0;
+	if (i < length && (str[i] == '-' || str[i] == '+')) {
+		negative = str[i] == '-';
+		i++;
+	}
+	size_t first = i;
+
+	if (i < length && str[i] == '0' && i + 1 < length
+			&& (str[i + 1] == 'x' || str[i + 1] == 'X')) {
+		return numslow(str, length, dest);
+	}
+
+	uint64_t mantissa = 0;
+	int significant = 0;
+	int exponent = 0;
+	size_t digits = 0;
+	for (; i < length && str[i] >= '0' && str[i] <= '9'; i++) {
+		if (significant < NUM_DIGITS) {
+			mantissa = mantissa * 10 + (str[i] - '0');
+			significant += mantissa > 0;
+		} else {
+			//the remaining digits would need more than 64 bits.
+			return numslow(str, length, dest);
+		}
+		digits++;
+	}
+
+	if (i < length && str[i] == '.') {
+		i++;
+		for (; i < length && str[i] >= '0' && str[i] <= '9'; i++) {
+			if (significant < NUM_DIGITS) {
+				mantissa = mantissa * 10 + (str[i] - '0');
+				significant += mantissa > 0;
+				exponent--;
+			} else {
+				return numslow(str, length, dest);
+			}
+			digits++;
+		}
+	}
+
+	if (digits == 0) {
+		//no digits at all, only inf, nan or leading white space can still
+		//be a number.
+		char c = first < length ? str[first] : 0;
+		if ((c | 32) == 'i' || (c | 32) == 'n' || (first == 0 && isspace(c))) {
+			return numslow(str, length, dest);
+		}
+		return 0;
+	}
+
+	if (i < length && (str[i] == 'e' || str[i] == 'E')) {
+		size_t k = i + 1;
+		short expnegative = 0;
+		if (k < length && (str[k] == '-' || str[k] == '+')) {
+			expnegative = str[k] == '-';
+			k++;
+		}
+
+		//without digits, the 'e' is not part of the number.
+		if (k < length && str[k] >= '0' && str[k] <= '9') {
+			int value = 0;
+			for (; k < length && str[k] >= '0' && str[k] <= '9'; k++) {
+				if (value < 100000) {
+					value = value * 10 + (str[k] - '0');
+				}
+			}
+			exponent += expnegative ? -value : value;
+			i = k;
+		}
+	}
+
+	double x;
+	if (mantissa == 0) {
+		x = 0;
+	} else if (mantissa <= NUM_MANTISSA && exponent >= -NUM_POWERS
+			&& exponent <= NUM_POWERS) {
+		x = (double) mantissa;
+		x = exponent < 0 ? x / numpowers[-exponent] : x * numpowers[exponent];
+	} else {
+		return numslow(str, length, dest);
+	}
+
+	*dest = negative ? -x : x;
+	return i;
+}
+
+/*
+ * Compares two doubles, for qsort.
+ */
+int dcmp(const void* a, const void* b) {
+	double x = *(const double*) a;
+	double y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
 float higher(float a, float b) {
 	if (isnan(a)) {
 		if (isnan(b)) {
@@ -647,6 +1432,16 @@ void flush() {
 	fflush(stdout);
 }
 
+/*
+ * Returns the wall clock time in seconds, from an arbitrary starting point.
+ * Only the difference between two calls is meaningful.
+ */
+double wtime() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
 ssize_t cfind(char* str, char c) {
 
 	char crt;
@@ -698,9 +1493,11 @@ ssize_t cnotfindr(char* str, size_t length, char c) {
 }
 
 String* ffull(char* path) {
+	profbegin("read");
 	FILE* f = fopen(path, "r");
 
 	if (f == NULL) {
+		profend();
 		return NULL;
 	}
 
@@ -714,50 +1511,136 @@ String* ffull(char* path) {
 		count++;
 	}
 
-	char* content = cnew(count);
+	char* content = memalloc(MEM_RAW, count + 1);
+	content[count] = '\0';
 	rewind(f);
 	size_t r = fread(content, sizeof(char), count, f);
 
 	fclose(f);
 
 	String* s = strnew(content, r);
+	profcount(PROF_BYTES_READ, r);
+	profend();
 	return s;
 }
 
+/*
+ * Writes str as a quoted JSON string, escaping the characters that need it.
+ * A NULL str is written as null.
+ */
+void fjsonstr(FILE* f, char* str) {
+	if (str == NULL) {
+		fputs("null", f);
+		return;
+	}
+
+	fputc('"', f);
+	for (size_t i = 0; str[i] != '\0'; i++) {
+		unsigned char c = str[i];
+		if (c == '"' || c == '\\') {
+			fputc('\\', f);
+			fputc(c, f);
+		} else if (c < 0x20) {
+			fprintf(f, "\\u%04x", c);
+		} else {
+			fputc(c, f);
+		}
+	}
+	fputc('"', f);
+}
+
+/*
+ * Writes a number in JSON format. NaN and infinite values have no JSON
+ * representation, so they are written as null.
+ */
+void fjsonnum(FILE* f, double val) {
+	if (isnan(val) || isinf(val)) {
+		fputs("null", f);
+	} else {
+		fprintf(f, "%.10g", val);
+	}
+}
+
 void strprintln(String* str) {
 	printf(str->value);
 	printf("\n");
 	fflush(stdout);
 }
 
+GridInfo* ginfocopy(GridInfo* info) {
+	size_t cols = info->columns;
+
+	GridInfo* copy = memalloc(MEM_INFO, sizeof(GridInfo));
+	copy->max = memalloc(MEM_INFO, sizeof(float) * cols);
+	copy->min = memalloc(MEM_INFO, sizeof(float) * cols);
+	copy->mean = memalloc(MEM_INFO, sizeof(float) * cols);
+	copy->stdev = memalloc(MEM_INFO, sizeof(float) * cols);
+	copy->discrete = memalloc(MEM_INFO, sizeof(short) * cols);
+	copy->missing = memalloc(MEM_INFO, sizeof(size_t) * cols);
+	copy->numbers = memalloc(MEM_INFO, sizeof(size_t) * cols);
+	copy->words = memalloc(MEM_INFO, sizeof(size_t) * cols);
+
+	memcpy(copy->max, info->max, sizeof(float) * cols);
+	memcpy(copy->min, info->min, sizeof(float) * cols);
+	memcpy(copy->mean, info->mean, sizeof(float) * cols);
+	memcpy(copy->stdev, info->stdev, sizeof(float) * cols);
+	memcpy(copy->discrete, info->discrete, sizeof(short) * cols);
+	memcpy(copy->missing, info->missing, sizeof(size_t) * cols);
+	memcpy(copy->numbers, info->numbers, sizeof(size_t) * cols);
+	memcpy(copy->words, info->words, sizeof(size_t) * cols);
+	copy->quantiles = NULL;
+	copy->distinct = NULL;
+	if (info->quantiles) {
+		copy->quantiles = memcalloc(MEM_INFO, cols, sizeof(Kll*));
+		copy->distinct = memcalloc(MEM_INFO, cols, sizeof(Hll*));
+		for (size_t j = 0; j < cols; j++) {
+			copy->quantiles[j] = kllcopy(info->quantiles[j]);
+			copy->distinct[j] = hllcopy(info->distinct[j]);
+		}
+	}
+	copy->rows = info->rows;
+	copy->columns = cols;
+
+	return copy;
+}
+
 void ginfofree(GridInfo* info) {
 	if (info) {
 
 		if (info->max)
-			free(info->max);
+			memfree(MEM_INFO, info->max);
 
 		if (info->min)
-			free(info->min);
+			memfree(MEM_INFO, info->min);
 
 		if (info->mean)
-			free(info->mean);
+			memfree(MEM_INFO, info->mean);
 
 		if (info->stdev)
-			free(info->stdev);
+			memfree(MEM_INFO, info->stdev);
 
 		if (info->discrete)
-			free(info->discrete);
+			memfree(MEM_INFO, info->discrete);
 
 		if (info->numbers)
-			free(info->numbers);
+			memfree(MEM_INFO, info->numbers);
 
 		if (info->words)
-			free(info->words);
+			memfree(MEM_INFO, info->words);
 
 		if (info->missing)
-			free(info->missing);
+			memfree(MEM_INFO, info->missing);
 
-		free(info);
+		if (info->quantiles) {
+			for (size_t j = 0; j < info->columns; j++) {
+				kllfree(info->quantiles[j]);
+				hllfree(info->distinct[j]);
+			}
+			memfree(MEM_INFO, info->quantiles);
+			memfree(MEM_INFO, info->distinct);
+		}
+
+		memfree(MEM_INFO, info);
 	}
 }
 
@@ -772,19 +1655,21 @@ void gpartialfree(Grid* g, size_t rows, size_t cols) {
 					for (size_t j = 0; j < cols; j++) {
 
 						if (body[i][j]) {
-							free(body[i][j]);
+							memfree(MEM_GRID, body[i][j]);
 						}
 
 					}
-				free(body[i]);
+				memfree(MEM_GRID, body[i]);
 			}
 
-			free(body);
+			memfree(MEM_GRID, body);
 		}
 
+		gparsedfree(g, cols);
 		ginfofree(g->info);
 
-		free(g);
+		memfree(MEM_GRID, g->source);
+		memfree(MEM_GRID, g);
 	}
 }
 
@@ -800,26 +1685,30 @@ void gfree(Grid* g) {
 					if (body[i]) {
 						for (size_t j = 0; j < n; j++) {
 							if (body[i][j]) {
-								free(body[i][j]);
+								memfree(MEM_GRID, body[i][j]);
 							}
 						}
-						free(body[i]);
+						memfree(MEM_GRID, body[i]);
 
 					}
 				}
 			}
-			free(body);
+			memfree(MEM_GRID, body);
 
 		}
 
+		if (g->info) {
+			gparsedfree(g, g->info->columns);
+		}
 		ginfofree(g->info);
-		free(g);
+		memfree(MEM_GRID, g->source);
+		memfree(MEM_GRID, g);
 	}
 }
 
 void strfree(String* str) {
-	free((char*) str->value);
-	free(str);
+	memfree(MEM_RAW, str->value);
+	memfree(MEM_RAW, str);
 }
 
 char* cnew(size_t l) {
@@ -828,8 +1717,30 @@ char* cnew(size_t l) {
 	return s;
 }
 
+/*
+ * Fallback of numparse, using strtod on a NUL terminated copy of the slice.
+ */
+static size_t numslow(const char* str, size_t length, double* dest) {
+	char buf[128];
+	size_t l = 0;
+	while (l < length && l + 1 < sizeof(buf) && str[l] != '\0') {
+		buf[l] = str[l];
+		l++;
+	}
+	buf[l] = '\0';
+
+	char* end;
+	double x = strtod(buf, &end);
+	if (end == buf) {
+		return 0;
+	}
+
+	*dest = x;
+	return end - buf;
+}
+
 String* strnew(char* value, size_t length) {
-	String* s = malloc(sizeof(String));
+	String* s = memalloc(MEM_RAW, sizeof(String));
 	s->length = length;
 	s->value = value;
 	return s;
@@ -8,8 +8,12 @@
 #ifndef UTILS_H_
 #define UTILS_H_
 
+#include <stdio.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include "ml.h"
+#include "sketch.h"
+#include "prune.h"
 
 
 typedef struct String{
@@ -17,6 +21,12 @@ typedef struct String{
 	char* value;
 }String;
 
+/*
+ * Column statistics of a grid. quantiles[j] is the quantile sketch of a
+ * number column and distinct[j] the distinct count sketch of a column with
+ * words, NULL for every other column. Both are NULL when the statistics
+ * were not computed from a grid, like the ones of a model file.
+ */
 typedef struct GridInfo{
 	float* max;
 	float* min;
@@ -28,46 +38,93 @@ typedef struct GridInfo{
 	size_t* words;
 	size_t* missing;
 	
+	Kll** quantiles;
+	Hll** distinct;
+
 	size_t rows;
 	size_t columns;
 }GridInfo;
 
+/*
+ * Cells of a csv file, NULL for the blank ones. parsed[j] holds the value
+ * of every row of a number column as parsed by ginfo, NAN when it is
+ * blank, and is NULL for the other columns.
+ *
+ * Only the columns selected with gfeatures and gtarget are kept, the target
+ * last. source[j] is the file column kept as column j, and width is the
+ * number of columns of the file. source is NULL when every column is kept
+ * in the order of the file.
+ */
 typedef struct Grid{
 	
 	GridInfo* info;
 	char*** body;
+	float** parsed;
+	size_t* source;
+	size_t width;
 }Grid;
 
+/*
+ * Encoding of each grid column. A word column has a dictionary of sizes[j]
+ * values in map[j], one matrix column each. When it has more than
+ * maphashabove distinct values, as estimated by the distinct count sketch
+ * of its GridInfo, it is hashed instead: map[j] is NULL and
+ * buckets[j] is the number of matrix columns its values are hashed to.
+ * buckets[j] is 0 for every other column.
+ *
+ * source and width are the ones of the grid, so rows read later from a
+ * file with the same layout are picked the same way, see rowpick.
+ */
 typedef struct Mapper{
 	size_t cols;
 	size_t* sizes;
 	char*** map;
+	size_t* buckets;
+	size_t* source;
+	size_t width;
 }Mapper;
 
+extern size_t maphashabove;
+extern size_t mapbuckets;
+extern size_t ginfosample;
+extern size_t* gfeatures;
+extern size_t gfeaturecount;
+extern ssize_t gtarget;
+
 
 unsigned int lowercmp(char* str, char* other);
 void mtrshuffle(Matrix* matrix);
-void mtrswap(float* values, size_t n, float* buffer, size_t idxFrom, size_t idxTo);
-
-void fillstdev(GridInfo* info, Grid* g);
-void onlinestdev(GridInfo* info, Grid* g, size_t col, float* mean, float* stdev);
 
 Matrix* mtrcreate(Grid* g, Mapper* mapper);
+size_t mtrrow(Mapper* mapper, GridInfo* info, size_t* offsets, char** row,
+		size_t cols, float* dest);
+size_t* mtroffsets(Mapper* mapper, size_t* missing);
+ssize_t mapidx(Mapper* mapper, size_t col, char* val);
+size_t rowsplit(char* line, size_t length, char d, char** cells, size_t cols);
+size_t rowpick(Mapper* mapper, char** split, size_t found, char** cells);
+size_t* colparse(char* list, size_t* count);
 void gprint(Grid* g);
-size_t tomtrcol(char*** map, size_t* sizes, size_t* missing, size_t col, char* val);
-size_t mtrcols(char*** map, size_t* sizes, size_t* missing, size_t cols);
+size_t tomtrcol(Mapper* mapper, size_t* missing, size_t col, char* val);
+size_t mtrcols(Mapper* mapper, size_t* missing, size_t cols);
+size_t maphash(char* val, size_t buckets, float* sign);
+uint64_t strhash(char* val);
 
 Mapper* mapcreate(Grid* g);
 void mapfree(Mapper* mapper);
+Mapper* mapcopy(Mapper* mapper);
 char** struniq(Grid* g, size_t col, size_t* destLength);
 size_t triml(char* src, size_t srcLength);
 size_t trim(char* src, size_t srcLength, char* dest, size_t destLength);
 short blank(char* str, size_t length);
+size_t numparse(const char* str, size_t length, double* dest);
+int dcmp(const void* a, const void* b);
 float higher(float a, float b);
 float lower(float a, float b);
 
 GridInfo* ginfo(Grid* g, size_t rows, size_t cols);
+double ginfodistinct(GridInfo* info, size_t col);
 void ginfofree(GridInfo* info);
+GridInfo* ginfocopy(GridInfo* info);
 Grid* gcreate(char* raw, char d);
 
 void gfree(Grid* g);
@@ -75,11 +132,14 @@ void gpartialfree(Grid* g, size_t rows, size_t cols);
 
 size_t ccount(char* str, size_t end, char c);
 void flush();
+double wtime();
 ssize_t cfind(char* str, char c);
 ssize_t cnotfind(char* str, char c);
 ssize_t cnotfindr(char* str, size_t length, char c);
 String* ffull(char* path);
 void strprintln(String* str);
+void fjsonstr(FILE* f, char* str);
+void fjsonnum(FILE* f, double val);
 char* cnew(size_t l);
 
 